@@ -0,0 +1,221 @@
+/*
+ * Benchmark for the libcss lexer.
+ *
+ * Usage: bench_lex file.css [file.css ...]
+ *
+ * Each stylesheet is lexed repeatedly and the throughput of the whole
+ * lexer is reported in tokens and bytes per second.
+ *
+ * The lexer's table-driven character class predicates are also timed
+ * against the chains of range comparisons they replaced, over the bytes
+ * of the given stylesheets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../libcss/src/lex/lex.h"
+#include "../libcss/src/lex/scan.h"
+
+#define ROUNDS (20)
+
+typedef struct sheet {
+	const char *path;
+	uint8_t *data;
+	size_t len;
+} sheet;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+	FILE *fp = fopen(path, "rb");
+	uint8_t *data;
+	long size;
+
+	if (fp == NULL)
+		return NULL;
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+
+	data = malloc(size > 0 ? size : 1);
+	if (data == NULL || fread(data, 1, size, fp) != (size_t) size) {
+		free(data);
+		fclose(fp);
+		return NULL;
+	}
+
+	fclose(fp);
+	*len = size;
+
+	return data;
+}
+
+/* Count the tokens in a stylesheet, or return 0 on error */
+static size_t lex_sheet(const sheet *s)
+{
+	parserutils_inputstream *stream;
+	css_lexer *lexer;
+	css_token *token;
+	css_error error;
+	size_t ntokens = 0;
+
+	if (parserutils_inputstream_create("UTF-8", 0, NULL,
+			&stream) != PARSERUTILS_OK)
+		return 0;
+
+	if (css__lexer_create(stream, &lexer) != CSS_OK) {
+		parserutils_inputstream_destroy(stream);
+		return 0;
+	}
+
+	if (parserutils_inputstream_append(stream, s->data,
+			s->len) != PARSERUTILS_OK ||
+			parserutils_inputstream_append(stream,
+			NULL, 0) != PARSERUTILS_OK) {
+		css__lexer_destroy(lexer);
+		parserutils_inputstream_destroy(stream);
+		return 0;
+	}
+
+	while ((error = css__lexer_get_token(lexer, &token)) == CSS_OK) {
+		ntokens++;
+		if (token->type == CSS_TOKEN_EOF)
+			break;
+	}
+
+	css__lexer_destroy(lexer);
+	parserutils_inputstream_destroy(stream);
+
+	return error == CSS_OK ? ntokens : 0;
+}
+
+/* The predicates as they were before the class table */
+
+static bool range_nmchar(uint8_t c)
+{
+	return c == '_' || ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') ||
+		('0' <= c && c <= '9') || c == '-' || c >= 0x80 || c == '\\';
+}
+
+static bool range_urlchar(uint8_t c)
+{
+	return c == '\t' || c == '!' || ('#' <= c && c <= '&') || c == '(' ||
+		('*' <= c && c <= '~') || c >= 0x80 || c == '\\';
+}
+
+static bool range_stringchar(uint8_t c)
+{
+	return range_urlchar(c) || c == ' ' || c == ')';
+}
+
+static bool range_space(uint8_t c)
+{
+	return c == ' ' || c == '\r' || c == '\n' || c == '\f' || c == '\t';
+}
+
+int main(int argc, char **argv)
+{
+	sheet *sheets;
+	size_t nsheets = argc - 1, ntokens = 0, nbytes = 0;
+	volatile size_t sink = 0;
+	double start, t_lex, t_range, t_table;
+	size_t i, j, r;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s file.css [file.css ...]\n",
+				argv[0]);
+		return 1;
+	}
+
+	sheets = malloc(nsheets * sizeof(sheet));
+	if (sheets == NULL)
+		return 1;
+
+	for (i = 0; i < nsheets; i++) {
+		sheets[i].path = argv[i + 1];
+		sheets[i].data = read_file(argv[i + 1], &sheets[i].len);
+		if (sheets[i].data == NULL) {
+			perror(argv[i + 1]);
+			return 1;
+		}
+
+		nbytes += sheets[i].len;
+	}
+
+	start = now();
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < nsheets; i++) {
+			size_t n = lex_sheet(&sheets[i]);
+
+			if (n == 0) {
+				fprintf(stderr, "%s: failed to lex\n",
+						sheets[i].path);
+				return 1;
+			}
+
+			ntokens += n;
+		}
+	}
+	t_lex = now() - start;
+
+	start = now();
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < nsheets; i++) {
+			const uint8_t *data = sheets[i].data;
+			size_t n = 0;
+
+			for (j = 0; j < sheets[i].len; j++) {
+				n += range_nmchar(data[j]);
+				n += range_stringchar(data[j]);
+				n += range_space(data[j]);
+			}
+
+			sink += n;
+		}
+	}
+	t_range = now() - start;
+
+	start = now();
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < nsheets; i++) {
+			const uint8_t *data = sheets[i].data;
+			size_t n = 0;
+
+			for (j = 0; j < sheets[i].len; j++) {
+				n += startNMChar(data[j]);
+				n += startStringChar(data[j]);
+				n += isSpace(data[j]);
+			}
+
+			sink += n;
+		}
+	}
+	t_table = now() - start;
+
+	printf("%zu stylesheets, %zu bytes, %zu tokens\n", nsheets, nbytes,
+			ntokens / ROUNDS);
+	printf("lexer             : %6.2f Mtokens/s, %7.2f MB/s\n",
+			ntokens / t_lex / 1e6,
+			(double) nbytes * ROUNDS / t_lex / 1e6);
+	printf("range predicates  : %6.2f ns/byte\n",
+			t_range * 1e9 / ((double) nbytes * ROUNDS));
+	printf("table predicates  : %6.2f ns/byte\n",
+			t_table * 1e9 / ((double) nbytes * ROUNDS));
+
+	for (i = 0; i < nsheets; i++)
+		free(sheets[i].data);
+	free(sheets);
+
+	return sink == 0x12345678 ? 2 : 0;
+}
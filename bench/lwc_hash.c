@@ -0,0 +1,212 @@
+/*
+ * Micro-benchmark for libwapcaplet's string hashing and interning.
+ *
+ * Usage: bench_lwc_hash file.css [file.css ...]
+ *
+ * The identifiers (runs of name characters) found in the given
+ * stylesheets are hashed and interned repeatedly, so the timings
+ * reflect the length and case distribution of real CSS names.  The
+ * byte-at-a-time FNV-1 hash libwapcaplet used to use is timed alongside
+ * for comparison, including the second pass it needed for the lower
+ * case hash.
+ */
+
+/* Built as one unit with the library so its static helpers are
+ * visible. */
+#include "../libwapcaplet/src/libwapcaplet.c"
+
+#include <stdio.h>
+#include <time.h>
+
+#define ROUNDS (20)
+
+typedef struct ident {
+	const char *data;
+	size_t len;
+} ident;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool is_name_char(unsigned char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+			(c >= '0' && c <= '9') || c == '-' || c == '_' ||
+			c >= 0x80;
+}
+
+static lwc_hash fnv1(const char *str, size_t len)
+{
+	lwc_hash z = 0x811c9dc5;
+
+	while (len > 0) {
+		z *= 0x01000193;
+		z ^= *str++;
+		len--;
+	}
+
+	return z;
+}
+
+static lwc_hash fnv1_lcase(const char *str, size_t len)
+{
+	lwc_hash z = 0x811c9dc5;
+
+	while (len > 0) {
+		z *= 0x01000193;
+		z ^= lwc__dolower(*str++);
+		len--;
+	}
+
+	return z;
+}
+
+static char *read_file(const char *path, size_t *len)
+{
+	FILE *fp = fopen(path, "rb");
+	char *data;
+	long size;
+
+	if (fp == NULL)
+		return NULL;
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+
+	data = malloc(size > 0 ? size : 1);
+	if (data == NULL || fread(data, 1, size, fp) != (size_t) size) {
+		free(data);
+		fclose(fp);
+		return NULL;
+	}
+
+	fclose(fp);
+	*len = size;
+
+	return data;
+}
+
+int main(int argc, char **argv)
+{
+	ident *idents = NULL;
+	size_t nidents = 0, alloc = 0, total = 0;
+	lwc_string **strings;
+	volatile lwc_hash sink = 0;
+	double start, t_fnv, t_word, t_intern;
+	size_t i, r;
+	int f;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s file.css [file.css ...]\n",
+				argv[0]);
+		return 1;
+	}
+
+	for (f = 1; f < argc; f++) {
+		size_t len, pos = 0;
+		char *data = read_file(argv[f], &len);
+
+		if (data == NULL) {
+			perror(argv[f]);
+			return 1;
+		}
+
+		while (pos < len) {
+			size_t begin;
+
+			while (pos < len && is_name_char(data[pos]) == false)
+				pos++;
+
+			begin = pos;
+			while (pos < len && is_name_char(data[pos]))
+				pos++;
+
+			if (pos == begin)
+				continue;
+
+			if (nidents == alloc) {
+				alloc = alloc ? alloc * 2 : 1024;
+				idents = realloc(idents,
+						alloc * sizeof(ident));
+				if (idents == NULL)
+					return 1;
+			}
+
+			idents[nidents].data = data + begin;
+			idents[nidents].len = pos - begin;
+			total += pos - begin;
+			nidents++;
+		}
+	}
+
+	if (nidents == 0) {
+		fprintf(stderr, "No identifiers found\n");
+		return 1;
+	}
+
+	strings = malloc(nidents * sizeof(lwc_string *));
+	if (strings == NULL)
+		return 1;
+
+	start = now();
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < nidents; i++) {
+			sink ^= fnv1(idents[i].data, idents[i].len);
+			sink ^= fnv1_lcase(idents[i].data, idents[i].len);
+		}
+	}
+	t_fnv = now() - start;
+
+	start = now();
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < nidents; i++) {
+			lwc_hash h, lh;
+
+			lwc__calculate_hashes(idents[i].data, idents[i].len,
+					&h, &lh);
+			sink ^= h ^ lh;
+		}
+	}
+	t_word = now() - start;
+
+	start = now();
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < nidents; i++) {
+			if (lwc_intern_string(idents[i].data, idents[i].len,
+					&strings[i]) != lwc_error_ok)
+				return 1;
+		}
+		for (i = 0; i < nidents; i++) {
+			bool match;
+
+			if (lwc_string_caseless_isequal(strings[i],
+					strings[nidents - 1 - i],
+					&match) != lwc_error_ok)
+				return 1;
+			sink ^= match;
+		}
+		for (i = 0; i < nidents; i++)
+			lwc_string_unref(strings[i]);
+	}
+	t_intern = now() - start;
+
+	printf("%zu identifiers, mean length %.1f bytes\n",
+			nidents, (double) total / nidents);
+	printf("fnv1 + lcase fnv1 : %6.2f ns/ident\n",
+			t_fnv * 1e9 / (ROUNDS * nidents));
+	printf("word-at-a-time    : %6.2f ns/ident\n",
+			t_word * 1e9 / (ROUNDS * nidents));
+	printf("intern + caseless : %6.2f ns/ident\n",
+			t_intern * 1e9 / (ROUNDS * nidents));
+
+	free(strings);
+
+	return sink == 0x12345678 ? 2 : 0;
+}
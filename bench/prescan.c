@@ -0,0 +1,171 @@
+/*
+ * Benchmark for the libcss structural pre-scanner.
+ *
+ * Usage: bench_prescan file.css [file.css ...]
+ *
+ * Each stylesheet is pre-scanned repeatedly and the throughput is reported
+ * in bytes per second, along with the number of top-level rules found.
+ *
+ * For comparison, a byte-at-a-time scan that tracks the same brackets,
+ * strings and comments using the lexer's character class table is also
+ * timed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../libcss/src/lex/prescan.h"
+#include "../libcss/src/lex/scan.h"
+
+#define ROUNDS (20)
+
+typedef struct sheet {
+	const char *path;
+	uint8_t *data;
+	size_t len;
+} sheet;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+	FILE *fp = fopen(path, "rb");
+	uint8_t *data;
+	long size;
+
+	if (fp == NULL)
+		return NULL;
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+
+	data = malloc(size > 0 ? size : 1);
+	if (data == NULL || fread(data, 1, size, fp) != (size_t) size) {
+		free(data);
+		fclose(fp);
+		return NULL;
+	}
+
+	fclose(fp);
+	*len = size;
+
+	return data;
+}
+
+/* Count the top-level blocks in a stylesheet a byte at a time */
+static size_t byte_scan(const uint8_t *data, size_t len)
+{
+	size_t i, depth = 0, nblocks = 0;
+	uint8_t quote = 0;
+
+	for (i = 0; i < len; i++) {
+		uint8_t c = data[i];
+
+		if ((charClass[c] & CHAR_STRUCTURAL) == 0)
+			continue;
+
+		if (quote != 0) {
+			if (c == '\\')
+				i++;
+			else if (c == quote)
+				quote = 0;
+		} else if (c == '"' || c == '\'') {
+			quote = c;
+		} else if (c == '\\') {
+			i++;
+		} else if (c == '/' && i + 1 < len && data[i + 1] == '*') {
+			for (i += 2; i + 1 < len; i++) {
+				if (data[i] == '*' && data[i + 1] == '/')
+					break;
+			}
+			i++;
+		} else if (c == '{' || c == '(' || c == '[') {
+			depth++;
+		} else if (c == '}' || c == ')' || c == ']') {
+			if (depth > 0 && --depth == 0 && c == '}')
+				nblocks++;
+		}
+	}
+
+	return nblocks;
+}
+
+int main(int argc, char **argv)
+{
+	sheet *sheets;
+	size_t nsheets = argc - 1, nrules = 0, nblocks = 0, nbytes = 0;
+	double start, t_prescan, t_bytes;
+	size_t i, r;
+
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s file.css [file.css ...]\n",
+				argv[0]);
+		return 1;
+	}
+
+	sheets = malloc(nsheets * sizeof(sheet));
+	if (sheets == NULL)
+		return 1;
+
+	for (i = 0; i < nsheets; i++) {
+		sheets[i].path = argv[i + 1];
+		sheets[i].data = read_file(argv[i + 1], &sheets[i].len);
+		if (sheets[i].data == NULL) {
+			perror(argv[i + 1]);
+			return 1;
+		}
+
+		nbytes += sheets[i].len;
+	}
+
+	start = now();
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < nsheets; i++) {
+			css_prescan_rule *rules;
+			size_t n;
+			css_error error;
+
+			error = css__prescan(sheets[i].data, sheets[i].len,
+					&rules, &n);
+			if (error == CSS_NOMEM) {
+				fprintf(stderr, "%s: failed to pre-scan\n",
+						sheets[i].path);
+				return 1;
+			}
+
+			nrules += n;
+			free(rules);
+		}
+	}
+	t_prescan = now() - start;
+
+	start = now();
+	for (r = 0; r < ROUNDS; r++) {
+		for (i = 0; i < nsheets; i++)
+			nblocks += byte_scan(sheets[i].data, sheets[i].len);
+	}
+	t_bytes = now() - start;
+
+	printf("%zu stylesheets, %zu bytes, %zu rules\n", nsheets, nbytes,
+			nrules / ROUNDS);
+	printf("pre-scanner       : %6.2f GB/s\n",
+			(double) nbytes * ROUNDS / t_prescan / 1e9);
+	printf("byte-at-a-time    : %6.2f GB/s (%zu blocks)\n",
+			(double) nbytes * ROUNDS / t_bytes / 1e9,
+			nblocks / ROUNDS);
+
+	for (i = 0; i < nsheets; i++)
+		free(sheets[i].data);
+	free(sheets);
+
+	return 0;
+}
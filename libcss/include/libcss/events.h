@@ -0,0 +1,147 @@
+/*
+ * This file is part of LibCSS.
+ * Licensed under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+#ifndef libcss_events_h_
+#define libcss_events_h_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "../libcss/errors.h"
+#include "../libcss/types.h"
+
+/**
+ * Type of a parse event
+ */
+typedef enum css_event_type {
+	CSS_EVENT_START_STYLESHEET,
+	CSS_EVENT_END_STYLESHEET,
+	CSS_EVENT_START_RULESET,
+	CSS_EVENT_END_RULESET,
+	CSS_EVENT_START_ATRULE,
+	CSS_EVENT_END_ATRULE,
+	CSS_EVENT_START_BLOCK,
+	CSS_EVENT_END_BLOCK,
+	CSS_EVENT_BLOCK_CONTENT,
+	CSS_EVENT_DECLARATION
+} css_event_type;
+
+/**
+ * Type of a token in a parse event
+ */
+typedef enum css_event_token_type {
+	CSS_EVENT_TOKEN_IDENT,
+	CSS_EVENT_TOKEN_ATKEYWORD,
+	CSS_EVENT_TOKEN_HASH,
+	CSS_EVENT_TOKEN_FUNCTION,
+	CSS_EVENT_TOKEN_STRING,
+	CSS_EVENT_TOKEN_URI,
+	CSS_EVENT_TOKEN_INVALID_STRING,
+	CSS_EVENT_TOKEN_UNICODE_RANGE,
+	CSS_EVENT_TOKEN_CHAR,
+	CSS_EVENT_TOKEN_NUMBER,
+	CSS_EVENT_TOKEN_PERCENTAGE,
+	CSS_EVENT_TOKEN_DIMENSION,
+	CSS_EVENT_TOKEN_CDO,
+	CSS_EVENT_TOKEN_CDC,
+	CSS_EVENT_TOKEN_S,
+	CSS_EVENT_TOKEN_COMMENT,
+	CSS_EVENT_TOKEN_INCLUDES,
+	CSS_EVENT_TOKEN_DASHMATCH,
+	CSS_EVENT_TOKEN_PREFIXMATCH,
+	CSS_EVENT_TOKEN_SUFFIXMATCH,
+	CSS_EVENT_TOKEN_SUBSTRINGMATCH,
+	CSS_EVENT_TOKEN_EOF
+} css_event_token_type;
+
+/**
+ * View of a token in a parse event
+ *
+ * The text of IDENT, ATKEYWORD, HASH, FUNCTION, STRING and URI tokens
+ * is their value, with escapes resolved and without the characters that
+ * introduce or enclose it. The text of NUMBER, PERCENTAGE and DIMENSION
+ * tokens includes any unit or percent sign, and that of CHAR tokens is
+ * the character. Tokens after DIMENSION have no text.
+ */
+typedef struct css_event_token {
+	css_event_token_type type;	/**< Type of token */
+	const uint8_t *data;		/**< UTF-8 text, not terminated,
+					 * or NULL if none */
+	size_t len;			/**< Length of text, in bytes */
+	uint32_t line;			/**< Line the token starts on */
+	uint32_t col;			/**< Column the token starts at */
+} css_event_token;
+
+/**
+ * Callback to receive parse events
+ *
+ * \param pw        Client data
+ * \param type      Type of event
+ * \param tokens    Tokens of the event, or NULL if there are none
+ * \param n_tokens  Number of tokens in \a tokens
+ * \return CSS_OK to continue parsing,
+ *         CSS_INVALID from a START_RULESET or START_ATRULE event to
+ *         skip the rule,
+ *         any other error to abort parsing.
+ *
+ * A skipped rule's block is not reported, nor is its END_RULESET or
+ * END_ATRULE event. The single ruleset of an inline style can't be
+ * skipped, so CSS_INVALID from its START_RULESET aborts parsing.
+ *
+ * START_RULESET carries the selector tokens, START_ATRULE the at-rule's
+ * prelude and DECLARATION a declaration's tokens, from the property
+ * name to the end of its value. BLOCK_CONTENT carries the tokens of
+ * a block that is neither a ruleset nor a declaration list.
+ *
+ * \note The tokens and their text remain valid only until the callback
+ *       returns; the client must copy anything it wishes to keep.
+ */
+typedef css_error (*css_event_handler_fn)(void *pw, css_event_type type,
+		const css_event_token *tokens, size_t n_tokens);
+
+typedef struct css_event_parser css_event_parser;
+
+typedef enum css_event_parser_params_version {
+	CSS_EVENT_PARSER_PARAMS_VERSION_1 = 1
+} css_event_parser_params_version;
+
+/**
+ * Parameter block for css_event_parser_create()
+ */
+typedef struct css_event_parser_params {
+	/** ABI version of this structure */
+	uint32_t params_version;
+
+	/** The charset of the stylesheet data, or NULL to detect */
+	const char *charset;
+	/** The data is an inline style, i.e. a bare declaration list */
+	bool inline_style;
+
+	/** Event handler */
+	css_event_handler_fn handler;
+	/** Client private data for handler */
+	void *handler_pw;
+} css_event_parser_params;
+
+css_error css_event_parser_create(const css_event_parser_params *params,
+		css_event_parser **parser);
+css_error css_event_parser_destroy(css_event_parser *parser);
+
+css_error css_event_parser_append_data(css_event_parser *parser,
+		const uint8_t *data, size_t len);
+css_error css_event_parser_data_done(css_event_parser *parser);
+
+css_error css_event_parser_get_charset(css_event_parser *parser,
+		const char **charset, css_charset_source *source);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -23,6 +23,7 @@ extern "C"
 #include "../libcss/select.h"
 #include "../libcss/stylesheet.h"
 #include "../libcss/font_face.h"
+#include "../libcss/events.h"
 
 #ifdef __cplusplus
 }
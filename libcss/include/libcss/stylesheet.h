@@ -90,7 +90,8 @@ typedef css_error (*css_font_resolution_fn)(void *pw,
 		lwc_string *name, css_system_font *system_font);
 
 typedef enum css_stylesheet_params_version {
-	CSS_STYLESHEET_PARAMS_VERSION_1 = 1
+	CSS_STYLESHEET_PARAMS_VERSION_1 = 1,
+	CSS_STYLESHEET_PARAMS_VERSION_2 = 2
 } css_stylesheet_params_version;
 
 /**
@@ -134,6 +135,24 @@ typedef struct css_stylesheet_params {
 	css_font_resolution_fn font;
 	/** Client private data for font */
 	void *font_pw;
+
+	/**
+	 * Keep the text of each ruleset's declarations, and only compile
+	 * it the first time the ruleset matches an element during
+	 * selection. (CSS_STYLESHEET_PARAMS_VERSION_2 and later only)
+	 *
+	 * Parsing is faster, and rulesets that never match take no space
+	 * for their styles. Selection then writes to the sheet, under a
+	 * lock of the sheet's own: several threads may select from it at
+	 * once, but nothing else may use it meanwhile.
+	 *
+	 * Declarations are only checked when their ruleset is compiled.
+	 * An invalid declaration then drops the rest of its ruleset's
+	 * declarations, but the sheet keeps its other rules. Parsing the
+	 * sheet without lazy_styles instead fails with CSS_INVALID at that
+	 * point, and drops every rule after it.
+	 */
+	bool lazy_styles;
 } css_stylesheet_params;
 
 css_error css_stylesheet_create(const css_stylesheet_params *params,
@@ -142,6 +161,10 @@ css_error css_stylesheet_destroy(css_stylesheet *sheet);
 
 css_error css_stylesheet_append_data(css_stylesheet *sheet,
 		const uint8_t *data, size_t len);
+css_error css_stylesheet_append_file(css_stylesheet *sheet,
+		const char *path);
+css_error css_stylesheet_append_data_parallel(css_stylesheet *sheet,
+		const uint8_t *data, size_t len, uint32_t threads);
 css_error css_stylesheet_data_done(css_stylesheet *sheet);
 
 css_error css_stylesheet_next_pending_import(css_stylesheet *parent,
@@ -25,6 +25,7 @@
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "../../../libparserutils/include/parserutils/charset/utf8.h"
 #include "../../../libparserutils/include/parserutils/input/inputstream.h"
@@ -33,6 +34,7 @@
 #include "../../include/libcss/errors.h"
 
 #include "../lex/lex.h"
+#include "../lex/scan.h"
 #include "../utils/parserutilserror.h"
 #include "../utils/utils.h"
 
@@ -106,6 +108,11 @@ struct css_lexer
 
 	bool emit_comments;		/**< Whether to emit comment tokens */
 
+	parserutils_buffer *capture;	/**< Buffer receiving the input 
+					 * consumed, or NULL */
+	size_t captureSkip;		/**< Bytes of the current token to 
+					 * omit from the capture */
+
 	uint32_t currentCol;		/**< Current column in source */
 	uint32_t currentLine;		/**< Current line in source */
 };
@@ -125,6 +132,7 @@ static css_error appendToTokenData(css_lexer *lexer,
 		const uint8_t *data, size_t len);
 static css_error emitToken(css_lexer *lexer, css_token_type type,
 		css_token **token);
+static void decodeNumber(css_token *token);
 
 static css_error AtKeyword(css_lexer *lexer, css_token **token);
 static css_error CDCOrIdentOrFunctionOrNPD(css_lexer *lexer,
@@ -156,11 +164,8 @@ static css_error consumeUnicode(css_lexer *lexer, uint32_t ucs);
 static css_error consumeURLChars(css_lexer *lexer);
 static css_error consumeWChars(css_lexer *lexer);
 
-static inline bool startNMChar(uint8_t c);
-static inline bool startNMStart(uint8_t c);
-static inline bool startStringChar(uint8_t c);
-static inline bool startURLChar(uint8_t c);
-static inline bool isSpace(uint8_t c);
+static void updatePosition(css_lexer *lexer, const uint8_t *data, size_t len);
+static css_error captureInput(css_lexer *lexer);
 
 /**
  * Create a lexer instance
@@ -192,6 +197,8 @@ css_error css__lexer_create(parserutils_inputstream *input, css_lexer **lexer)
 	lex->state = sSTART;
 	lex->substate = 0;
 	lex->emit_comments = false;
+	lex->capture = NULL;
+	lex->captureSkip = 0;
 	lex->currentCol = 1;
 	lex->currentLine = 1;
 
@@ -244,6 +251,30 @@ css_error css__lexer_setopt(css_lexer *lexer, css_lexer_opttype type,
 	return CSS_OK;
 }
 
+/**
+ * Capture the input consumed by a lexer
+ *
+ * \param lexer   The lexer to capture the input of
+ * \param buffer  Buffer to append the input to, or NULL to stop capturing
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * Capturing starts after the current token: the input read for each 
+ * subsequent token, including any whitespace and comments, is appended to 
+ * the buffer as the lexer moves past it. Thus, when capturing stops, the 
+ * buffer holds the input between the token current when capturing started 
+ * and the token current when it stopped, exclusive of both.
+ */
+css_error css__lexer_capture(css_lexer *lexer, parserutils_buffer *buffer)
+{
+	if (lexer == NULL)
+		return CSS_BADPARM;
+
+	lexer->capture = buffer;
+	lexer->captureSkip = (buffer != NULL) ? lexer->bytesReadForToken : 0;
+
+	return CSS_OK;
+}
+
 /**
  * Retrieve a token from a lexer
  *
@@ -465,6 +496,10 @@ css_error emitToken(css_lexer *lexer, css_token_type type,
 		break;
 	}
 
+	if (type == CSS_TOKEN_NUMBER || type == CSS_TOKEN_PERCENTAGE ||
+			type == CSS_TOKEN_DIMENSION)
+		decodeNumber(t);
+
 	*token = t;
 
 	/* Reset the lexer's state */
@@ -474,6 +509,32 @@ css_error emitToken(css_lexer *lexer, css_token_type type,
 	return CSS_OK;
 }
 
+/**
+ * Decode the value, and any unit, of a numeric token
+ *
+ * \param token  The token to decode
+ *
+ * This happens once, as the token is emitted, so consumers of the token 
+ * need not rescan its data.
+ */
+void decodeNumber(css_token *token)
+{
+	size_t consumed = 0;
+	uint32_t unit;
+
+	token->number.value = css__number_from_string(token->data.data, 
+			token->data.len, false, &consumed);
+	token->number.len = consumed;
+	token->number.integer = 
+			memchr(token->data.data, '.', consumed) == NULL;
+	token->number.unit = CSS_TOKEN_UNIT_UNKNOWN;
+
+	if (token->type == CSS_TOKEN_DIMENSION && css__parse_unit_keyword(
+			(const char *) token->data.data + consumed, 
+			token->data.len - consumed, &unit) == CSS_OK)
+		token->number.unit = unit;
+}
+
 /******************************************************************************
  * State machine components                                                   *
  ******************************************************************************/
@@ -798,7 +859,9 @@ css_error Comment(css_lexer *lexer, css_token **token)
 		lexer->substate = InComment;
 
 		while (1) {
-			perror = parserutils_inputstream_peek(lexer->input,
+			size_t len;
+
+			perror = parserutils_inputstream_peek_span(lexer->input,
 					lexer->bytesReadForToken, &cptr, &clen);
 			if (perror != PARSERUTILS_OK && 
 					perror != PARSERUTILS_EOF)
@@ -810,25 +873,19 @@ css_error Comment(css_lexer *lexer, css_token **token)
 				return emitToken(lexer, CSS_TOKEN_EOF, token);
 			}
 
-			c = *cptr;
-
-			APPEND(lexer, cptr, clen);
-
-			if (lexer->context.lastWasStar && c == '/')
+			len = scanCommentChars(cptr, clen, 
+					lexer->context.lastWasStar);
+			if (len < clen) {
+				/* Include the closing '/' */
+				APPEND(lexer, cptr, len + 1);
+				updatePosition(lexer, cptr, len + 1);
 				break;
-
-			lexer->context.lastWasStar = (c == '*');
-
-			if (c == '\n' || c == '\f') {
-				lexer->currentCol = 1;
-				lexer->currentLine++;
 			}
 
-			if (lexer->context.lastWasCR && c != '\n') {
-				lexer->currentCol = 1;
-				lexer->currentLine++;
-			}
-			lexer->context.lastWasCR = (c == '\r');
+			APPEND(lexer, cptr, clen);
+			updatePosition(lexer, cptr, clen);
+
+			lexer->context.lastWasStar = (cptr[clen - 1] == '*');
 		}
 	}
 
@@ -1161,6 +1218,12 @@ start:
 
 	/* Advance past the input read for the previous token */
 	if (lexer->bytesReadForToken > 0) {
+		if (lexer->capture != NULL) {
+			error = captureInput(lexer);
+			if (error != CSS_OK)
+				return error;
+		}
+
 		parserutils_inputstream_advance(
 				lexer->input, lexer->bytesReadForToken);
 		lexer->bytesReadForToken = 0;
@@ -1188,43 +1251,35 @@ start:
 
 	c = *cptr;
 
-	if (clen > 1 || c >= 0x80) {
-		lexer->state = sIDENT;
-		lexer->substate = 0;
-		return IdentOrFunction(lexer, token);
-	}
-
-	switch (c) {
-	case '@':
+	switch (charClass[c] & CHAR_START_MASK) {
+	case CHAR_START_ATKEYWORD:
 		lexer->state = sATKEYWORD;
 		lexer->substate = 0;
 		return AtKeyword(lexer, token);
-	case '"': case '\'':
+	case CHAR_START_STRING:
 		lexer->state = sSTRING;
 		lexer->substate = 0;
 		lexer->context.first = c;
 		return String(lexer, token);
-	case '#':
+	case CHAR_START_HASH:
 		lexer->state = sHASH;
 		lexer->substate = 0;
 		lexer->context.origBytes = lexer->bytesReadForToken;
 		return Hash(lexer, token);
-	case '0': case '1': case '2': case '3': case '4': 
-	case '5': case '6': case '7': case '8': case '9':
-	case '.': case '+':
+	case CHAR_START_NUMBER:
 		lexer->state = sNUMBER;
 		lexer->substate = 0;
 		lexer->context.first = c;
 		return NumberOrPercentageOrDimension(lexer, token);
-	case '<':
+	case CHAR_START_CDO:
 		lexer->state = sCDO;
 		lexer->substate = 0;
 		return CDO(lexer, token);
-	case '-':
+	case CHAR_START_CDC:
 		lexer->state = sCDC;
 		lexer->substate = 0;
 		return CDCOrIdentOrFunctionOrNPD(lexer, token);
-	case ' ': case '\t': case '\r': case '\n': case '\f':
+	case CHAR_START_S:
 		lexer->state = sS;
 		lexer->substate = 0;
 		if (c == '\n' || c == '\f') {
@@ -1233,7 +1288,7 @@ start:
 		}
 		lexer->context.lastWasCR = (c == '\r');
 		return S(lexer, token);
-	case '/':
+	case CHAR_START_COMMENT:
 		lexer->state = sCOMMENT;
 		lexer->substate = 0;
 		lexer->context.lastWasStar = false;
@@ -1243,30 +1298,20 @@ start:
 				(*token)->type == CSS_TOKEN_COMMENT)
 			goto start;
 		return error;
-	case '~': case '|': case '^': case '$': case '*':
+	case CHAR_START_MATCH:
 		lexer->state = sMATCH;
 		lexer->substate = 0;
 		lexer->context.first = c;
 		return Match(lexer, token);
-	case 'u': case 'U':
+	case CHAR_START_URI:
 		lexer->state = sURI;
 		lexer->substate = 0;
 		return URIOrUnicodeRangeOrIdentOrFunction(lexer, token);
-	case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': 
-	case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': 
-	case 'm': case 'n': case 'o': case 'p': case 'q': case 'r':
-	case 's': case 't': /*  'u'*/ case 'v': case 'w': case 'x': 
-	case 'y': case 'z':
-	case 'A': case 'B': case 'C': case 'D': case 'E': case 'F':
-	case 'G': case 'H': case 'I': case 'J': case 'K': case 'L':
-	case 'M': case 'N': case 'O': case 'P': case 'Q': case 'R':
-	case 'S': case 'T': /*  'U'*/ case 'V': case 'W': case 'X':
-	case 'Y': case 'Z':
-	case '_': 
+	case CHAR_START_IDENT:
 		lexer->state = sIDENT;
 		lexer->substate = 0;
 		return IdentOrFunction(lexer, token);
-	case '\\':
+	case CHAR_START_ESCAPEDIDENT:
 		lexer->state = sESCAPEDIDENT;
 		lexer->substate = 0;
 		return EscapedIdentOrFunction(lexer, token);
@@ -1792,15 +1837,16 @@ css_error consumeEscape(css_lexer *lexer, bool nl)
 css_error consumeNMChars(css_lexer *lexer)
 {
 	const uint8_t *cptr;
-	uint8_t c;
 	size_t clen;
 	css_error error;
 	parserutils_error perror;
 
 	/* nmchar = [a-zA-Z] | '-' | '_' | nonascii | escape */
 
-	do {
-		perror = parserutils_inputstream_peek(lexer->input, 
+	while (1) {
+		size_t span;
+
+		perror = parserutils_inputstream_peek_span(lexer->input,
 				lexer->bytesReadForToken, &cptr, &clen);
 		if (perror != PARSERUTILS_OK && perror != PARSERUTILS_EOF)
 			return css_error_from_parserutils_error(perror);
@@ -1808,34 +1854,36 @@ css_error consumeNMChars(css_lexer *lexer)
 		if (perror == PARSERUTILS_EOF)
 			return CSS_OK;
 
-		c = *cptr;
-
-		if (startNMChar(c) && c != '\\') {
-			APPEND(lexer, cptr, clen);
+		span = scanNMChars(cptr, clen);
+		if (span > 0) {
+			APPEND(lexer, cptr, span);
+			continue;
 		}
 
-		if (c == '\\') {
-			lexer->bytesReadForToken += clen;
+		/* The run stopped at an escape or at the end of the sequence */
+		if (*cptr != '\\')
+			break;
 
-			error = consumeEscape(lexer, false);
-			if (error != CSS_OK) {
-				/* Rewind '\\', so we do the 
-				 * right thing next time */
-				lexer->bytesReadForToken -= clen;
-
-				/* Convert either EOF or INVALID into OK.
-				 * This will cause the caller to believe that
-				 * all NMChars in the sequence have been 
-				 * processed (and thus proceed to the next
-				 * state). Eventually, the '\\' will be output
-				 * as a CHAR. */
-				if (error == CSS_EOF || error == CSS_INVALID)
-					return CSS_OK;
+		lexer->bytesReadForToken += 1;
 
-				return error;
-			}
+		error = consumeEscape(lexer, false);
+		if (error != CSS_OK) {
+			/* Rewind '\\', so we do the 
+			 * right thing next time */
+			lexer->bytesReadForToken -= 1;
+
+			/* Convert either EOF or INVALID into OK.
+			 * This will cause the caller to believe that
+			 * all NMChars in the sequence have been 
+			 * processed (and thus proceed to the next
+			 * state). Eventually, the '\\' will be output
+			 * as a CHAR. */
+			if (error == CSS_EOF || error == CSS_INVALID)
+				return CSS_OK;
+
+			return error;
 		}
-	} while (startNMChar(c));
+	}
 
 	return CSS_OK;
 }
@@ -1887,15 +1935,16 @@ css_error consumeString(css_lexer *lexer)
 css_error consumeStringChars(css_lexer *lexer)
 {
 	const uint8_t *cptr;
-	uint8_t c;
 	size_t clen;
 	css_error error;
 	parserutils_error perror;
 
 	/* stringchar = urlchar | ' ' | ')' | '\' nl */
 
-	do {
-		perror = parserutils_inputstream_peek(lexer->input,
+	while (1) {
+		size_t span;
+
+		perror = parserutils_inputstream_peek_span(lexer->input,
 				lexer->bytesReadForToken, &cptr, &clen);
 		if (perror != PARSERUTILS_OK && perror != PARSERUTILS_EOF)
 			return css_error_from_parserutils_error(perror);
@@ -1903,32 +1952,34 @@ css_error consumeStringChars(css_lexer *lexer)
 		if (perror == PARSERUTILS_EOF)
 			return CSS_OK;
 
-		c = *cptr;
-
-		if (startStringChar(c) && c != '\\') {
-			APPEND(lexer, cptr, clen);
+		span = scanStringChars(cptr, clen);
+		if (span > 0) {
+			APPEND(lexer, cptr, span);
+			continue;
 		}
 
-		if (c == '\\') {
-			lexer->bytesReadForToken += clen;
+		/* The run stopped at an escape or at the end of the sequence */
+		if (*cptr != '\\')
+			break;
 
-			error = consumeEscape(lexer, true);
-			if (error != CSS_OK) {
-				/* Convert EOF to OK. This causes the caller
-				 * to believe that all StringChars have been
-				 * processed. Eventually, the '\\' will be
-				 * output as a CHAR. */
-				if (error == CSS_EOF)
-					return CSS_OK;
+		lexer->bytesReadForToken += 1;
 
-				/* Rewind '\\', so we do the
-				 * right thing next time. */
-				lexer->bytesReadForToken -= clen;
+		error = consumeEscape(lexer, true);
+		if (error != CSS_OK) {
+			/* Convert EOF to OK. This causes the caller
+			 * to believe that all StringChars have been
+			 * processed. Eventually, the '\\' will be
+			 * output as a CHAR. */
+			if (error == CSS_EOF)
+				return CSS_OK;
+
+			/* Rewind '\\', so we do the
+			 * right thing next time. */
+			lexer->bytesReadForToken -= 1;
 
-				return error;
-			}
+			return error;
 		}
-	} while (startStringChar(c));
+	}
 
 	return CSS_OK;
 
@@ -2061,15 +2112,16 @@ css_error consumeUnicode(css_lexer *lexer, uint32_t ucs)
 css_error consumeURLChars(css_lexer *lexer)
 {
 	const uint8_t *cptr;
-	uint8_t c;
 	size_t clen;
 	css_error error;
 	parserutils_error perror;
 
 	/* urlchar = [\t!#-&(*-~] | nonascii | escape */
 
-	do {
-		perror = parserutils_inputstream_peek(lexer->input, 
+	while (1) {
+		size_t span;
+
+		perror = parserutils_inputstream_peek_span(lexer->input,
 				lexer->bytesReadForToken, &cptr, &clen);
 		if (perror != PARSERUTILS_OK && perror != PARSERUTILS_EOF)
 			return css_error_from_parserutils_error(perror);
@@ -2077,34 +2129,36 @@ css_error consumeURLChars(css_lexer *lexer)
 		if (perror == PARSERUTILS_EOF)
 			return CSS_OK;
 
-		c = *cptr;
-
-		if (startURLChar(c) && c != '\\') {
-			APPEND(lexer, cptr, clen);
+		span = scanURLChars(cptr, clen);
+		if (span > 0) {
+			APPEND(lexer, cptr, span);
+			continue;
 		}
 
-		if (c == '\\') {
-			lexer->bytesReadForToken += clen;
+		/* The run stopped at an escape or at the end of the sequence */
+		if (*cptr != '\\')
+			break;
 
-			error = consumeEscape(lexer, false);
-			if (error != CSS_OK) {
-				/* Rewind '\\', so we do the
-				 * right thing next time */
-				lexer->bytesReadForToken -= clen;
-
-				/* Convert either EOF or INVALID into OK.
-				 * This will cause the caller to believe that
-				 * all URLChars in the sequence have been 
-				 * processed (and thus proceed to the next
-				 * state). Eventually, the '\\' will be output
-				 * as a CHAR. */
-				if (error == CSS_EOF || error == CSS_INVALID)
-					return CSS_OK;
+		lexer->bytesReadForToken += 1;
 
-				return error;
-			}
+		error = consumeEscape(lexer, false);
+		if (error != CSS_OK) {
+			/* Rewind '\\', so we do the
+			 * right thing next time */
+			lexer->bytesReadForToken -= 1;
+
+			/* Convert either EOF or INVALID into OK.
+			 * This will cause the caller to believe that
+			 * all URLChars in the sequence have been 
+			 * processed (and thus proceed to the next
+			 * state). Eventually, the '\\' will be output
+			 * as a CHAR. */
+			if (error == CSS_EOF || error == CSS_INVALID)
+				return CSS_OK;
+
+			return error;
 		}
-	} while (startURLChar(c));
+	}
 
 	return CSS_OK;
 }
@@ -2112,12 +2166,11 @@ css_error consumeURLChars(css_lexer *lexer)
 css_error consumeWChars(css_lexer *lexer)
 {
 	const uint8_t *cptr;
-	uint8_t c;
 	size_t clen;
 	parserutils_error perror;
 
-	do {
-		perror = parserutils_inputstream_peek(lexer->input, 
+	while (1) {
+		perror = parserutils_inputstream_peek_span(lexer->input, 
 				lexer->bytesReadForToken, &cptr, &clen);
 		if (perror != PARSERUTILS_OK && perror != PARSERUTILS_EOF)
 			return css_error_from_parserutils_error(perror);
@@ -2125,27 +2178,19 @@ css_error consumeWChars(css_lexer *lexer)
 		if (perror == PARSERUTILS_EOF)
 			return CSS_OK;
 
-		c = *cptr;
-
-		if (isSpace(c)) {
-			APPEND(lexer, cptr, clen);
-		}
+		clen = scanWChars(cptr, clen);
+		if (clen == 0)
+			break;
 
-		if (c == '\n' || c == '\f') {
-			lexer->currentCol = 1;
-			lexer->currentLine++;
-		}
+		APPEND(lexer, cptr, clen);
 
-		if (lexer->context.lastWasCR && c != '\n') {
-			lexer->currentCol = 1;
-			lexer->currentLine++;
-		}
-		lexer->context.lastWasCR = (c == '\r');
-	} while (isSpace(c));
+		updatePosition(lexer, cptr, clen);
+	}
 
 	if (lexer->context.lastWasCR) {
 		lexer->currentCol = 1;
 		lexer->currentLine++;
+		lexer->context.lastWasCR = false;
 	}
 
 	return CSS_OK;
@@ -2155,31 +2200,88 @@ css_error consumeWChars(css_lexer *lexer)
  * More utility routines                                                      *
  ******************************************************************************/
 
-bool startNMChar(uint8_t c)
+/**
+ * Update the current line and column for a run of consumed input
+ *
+ * \param lexer  The lexer instance
+ * \param data   Pointer to the run, which has already been APPENDed
+ * \param len    Length, in bytes, of the run
+ *
+ * LF, FF and CR not followed by LF each start a new line. A trailing CR is
+ * recorded in the lexer context, as the LF that completes it may be in the
+ * next run.
+ */
+void updatePosition(css_lexer *lexer, const uint8_t *data, size_t len)
 {
-	return c == '_' || ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || 
-		('0' <= c && c <= '9') || c == '-' || c >= 0x80 || c == '\\';
-}
+	const uint8_t *end = data + len;
+	const uint8_t *line = NULL;
+	bool lastWasCR = lexer->context.lastWasCR;
+	uint32_t lines = 0;
 
-bool startNMStart(uint8_t c)
-{
-	return c == '_' || ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') ||
-		c >= 0x80 || c == '\\';
-}
+	while (data < end) {
+		uint8_t c;
 
-bool startStringChar(uint8_t c)
-{
-	return startURLChar(c) || c == ' ' || c == ')';
-}
+		if (lastWasCR == false) {
+			data += scanPlainChars(data, end - data);
+			if (data == end)
+				break;
+		}
 
-bool startURLChar(uint8_t c)
-{
-	return c == '\t' || c == '!' || ('#' <= c && c <= '&') || c == '(' ||
-		('*' <= c && c <= '~') || c >= 0x80 || c == '\\';
+		c = *data++;
+
+		if (c == '\n' || c == '\f' || (lastWasCR && c != '\n')) {
+			lines++;
+			line = data;
+		}
+
+		/* FF following CR is two line breaks */
+		if (lastWasCR && c == '\f')
+			lines++;
+
+		lastWasCR = (c == '\r');
+	}
+
+	lexer->context.lastWasCR = lastWasCR;
+
+	/* APPEND has already advanced the column past the whole run */
+	if (lines > 0) {
+		lexer->currentCol = 1 + (end - line);
+		lexer->currentLine += lines;
+	}
 }
 
-bool isSpace(uint8_t c)
+/**
+ * Append the input read for the previous token to the capture buffer
+ *
+ * \param lexer  The lexer instance
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The input has been read, so is available in the stream until the lexer 
+ * advances past it.
+ */
+css_error captureInput(css_lexer *lexer)
 {
-	return c == ' ' || c == '\r' || c == '\n' || c == '\f' || c == '\t';
-}
+	const uint8_t *cptr;
+	size_t clen, offset = lexer->captureSkip;
+	parserutils_error perror;
+
+	lexer->captureSkip = 0;
 
+	while (offset < lexer->bytesReadForToken) {
+		perror = parserutils_inputstream_peek_span(lexer->input, 
+				offset, &cptr, &clen);
+		if (perror != PARSERUTILS_OK)
+			return css_error_from_parserutils_error(perror);
+
+		if (clen > lexer->bytesReadForToken - offset)
+			clen = lexer->bytesReadForToken - offset;
+
+		perror = parserutils_buffer_append(lexer->capture, cptr, clen);
+		if (perror != PARSERUTILS_OK)
+			return css_error_from_parserutils_error(perror);
+
+		offset += clen;
+	}
+
+	return CSS_OK;
+}
@@ -15,6 +15,7 @@
 #include "../../include/libcss/types.h"
 
 #include "../../../libparserutils/include/parserutils/input/inputstream.h"
+#include "../../../libparserutils/include/parserutils/utils/buffer.h"
 
 typedef struct css_lexer css_lexer;
 
@@ -37,18 +38,27 @@ typedef union css_lexer_optparams {
  */
 typedef enum css_token_type { 
 	CSS_TOKEN_IDENT, CSS_TOKEN_ATKEYWORD, CSS_TOKEN_HASH,
-	CSS_TOKEN_FUNCTION, CSS_TOKEN_STRING, CSS_TOKEN_INVALID_STRING, 
-	CSS_TOKEN_URI, CSS_TOKEN_UNICODE_RANGE, CSS_TOKEN_CHAR, 
-	CSS_TOKEN_NUMBER, CSS_TOKEN_PERCENTAGE, CSS_TOKEN_DIMENSION,
+	CSS_TOKEN_FUNCTION, CSS_TOKEN_STRING, CSS_TOKEN_URI, 
 
 	/* Those tokens that want strings interned appear above */
 	CSS_TOKEN_LAST_INTERN,
 
+	CSS_TOKEN_INVALID_STRING, CSS_TOKEN_UNICODE_RANGE, CSS_TOKEN_CHAR, 
+	CSS_TOKEN_NUMBER, CSS_TOKEN_PERCENTAGE, CSS_TOKEN_DIMENSION,
+
+	/* Those tokens whose text is kept, uninterned, appear above */
+	CSS_TOKEN_LAST_DATA,
+
  	CSS_TOKEN_CDO, CSS_TOKEN_CDC, CSS_TOKEN_S, CSS_TOKEN_COMMENT, 
 	CSS_TOKEN_INCLUDES, CSS_TOKEN_DASHMATCH, CSS_TOKEN_PREFIXMATCH, 
 	CSS_TOKEN_SUFFIXMATCH, CSS_TOKEN_SUBSTRINGMATCH, CSS_TOKEN_EOF 
 } css_token_type;
 
+/**
+ * Unit of a DIMENSION token whose unit is not recognised
+ */
+#define CSS_TOKEN_UNIT_UNKNOWN (UINT32_MAX)
+
 /**
  * Token object
  */
@@ -61,6 +71,14 @@ typedef struct css_token {
         } data;
 
 	lwc_string *idata;
+
+	/** Decoded value of NUMBER, PERCENTAGE and DIMENSION tokens */
+	struct {
+		css_fixed value;	/**< Numeric value */
+		size_t len;		/**< Length of the number in data */
+		bool integer;		/**< Number has no fractional part */
+		uint32_t unit;		/**< Unit of a DIMENSION */
+	} number;
 	
 	uint32_t col;
 	uint32_t line;
@@ -72,6 +90,8 @@ css_error css__lexer_destroy(css_lexer *lexer);
 css_error css__lexer_setopt(css_lexer *lexer, css_lexer_opttype type, 
 		css_lexer_optparams *params);
 
+css_error css__lexer_capture(css_lexer *lexer, parserutils_buffer *buffer);
+
 css_error css__lexer_get_token(css_lexer *lexer, css_token **token);
 
 #endif
@@ -0,0 +1,497 @@
+/*
+ * This file is part of LibCSS.
+ * Licensed under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+/** \file Structural pre-scanner
+ *
+ * The pre-scanner finds the extent of each top-level rule in a stylesheet
+ * without tokenising it, so that rules may be shared between parsers or
+ * skipped cheaply.
+ *
+ * Only the bytes which may affect the structure of the data -- brackets,
+ * quotes, comments, escapes and the ';' ending an at-rule -- are looked at
+ * individually; the bytes between them are skipped a block at a time.
+ * Strings, comments, escapes and url()s are skipped with the lexer's run
+ * scanners, following the lexer's rules for where each ends and what
+ * happens when one is malformed, so that the pre-scanner sees the same
+ * tokens as the lexer would.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../lex/prescan.h"
+#include "../lex/scan.h"
+#include "../utils/utils.h"
+
+/** Deepest nesting of brackets tracked */
+#define PRESCAN_MAX_DEPTH (256)
+
+/** No offset recorded */
+#define NO_OFFSET ((size_t) -1)
+
+static size_t skipEscape(const uint8_t *data, size_t len, size_t pos,
+		bool nl);
+static size_t skipString(const uint8_t *data, size_t len, size_t pos,
+		bool *valid);
+static size_t skipComment(const uint8_t *data, size_t len, size_t pos);
+static size_t skipURI(const uint8_t *data, size_t len, size_t pos);
+static bool startsURI(const uint8_t *data, size_t pos, size_t escapeEnd);
+static size_t ruleStart(const uint8_t *data, size_t len, size_t pos);
+static css_error addRule(css_prescan_rule **rules, size_t *n_rules,
+		size_t *allocated, size_t start, size_t block, size_t end);
+
+static inline unsigned int lowestBit(uint64_t mask)
+{
+#ifdef __GNUC__
+	return __builtin_ctzll(mask);
+#else
+	unsigned int i = 0;
+
+	for (; (mask & 1) == 0; mask >>= 1)
+		i++;
+
+	return i;
+#endif
+}
+
+/**
+ * Find the top-level rules in a stylesheet's data
+ *
+ * \param data     The data to scan, in UTF-8
+ * \param len      Length, in bytes, of data
+ * \param rules    Pointer to location to receive array of rules
+ * \param n_rules  Pointer to location to receive number of rules
+ * \return CSS_OK on success,
+ *         CSS_BADPARM on bad parameters,
+ *         CSS_NOMEM on memory exhaustion,
+ *         CSS_INVALID if the data's brackets are unbalanced
+ *
+ * A rule ends at the '}' closing its block or, for an at-rule without a
+ * block, at its ';'. Rules are listed in source order. Any incomplete rule
+ * at the end of the data is not listed. If CSS_INVALID is returned, the
+ * rules before the unbalanced bracket are listed.
+ *
+ * The client must free the array of rules, which is NULL if there are
+ * none.
+ */
+css_error css__prescan(const uint8_t *data, size_t len,
+		css_prescan_rule **rules, size_t *n_rules)
+{
+	uint8_t closers[PRESCAN_MAX_DEPTH];
+	size_t depth = 0, allocated = 0, pos = 0;
+	size_t from = 0;		/* Offset to look for next rule from */
+	size_t first = NO_OFFSET;	/* Offset of current rule's start */
+	size_t block = NO_OFFSET;	/* Offset of current rule's block */
+	size_t escapeEnd = NO_OFFSET;	/* Offset after last escape */
+	css_error error = CSS_OK;
+
+	if (data == NULL || rules == NULL || n_rules == NULL)
+		return CSS_BADPARM;
+
+	*rules = NULL;
+	*n_rules = 0;
+
+	while (pos < len) {
+		size_t base = pos;
+		size_t span = (len - pos < 64) ? len - pos : 64;
+		uint64_t semicolons;
+		uint64_t mask = structuralMask(data + pos, len - pos,
+				&semicolons);
+
+		/* Visit each byte of the block that may be structural,
+		 * skipping any consumed along with an earlier one, and
+		 * any ';' inside brackets */
+		while ((depth == 0 ? mask : mask & ~semicolons) != 0) {
+			uint8_t c;
+
+			pos = base + lowestBit(depth == 0 ? mask :
+					mask & ~semicolons);
+			c = data[pos];
+
+			switch (c) {
+			case '(':
+				if (startsURI(data, pos, escapeEnd)) {
+					size_t end = skipURI(data, len, pos + 1);
+
+					if (end != 0) {
+						pos = end;
+						break;
+					}
+
+					/* Otherwise, "url(" is a FUNCTION */
+				}
+				/* Fall through */
+			case '[':
+			case '{':
+				if (depth == PRESCAN_MAX_DEPTH) {
+					error = CSS_INVALID;
+					goto out;
+				}
+
+				if (depth == 0 && c == '{')
+					block = pos;
+
+				closers[depth++] = (c == '(') ? ')' : c + 2;
+				pos++;
+				break;
+			case ')':
+			case ']':
+			case '}':
+				if (depth == 0 || closers[depth - 1] != c) {
+					error = CSS_INVALID;
+					goto out;
+				}
+
+				pos++;
+
+				if (--depth == 0 && c == '}') {
+					if (first == NO_OFFSET)
+						first = ruleStart(data, len, from);
+
+					error = addRule(rules, n_rules,
+							&allocated, first,
+							block, pos);
+					if (error != CSS_OK)
+						goto out;
+
+					from = pos;
+					first = block = NO_OFFSET;
+				}
+				break;
+			case ';':
+				/* Only an at-rule ends at a top-level ';' */
+				pos++;
+
+				if (first == NO_OFFSET)
+					first = ruleStart(data, len, from);
+
+				if (data[first] == '@' && first + 1 < len &&
+						startNMStart(data[first + 1])) {
+					error = addRule(rules, n_rules,
+							&allocated, first,
+							pos, pos);
+					if (error != CSS_OK)
+						goto out;
+
+					from = pos;
+					first = block = NO_OFFSET;
+				}
+				break;
+			case '"':
+			case '\'':
+				pos = skipString(data, len, pos, NULL);
+				break;
+			case '/':
+				if (pos + 1 < len && data[pos + 1] == '*')
+					pos = skipComment(data, len, pos);
+				else
+					pos++;
+				break;
+			case '\\':
+			{
+				size_t end = skipEscape(data, len, pos, false);
+
+				/* If it's not an escape, '\' is a CHAR */
+				if (end == pos)
+					pos++;
+				else
+					pos = escapeEnd = end;
+			}
+				break;
+			default:
+				/* Not structural after all */
+				pos++;
+				break;
+			}
+
+			if (pos - base >= span)
+				break;
+
+			mask &= ~(uint64_t) 0 << (pos - base);
+		}
+
+		if (pos < base + span)
+			pos = base + span;
+	}
+
+out:
+	if (error == CSS_NOMEM) {
+		free(*rules);
+		*rules = NULL;
+		*n_rules = 0;
+	}
+
+	return error;
+}
+
+/**
+ * Skip an escape
+ *
+ * \param data  Data to scan
+ * \param len   Length, in bytes, of data
+ * \param pos   Offset of the '\' introducing the escape
+ * \param nl    Whether an escaped newline is permitted
+ * \return Offset of the byte after the escape, or \a pos if there is none
+ */
+size_t skipEscape(const uint8_t *data, size_t len, size_t pos, bool nl)
+{
+	size_t i = pos + 1, digits;
+	uint8_t c;
+
+	/* escape = unicode | '\' [^\n\r\f0-9a-fA-F]
+	 * unicode = '\' [0-9a-fA-F]{1,6} wc? */
+
+	if (i == len)
+		return pos;
+
+	c = data[i];
+
+	if (c == '\n' || c == '\r' || c == '\f') {
+		if (nl == false)
+			return pos;
+
+		if (c == '\r' && i + 1 < len && data[i + 1] == '\n')
+			i++;
+
+		return i + 1;
+	}
+
+	if (isHex(c) == false)
+		return i + 1;
+
+	for (digits = 0; i < len && digits < 6 && isHex(data[i]); digits++)
+		i++;
+
+	if (i + 1 < len && data[i] == '\r' && data[i + 1] == '\n')
+		i += 2;
+	else if (i < len && isSpace(data[i]))
+		i++;
+
+	return i;
+}
+
+/**
+ * Skip a string
+ *
+ * \param data   Data to scan
+ * \param len    Length, in bytes, of data
+ * \param pos    Offset of the string's opening quote
+ * \param valid  Pointer to location to receive whether the string is
+ *               terminated, or NULL
+ * \return Offset of the byte after the string
+ *
+ * As in the lexer, an invalid string ends before the first character that
+ * may not appear in a string, such as a newline.
+ */
+size_t skipString(const uint8_t *data, size_t len, size_t pos, bool *valid)
+{
+	uint8_t quote = data[pos++];
+	bool terminated = false;
+
+	while (pos < len) {
+		uint8_t c;
+
+		pos += scanStringChars(data + pos, len - pos);
+		if (pos == len)
+			break;
+
+		c = data[pos];
+
+		if (c == quote) {
+			terminated = true;
+			pos++;
+			break;
+		} else if (c == '"' || c == '\'') {
+			pos++;
+		} else if (c == '\\') {
+			size_t end = skipEscape(data, len, pos, true);
+
+			if (end == pos) {
+				pos = len;
+				break;
+			}
+
+			pos = end;
+		} else {
+			/* Invalid character in string */
+			break;
+		}
+	}
+
+	if (valid != NULL)
+		*valid = terminated;
+
+	return pos;
+}
+
+/**
+ * Skip a comment
+ *
+ * \param data  Data to scan
+ * \param len   Length, in bytes, of data
+ * \param pos   Offset of the "/" "*" opening the comment
+ * \return Offset of the byte after the comment, or \a len if unterminated
+ */
+size_t skipComment(const uint8_t *data, size_t len, size_t pos)
+{
+	size_t end;
+
+	pos += 2;
+
+	end = scanCommentChars(data + pos, len - pos, false);
+	if (end == len - pos)
+		return len;
+
+	return pos + end + 1;
+}
+
+/**
+ * Skip the remainder of a URI token
+ *
+ * \param data  Data to scan
+ * \param len   Length, in bytes, of data
+ * \param pos   Offset of the byte after "url("
+ * \return Offset of the byte after the closing ')', or 0 if the data
+ *         does not form a URI, in which case the lexer reads "url(" as
+ *         a FUNCTION
+ */
+size_t skipURI(const uint8_t *data, size_t len, size_t pos)
+{
+	/* URI = "url(" w (string | urlchar*) w ')' */
+
+	pos += scanWChars(data + pos, len - pos);
+
+	if (pos < len && (data[pos] == '"' || data[pos] == '\'')) {
+		bool valid;
+
+		pos = skipString(data, len, pos, &valid);
+		if (valid == false)
+			return 0;
+	} else {
+		while (pos < len) {
+			size_t end;
+
+			pos += scanURLChars(data + pos, len - pos);
+			if (pos == len || data[pos] != '\\')
+				break;
+
+			end = skipEscape(data, len, pos, false);
+			if (end == pos)
+				break;
+
+			pos = end;
+		}
+	}
+
+	pos += scanWChars(data + pos, len - pos);
+
+	if (pos == len || data[pos] != ')')
+		return 0;
+
+	return pos + 1;
+}
+
+/**
+ * Determine whether a '(' completes "url(" at the start of a token
+ *
+ * \param data       Data to scan
+ * \param pos        Offset of the '('
+ * \param escapeEnd  Offset of the byte after the last escape seen
+ * \return True if the lexer would read a URI here, false otherwise
+ */
+bool startsURI(const uint8_t *data, size_t pos, size_t escapeEnd)
+{
+	uint8_t c;
+
+	if (pos < 3 || (data[pos - 3] | 0x20) != 'u' ||
+			(data[pos - 2] | 0x20) != 'r' ||
+			(data[pos - 1] | 0x20) != 'l')
+		return false;
+
+	if (pos == 3)
+		return true;
+
+	/* Otherwise, "url" must not continue a name, as it does after a
+	 * name character, an escape, '#' (HASH) or '@' (ATKEYWORD) */
+	c = data[pos - 4];
+
+	return pos - 3 != escapeEnd && startNMChar(c) == false &&
+			c != '#' && c != '@';
+}
+
+/**
+ * Find the first byte of a top-level rule
+ *
+ * \param data  Data to scan
+ * \param len   Length, in bytes, of data
+ * \param pos   Offset of the end of the previous rule, or 0
+ * \return Offset of the rule's first byte
+ *
+ * Whitespace, comments, CDO and CDC between rules belong to none of them.
+ */
+size_t ruleStart(const uint8_t *data, size_t len, size_t pos)
+{
+	/* The input stream strips any UTF-8 BOM */
+	if (pos == 0 && len >= 3 && data[0] == 0xEF && data[1] == 0xBB &&
+			data[2] == 0xBF)
+		pos = 3;
+
+	while (pos < len) {
+		pos += scanWChars(data + pos, len - pos);
+
+		if (pos + 1 < len && data[pos] == '/' && data[pos + 1] == '*')
+			pos = skipComment(data, len, pos);
+		else if (len - pos >= SLEN("<!--") &&
+				memcmp(data + pos, "<!--", SLEN("<!--")) == 0)
+			pos += SLEN("<!--");
+		else if (len - pos >= SLEN("-->") &&
+				memcmp(data + pos, "-->", SLEN("-->")) == 0)
+			pos += SLEN("-->");
+		else
+			break;
+	}
+
+	return pos;
+}
+
+/**
+ * Append a rule to an array of rules
+ *
+ * \param rules      Pointer to array of rules, updated on exit
+ * \param n_rules    Pointer to number of rules in array, updated on exit
+ * \param allocated  Pointer to number of rules allocated, updated on exit
+ * \param start      Offset of the rule's first byte
+ * \param block      Offset of the rule's block
+ * \param end        Offset of the byte after the rule
+ * \return CSS_OK on success, CSS_NOMEM on memory exhaustion
+ */
+css_error addRule(css_prescan_rule **rules, size_t *n_rules,
+		size_t *allocated, size_t start, size_t block, size_t end)
+{
+	css_prescan_rule *rule;
+
+	if (*n_rules == *allocated) {
+		size_t n = (*allocated == 0) ? 64 : *allocated * 2;
+		css_prescan_rule *temp;
+
+		temp = realloc(*rules, n * sizeof(css_prescan_rule));
+		if (temp == NULL)
+			return CSS_NOMEM;
+
+		*rules = temp;
+		*allocated = n;
+	}
+
+	rule = &(*rules)[(*n_rules)++];
+
+	rule->start = start;
+	rule->block = (block == NO_OFFSET) ? end : block;
+	rule->end = end;
+
+	return CSS_OK;
+}
+
@@ -0,0 +1,29 @@
+/*
+ * This file is part of LibCSS.
+ * Licensed under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+#ifndef css_lex_prescan_h_
+#define css_lex_prescan_h_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../include/libcss/errors.h"
+
+/**
+ * Extent of a top-level rule in a stylesheet's data
+ */
+typedef struct css_prescan_rule {
+	size_t start;		/**< Offset of the rule's first byte */
+	size_t block;		/**< Offset of the '{' opening the rule's
+				 * block, or of its end if it has none */
+	size_t end;		/**< Offset of the byte after the rule */
+} css_prescan_rule;
+
+css_error css__prescan(const uint8_t *data, size_t len,
+		css_prescan_rule **rules, size_t *n_rules);
+
+#endif
+
@@ -0,0 +1,562 @@
+/*
+ * This file is part of LibCSS.
+ * Licensed under the MIT License,
+ *                http://www.opensource.org/licenses/mit-license.php
+ */
+
+#ifndef css_lex_scan_h_
+#define css_lex_scan_h_
+
+/** \file Lexer character classes and run scanners
+ *
+ * The scan*() routines return the length of the run of characters at the
+ * start of data that belong to a class and so may be appended to the
+ * current token without further inspection. Runs stop at escapes. Bytes
+ * >= 0x80 are always accepted, so multibyte characters are consumed whole.
+ *
+ * Both the scalar predicates and the lexer's dispatch on the first
+ * character of a token use a single table of character classes, which is
+ * generated at compile time from the class definitions below.
+ *
+ * structuralMask() picks out the bytes of a block which may affect the
+ * structure of a stylesheet, for the pre-scanner.
+ *
+ * Where the compiler targets SSE2 (the x86-64 baseline) the scanners
+ * examine 16 bytes at a time, or 32 bytes at a time when built with AVX2
+ * (e.g. -mavx2). Otherwise, or for the tail of a run, they fall back to the
+ * portable character predicates.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__SSE2__) && defined(__GNUC__)
+#define CSS_SCAN_SSE2
+#include <emmintrin.h>
+#if defined(__AVX2__)
+#define CSS_SCAN_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+/******************************************************************************
+ * Character classes                                                          *
+ ******************************************************************************/
+
+/**
+ * Start classes: the kind of token that each first character may begin.
+ * These occupy the low bits of the class table entries.
+ */
+enum {
+	CHAR_START_CHAR		=  0,
+	CHAR_START_ATKEYWORD	=  1,
+	CHAR_START_STRING	=  2,
+	CHAR_START_HASH		=  3,
+	CHAR_START_NUMBER	=  4,
+	CHAR_START_CDO		=  5,
+	CHAR_START_CDC		=  6,
+	CHAR_START_S		=  7,
+	CHAR_START_COMMENT	=  8,
+	CHAR_START_MATCH	=  9,
+	CHAR_START_URI		= 10,
+	CHAR_START_IDENT	= 11,
+	CHAR_START_ESCAPEDIDENT	= 12,
+
+	CHAR_START_MASK		= 0x000f
+};
+
+/**
+ * Character class flags. Bar CHAR_STRUCTURAL, none of these include '\',
+ * which has its own flag, as runs of each class stop at escapes.
+ */
+enum {
+	CHAR_NMSTART	= 0x0010,	/**< [a-zA-Z_] | nonascii */
+	CHAR_NMCHAR	= 0x0020,	/**< [a-zA-Z0-9_-] | nonascii */
+	CHAR_URLCHAR	= 0x0040,	/**< [\t!#-&(*-~] | nonascii */
+	CHAR_STRINGCHAR	= 0x0080,	/**< urlchar | ' ' | ')' */
+	CHAR_SPACE	= 0x0100,	/**< [ \t\r\n\f] */
+	CHAR_ESCAPE	= 0x0200,	/**< '\' */
+	CHAR_STRUCTURAL	= 0x0400	/**< [{}()[\]"'/\\;] */
+};
+
+/* Class definitions, from which the table is generated */
+#define CC_ALPHA(c) (('a' <= (c) && (c) <= 'z') || ('A' <= (c) && (c) <= 'Z'))
+#define CC_DIGIT(c) ('0' <= (c) && (c) <= '9')
+#define CC_NMSTART(c) (CC_ALPHA(c) || (c) == '_' || (c) >= 0x80)
+#define CC_NMCHAR(c) (CC_NMSTART(c) || CC_DIGIT(c) || (c) == '-')
+#define CC_URLCHAR(c) ((c) == '\t' || (c) == '!' ||			\
+		('#' <= (c) && (c) <= '&') || (c) == '(' ||		\
+		('*' <= (c) && (c) <= '~' && (c) != '\\') || (c) >= 0x80)
+#define CC_STRINGCHAR(c) (CC_URLCHAR(c) || (c) == ' ' || (c) == ')')
+#define CC_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' ||	\
+		(c) == '\n' || (c) == '\f')
+
+#define CC_STRUCTURAL(c) ((c) == '{' || (c) == '}' || (c) == '(' ||	\
+		(c) == ')' || (c) == '[' || (c) == ']' || (c) == '"' ||	\
+		(c) == '\'' || (c) == '/' || (c) == '\\' || (c) == ';')
+
+#define CC_START(c)							\
+	((c) >= 0x80 ? CHAR_START_IDENT :				\
+	(c) == '@' ? CHAR_START_ATKEYWORD :				\
+	(c) == '"' || (c) == '\'' ? CHAR_START_STRING :			\
+	(c) == '#' ? CHAR_START_HASH :					\
+	CC_DIGIT(c) || (c) == '.' || (c) == '+' ? CHAR_START_NUMBER :	\
+	(c) == '<' ? CHAR_START_CDO :					\
+	(c) == '-' ? CHAR_START_CDC :					\
+	CC_SPACE(c) ? CHAR_START_S :					\
+	(c) == '/' ? CHAR_START_COMMENT :				\
+	(c) == '~' || (c) == '|' || (c) == '^' || (c) == '$' ||	\
+			(c) == '*' ? CHAR_START_MATCH :			\
+	(c) == 'u' || (c) == 'U' ? CHAR_START_URI :			\
+	CC_ALPHA(c) || (c) == '_' ? CHAR_START_IDENT :			\
+	(c) == '\\' ? CHAR_START_ESCAPEDIDENT :				\
+	CHAR_START_CHAR)
+
+#define CC(c) (CC_START(c) |						\
+	(CC_NMSTART(c) ? CHAR_NMSTART : 0) |				\
+	(CC_NMCHAR(c) ? CHAR_NMCHAR : 0) |				\
+	(CC_URLCHAR(c) ? CHAR_URLCHAR : 0) |				\
+	(CC_STRINGCHAR(c) ? CHAR_STRINGCHAR : 0) |			\
+	(CC_SPACE(c) ? CHAR_SPACE : 0) |				\
+	((c) == '\\' ? CHAR_ESCAPE : 0) |				\
+	(CC_STRUCTURAL(c) ? CHAR_STRUCTURAL : 0))
+
+#define CC4(c) CC(c), CC((c) + 1), CC((c) + 2), CC((c) + 3)
+#define CC16(c) CC4(c), CC4((c) + 4), CC4((c) + 8), CC4((c) + 12)
+#define CC64(c) CC16(c), CC16((c) + 16), CC16((c) + 32), CC16((c) + 48)
+
+/**
+ * Class of each byte value: its start class, plus character class flags
+ */
+static const uint16_t charClass[256] = {
+	CC64(0x00), CC64(0x40), CC64(0x80), CC64(0xc0)
+};
+
+#undef CC64
+#undef CC16
+#undef CC4
+#undef CC
+#undef CC_START
+#undef CC_STRUCTURAL
+#undef CC_SPACE
+#undef CC_STRINGCHAR
+#undef CC_URLCHAR
+#undef CC_NMCHAR
+#undef CC_NMSTART
+#undef CC_DIGIT
+#undef CC_ALPHA
+
+static inline bool startNMChar(uint8_t c)
+{
+	return (charClass[c] & (CHAR_NMCHAR | CHAR_ESCAPE)) != 0;
+}
+
+static inline bool startNMStart(uint8_t c)
+{
+	return (charClass[c] & (CHAR_NMSTART | CHAR_ESCAPE)) != 0;
+}
+
+static inline bool startURLChar(uint8_t c)
+{
+	return (charClass[c] & (CHAR_URLCHAR | CHAR_ESCAPE)) != 0;
+}
+
+static inline bool startStringChar(uint8_t c)
+{
+	return (charClass[c] & (CHAR_STRINGCHAR | CHAR_ESCAPE)) != 0;
+}
+
+static inline bool isSpace(uint8_t c)
+{
+	return (charClass[c] & CHAR_SPACE) != 0;
+}
+
+/******************************************************************************
+ * Vector class masks                                                         *
+ ******************************************************************************/
+
+/* Each mask function sets the bytes of its result to 0xFF where the
+ * corresponding input byte belongs to the class, and to 0 otherwise. */
+
+#ifdef CSS_SCAN_SSE2
+
+#define EQ128(v, c) _mm_cmpeq_epi8((v), _mm_set1_epi8((char) (c)))
+
+static inline __m128i range128(__m128i v, uint8_t lo, uint8_t hi)
+{
+	/* lo <= v <= hi, as an unsigned comparison */
+	__m128i t = _mm_sub_epi8(v, _mm_set1_epi8((char) lo));
+
+	return _mm_cmpeq_epi8(_mm_min_epu8(t,
+			_mm_set1_epi8((char) (hi - lo))), t);
+}
+
+static inline __m128i nonascii128(__m128i v)
+{
+	return _mm_cmplt_epi8(v, _mm_setzero_si128());
+}
+
+static inline __m128i nmchars128(__m128i v)
+{
+	__m128i alpha = range128(_mm_or_si128(v, _mm_set1_epi8(0x20)),
+			'a', 'z');
+	__m128i other = _mm_or_si128(_mm_or_si128(EQ128(v, '-'),
+			EQ128(v, '_')), range128(v, '0', '9'));
+
+	return _mm_or_si128(_mm_or_si128(alpha, other), nonascii128(v));
+}
+
+static inline __m128i urlchars128(__m128i v)
+{
+	__m128i body = _mm_andnot_si128(EQ128(v, '\\'),
+			range128(v, '*', '~'));
+	__m128i other = _mm_or_si128(_mm_or_si128(EQ128(v, '\t'),
+			EQ128(v, '!')), _mm_or_si128(EQ128(v, '('),
+			range128(v, '#', '&')));
+
+	return _mm_or_si128(_mm_or_si128(body, other), nonascii128(v));
+}
+
+static inline __m128i stringchars128(__m128i v)
+{
+	__m128i stop = _mm_or_si128(_mm_or_si128(EQ128(v, '"'),
+			EQ128(v, '\'')), EQ128(v, '\\'));
+	__m128i body = _mm_andnot_si128(stop, range128(v, ' ', '~'));
+
+	return _mm_or_si128(_mm_or_si128(body, EQ128(v, '\t')),
+			nonascii128(v));
+}
+
+static inline __m128i wchars128(__m128i v)
+{
+	/* '\t', '\n', '\f' and '\r' are 0x09 - 0x0d, less '\v' */
+	__m128i ctrl = _mm_andnot_si128(EQ128(v, '\v'),
+			range128(v, '\t', '\r'));
+
+	return _mm_or_si128(ctrl, EQ128(v, ' '));
+}
+
+static inline __m128i plainchars128(__m128i v)
+{
+	/* Anything after '\r', which can't affect the line number */
+	return _mm_cmpeq_epi8(_mm_max_epu8(v, _mm_set1_epi8('\r' + 1)), v);
+}
+
+static inline __m128i structural128(__m128i v)
+{
+	/* Folding in 0x20 pairs '[' with '{', ']' with '}' and '\' with
+	 * '|', so this also matches '|', which its caller must ignore */
+	__m128i fold = _mm_or_si128(v, _mm_set1_epi8(0x20));
+	__m128i brackets = _mm_or_si128(_mm_or_si128(EQ128(fold, '{'),
+			EQ128(fold, '}')), _mm_or_si128(EQ128(fold, '|'),
+			EQ128(_mm_and_si128(v, _mm_set1_epi8((char) 0xfe)),
+			'(')));
+	__m128i other = _mm_or_si128(_mm_or_si128(EQ128(v, '"'),
+			EQ128(v, '\'')), _mm_or_si128(EQ128(v, '/'),
+			EQ128(v, ';')));
+
+	return _mm_or_si128(brackets, other);
+}
+
+#undef EQ128
+
+#endif /* CSS_SCAN_SSE2 */
+
+#ifdef CSS_SCAN_AVX2
+
+#define EQ256(v, c) _mm256_cmpeq_epi8((v), _mm256_set1_epi8((char) (c)))
+
+static inline __m256i range256(__m256i v, uint8_t lo, uint8_t hi)
+{
+	__m256i t = _mm256_sub_epi8(v, _mm256_set1_epi8((char) lo));
+
+	return _mm256_cmpeq_epi8(_mm256_min_epu8(t,
+			_mm256_set1_epi8((char) (hi - lo))), t);
+}
+
+static inline __m256i nonascii256(__m256i v)
+{
+	return _mm256_cmpgt_epi8(_mm256_setzero_si256(), v);
+}
+
+static inline __m256i nmchars256(__m256i v)
+{
+	__m256i alpha = range256(_mm256_or_si256(v,
+			_mm256_set1_epi8(0x20)), 'a', 'z');
+	__m256i other = _mm256_or_si256(_mm256_or_si256(EQ256(v, '-'),
+			EQ256(v, '_')), range256(v, '0', '9'));
+
+	return _mm256_or_si256(_mm256_or_si256(alpha, other),
+			nonascii256(v));
+}
+
+static inline __m256i urlchars256(__m256i v)
+{
+	__m256i body = _mm256_andnot_si256(EQ256(v, '\\'),
+			range256(v, '*', '~'));
+	__m256i other = _mm256_or_si256(_mm256_or_si256(EQ256(v, '\t'),
+			EQ256(v, '!')), _mm256_or_si256(EQ256(v, '('),
+			range256(v, '#', '&')));
+
+	return _mm256_or_si256(_mm256_or_si256(body, other),
+			nonascii256(v));
+}
+
+static inline __m256i stringchars256(__m256i v)
+{
+	__m256i stop = _mm256_or_si256(_mm256_or_si256(EQ256(v, '"'),
+			EQ256(v, '\'')), EQ256(v, '\\'));
+	__m256i body = _mm256_andnot_si256(stop, range256(v, ' ', '~'));
+
+	return _mm256_or_si256(_mm256_or_si256(body, EQ256(v, '\t')),
+			nonascii256(v));
+}
+
+static inline __m256i wchars256(__m256i v)
+{
+	__m256i ctrl = _mm256_andnot_si256(EQ256(v, '\v'),
+			range256(v, '\t', '\r'));
+
+	return _mm256_or_si256(ctrl, EQ256(v, ' '));
+}
+
+static inline __m256i plainchars256(__m256i v)
+{
+	return _mm256_cmpeq_epi8(_mm256_max_epu8(v,
+			_mm256_set1_epi8('\r' + 1)), v);
+}
+
+static inline __m256i structural256(__m256i v)
+{
+	__m256i fold = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+	__m256i brackets = _mm256_or_si256(_mm256_or_si256(
+			EQ256(fold, '{'), EQ256(fold, '}')),
+			_mm256_or_si256(EQ256(fold, '|'),
+			EQ256(_mm256_and_si256(v,
+			_mm256_set1_epi8((char) 0xfe)), '(')));
+	__m256i other = _mm256_or_si256(_mm256_or_si256(EQ256(v, '"'),
+			EQ256(v, '\'')), _mm256_or_si256(EQ256(v, '/'),
+			EQ256(v, ';')));
+
+	return _mm256_or_si256(brackets, other);
+}
+
+#undef EQ256
+
+#endif /* CSS_SCAN_AVX2 */
+
+/* Advance i over whole blocks of data that belong to class cls, returning
+ * the offset of the first byte that doesn't, if there is one. */
+#ifdef CSS_SCAN_AVX2
+#define SCAN_BLOCKS_AVX2(data, len, i, cls)				\
+	for (; (i) + 32 <= (len); (i) += 32) {				\
+		uint32_t stop = ~(uint32_t) _mm256_movemask_epi8(	\
+				cls##256(_mm256_loadu_si256(		\
+				(const __m256i *) ((data) + (i)))));	\
+		if (stop != 0)						\
+			return (i) + __builtin_ctz(stop);		\
+	}
+#else
+#define SCAN_BLOCKS_AVX2(data, len, i, cls)
+#endif
+
+#ifdef CSS_SCAN_SSE2
+#define SCAN_BLOCKS(data, len, i, cls)					\
+	SCAN_BLOCKS_AVX2(data, len, i, cls)				\
+	for (; (i) + 16 <= (len); (i) += 16) {				\
+		uint32_t stop = ~(uint32_t) _mm_movemask_epi8(		\
+				cls##128(_mm_loadu_si128(		\
+				(const __m128i *) ((data) + (i))))) &	\
+				0xffff;					\
+		if (stop != 0)						\
+			return (i) + __builtin_ctz(stop);		\
+	}
+#else
+#define SCAN_BLOCKS(data, len, i, cls)
+#endif
+
+/******************************************************************************
+ * Run scanners                                                               *
+ ******************************************************************************/
+
+static inline size_t scanNMChars(const uint8_t *data, size_t len)
+{
+	size_t i = 0;
+
+	SCAN_BLOCKS(data, len, i, nmchars)
+
+	for (; i < len && (charClass[data[i]] & CHAR_NMCHAR); i++)
+		/* do nothing */;
+
+	return i;
+}
+
+static inline size_t scanURLChars(const uint8_t *data, size_t len)
+{
+	size_t i = 0;
+
+	SCAN_BLOCKS(data, len, i, urlchars)
+
+	for (; i < len && (charClass[data[i]] & CHAR_URLCHAR); i++)
+		/* do nothing */;
+
+	return i;
+}
+
+static inline size_t scanStringChars(const uint8_t *data, size_t len)
+{
+	size_t i = 0;
+
+	SCAN_BLOCKS(data, len, i, stringchars)
+
+	for (; i < len && (charClass[data[i]] & CHAR_STRINGCHAR); i++)
+		/* do nothing */;
+
+	return i;
+}
+
+static inline size_t scanWChars(const uint8_t *data, size_t len)
+{
+	size_t i = 0;
+
+	SCAN_BLOCKS(data, len, i, wchars)
+
+	for (; i < len && (charClass[data[i]] & CHAR_SPACE); i++)
+		/* do nothing */;
+
+	return i;
+}
+
+/**
+ * Find the length of the run of characters that can't start a new line
+ *
+ * \param data  Data to scan
+ * \param len   Length, in bytes, of data
+ * \return Offset of the first CR, LF, FF or other control <= CR, or len
+ */
+static inline size_t scanPlainChars(const uint8_t *data, size_t len)
+{
+	size_t i = 0;
+
+	SCAN_BLOCKS(data, len, i, plainchars)
+
+	for (; i < len && data[i] > '\r'; i++)
+		/* do nothing */;
+
+	return i;
+}
+
+/**
+ * Find the end of a comment body
+ *
+ * \param data         Data to scan
+ * \param len          Length, in bytes, of data
+ * \param lastWasStar  Whether the byte preceding data was '*'
+ * \return Offset of the '/' of the first "*" "/" pair, or len if none
+ */
+static inline size_t scanCommentChars(const uint8_t *data, size_t len,
+		bool lastWasStar)
+{
+	uint32_t star = lastWasStar;
+	size_t i = 0;
+
+#ifdef CSS_SCAN_SSE2
+	for (; i + 16 <= len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (data + i));
+		uint32_t slashes = _mm_movemask_epi8(
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+		uint32_t stars = _mm_movemask_epi8(
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('*')));
+		uint32_t end = slashes & ((stars << 1) | star);
+
+		if (end != 0)
+			return i + __builtin_ctz(end);
+
+		star = (stars >> 15) & 1;
+	}
+#endif
+
+	for (; i < len; i++) {
+		if (star && data[i] == '/')
+			return i;
+
+		star = (data[i] == '*');
+	}
+
+	return len;
+}
+
+/**
+ * Find the bytes in a block of data that may affect its structure
+ *
+ * \param data        Data to scan
+ * \param len         Length, in bytes, of data
+ * \param semicolons  Pointer to location to receive mask of the ';'s
+ * \return Mask with bit i set if data[i] may be a bracket, quote, '/',
+ *         '\' or ';', for i < min(len, 64)
+ *
+ * The mask may include other bytes, which the caller must skip. The ';'s
+ * are also reported alone, as they matter only outside blocks.
+ */
+static inline uint64_t structuralMask(const uint8_t *data, size_t len,
+		uint64_t *semicolons)
+{
+	uint64_t mask = 0, semi = 0;
+	size_t i = 0;
+
+#if defined(CSS_SCAN_AVX2)
+	if (len >= 64) {
+		for (; i < 64; i += 32) {
+			__m256i v = _mm256_loadu_si256(
+					(const __m256i *) (data + i));
+
+			mask |= (uint64_t) (uint32_t) _mm256_movemask_epi8(
+					structural256(v)) << i;
+			semi |= (uint64_t) (uint32_t) _mm256_movemask_epi8(
+					_mm256_cmpeq_epi8(v,
+					_mm256_set1_epi8(';'))) << i;
+		}
+
+		*semicolons = semi;
+
+		return mask;
+	}
+#elif defined(CSS_SCAN_SSE2)
+	if (len >= 64) {
+		for (; i < 64; i += 16) {
+			__m128i v = _mm_loadu_si128(
+					(const __m128i *) (data + i));
+
+			mask |= (uint64_t) _mm_movemask_epi8(
+					structural128(v)) << i;
+			semi |= (uint64_t) _mm_movemask_epi8(
+					_mm_cmpeq_epi8(v,
+					_mm_set1_epi8(';'))) << i;
+		}
+
+		*semicolons = semi;
+
+		return mask;
+	}
+#endif
+
+	if (len > 64)
+		len = 64;
+
+	for (; i < len; i++) {
+		if (charClass[data[i]] & CHAR_STRUCTURAL)
+			mask |= (uint64_t) 1 << i;
+		if (data[i] == ';')
+			semi |= (uint64_t) 1 << i;
+	}
+
+	*semicolons = semi;
+
+	return mask;
+}
+
+#undef SCAN_BLOCKS
+#undef SCAN_BLOCKS_AVX2
+
+#endif
@@ -0,0 +1,296 @@
+/*
+ * This file is part of LibCSS.
+ * Licensed under the MIT License,
+ *		  http://www.opensource.org/licenses/mit-license.php
+ */
+
+#include <stdlib.h>
+
+#include "../../include/libcss/events.h"
+
+#include "../lex/lex.h"
+#include "../parse/parse.h"
+
+/**
+ * Event parser object
+ */
+struct css_event_parser {
+	css_parser *parser;		/**< Core parser */
+
+	css_event_handler_fn handler;	/**< Client's event handler */
+	void *pw;			/**< Client data for handler */
+
+	css_event_token *tokens;	/**< Token views of current event */
+	size_t tokens_allocated;	/**< Number of views allocated */
+};
+
+/**
+ * Map from core parser event to public event type
+ *
+ * This and the token type table below are indexed by the core types, so
+ * they name their indices rather than relying on the order of either
+ * enum.
+ */
+static const css_event_type event_types[] = {
+	[CSS_PARSER_START_STYLESHEET]	= CSS_EVENT_START_STYLESHEET,
+	[CSS_PARSER_END_STYLESHEET]	= CSS_EVENT_END_STYLESHEET,
+	[CSS_PARSER_START_RULESET]	= CSS_EVENT_START_RULESET,
+	[CSS_PARSER_END_RULESET]	= CSS_EVENT_END_RULESET,
+	[CSS_PARSER_START_ATRULE]	= CSS_EVENT_START_ATRULE,
+	[CSS_PARSER_END_ATRULE]		= CSS_EVENT_END_ATRULE,
+	[CSS_PARSER_START_BLOCK]	= CSS_EVENT_START_BLOCK,
+	[CSS_PARSER_END_BLOCK]		= CSS_EVENT_END_BLOCK,
+	[CSS_PARSER_BLOCK_CONTENT]	= CSS_EVENT_BLOCK_CONTENT,
+	[CSS_PARSER_DECLARATION]	= CSS_EVENT_DECLARATION
+};
+
+/**
+ * Map from lexer token type to public token type
+ *
+ * The lexer's markers for the last interned and last kept token types
+ * never appear in a token, so their entries are unused.
+ */
+static const css_event_token_type token_types[] = {
+	[CSS_TOKEN_IDENT]		= CSS_EVENT_TOKEN_IDENT,
+	[CSS_TOKEN_ATKEYWORD]		= CSS_EVENT_TOKEN_ATKEYWORD,
+	[CSS_TOKEN_HASH]		= CSS_EVENT_TOKEN_HASH,
+	[CSS_TOKEN_FUNCTION]		= CSS_EVENT_TOKEN_FUNCTION,
+	[CSS_TOKEN_STRING]		= CSS_EVENT_TOKEN_STRING,
+	[CSS_TOKEN_URI]			= CSS_EVENT_TOKEN_URI,
+	[CSS_TOKEN_LAST_INTERN]		= CSS_EVENT_TOKEN_EOF,
+	[CSS_TOKEN_INVALID_STRING]	= CSS_EVENT_TOKEN_INVALID_STRING,
+	[CSS_TOKEN_UNICODE_RANGE]	= CSS_EVENT_TOKEN_UNICODE_RANGE,
+	[CSS_TOKEN_CHAR]		= CSS_EVENT_TOKEN_CHAR,
+	[CSS_TOKEN_NUMBER]		= CSS_EVENT_TOKEN_NUMBER,
+	[CSS_TOKEN_PERCENTAGE]		= CSS_EVENT_TOKEN_PERCENTAGE,
+	[CSS_TOKEN_DIMENSION]		= CSS_EVENT_TOKEN_DIMENSION,
+	[CSS_TOKEN_LAST_DATA]		= CSS_EVENT_TOKEN_EOF,
+	[CSS_TOKEN_CDO]			= CSS_EVENT_TOKEN_CDO,
+	[CSS_TOKEN_CDC]			= CSS_EVENT_TOKEN_CDC,
+	[CSS_TOKEN_S]			= CSS_EVENT_TOKEN_S,
+	[CSS_TOKEN_COMMENT]		= CSS_EVENT_TOKEN_COMMENT,
+	[CSS_TOKEN_INCLUDES]		= CSS_EVENT_TOKEN_INCLUDES,
+	[CSS_TOKEN_DASHMATCH]		= CSS_EVENT_TOKEN_DASHMATCH,
+	[CSS_TOKEN_PREFIXMATCH]		= CSS_EVENT_TOKEN_PREFIXMATCH,
+	[CSS_TOKEN_SUFFIXMATCH]		= CSS_EVENT_TOKEN_SUFFIXMATCH,
+	[CSS_TOKEN_SUBSTRINGMATCH]	= CSS_EVENT_TOKEN_SUBSTRINGMATCH,
+	[CSS_TOKEN_EOF]			= CSS_EVENT_TOKEN_EOF
+};
+
+static css_error event_parser_handle_event(css_parser_event type,
+		const parserutils_vector *tokens, void *pw);
+
+/**
+ * Create an event parser
+ *
+ * \param params  Event parser parameters
+ * \param parser  Pointer to location to receive parser instance
+ * \return CSS_OK on success,
+ *         CSS_BADPARM on bad parameters,
+ *         CSS_NOMEM on memory exhaustion
+ *
+ * The event parser runs the core parser alone, reporting each event to
+ * the client's handler. No selectors, bytecode or stylesheet are built.
+ */
+css_error css_event_parser_create(const css_event_parser_params *params,
+		css_event_parser **parser)
+{
+	css_parser_optparams optparams;
+	css_event_parser *p;
+	css_error error;
+
+	if (params == NULL || params->params_version !=
+				CSS_EVENT_PARSER_PARAMS_VERSION_1 ||
+			params->handler == NULL || parser == NULL)
+		return CSS_BADPARM;
+
+	p = malloc(sizeof(css_event_parser));
+	if (p == NULL)
+		return CSS_NOMEM;
+
+	if (params->inline_style) {
+		error = css__parser_create_for_inline_style(params->charset,
+				(params->charset != NULL) ?
+					CSS_CHARSET_DICTATED : CSS_CHARSET_DEFAULT,
+				&p->parser);
+	} else {
+		error = css__parser_create(params->charset,
+				(params->charset != NULL) ?
+					CSS_CHARSET_DICTATED : CSS_CHARSET_DEFAULT,
+				&p->parser);
+	}
+
+	if (error != CSS_OK) {
+		free(p);
+		return error;
+	}
+
+	optparams.event_handler.handler = event_parser_handle_event;
+	optparams.event_handler.pw = p;
+
+	error = css__parser_setopt(p->parser, CSS_PARSER_EVENT_HANDLER,
+			&optparams);
+	if (error != CSS_OK) {
+		css__parser_destroy(p->parser);
+		free(p);
+		return error;
+	}
+
+	p->handler = params->handler;
+	p->pw = params->handler_pw;
+	p->tokens = NULL;
+	p->tokens_allocated = 0;
+
+	*parser = p;
+
+	return CSS_OK;
+}
+
+/**
+ * Destroy an event parser
+ *
+ * \param parser  The parser to destroy
+ * \return CSS_OK on success, appropriate error otherwise
+ */
+css_error css_event_parser_destroy(css_event_parser *parser)
+{
+	if (parser == NULL)
+		return CSS_BADPARM;
+
+	css__parser_destroy(parser->parser);
+
+	free(parser->tokens);
+
+	free(parser);
+
+	return CSS_OK;
+}
+
+/**
+ * Append source data to an event parser
+ *
+ * \param parser  The parser to append data to
+ * \param data    Pointer to data to append
+ * \param len     Length, in bytes, of data to append
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * Events for the data are reported before this returns. An error
+ * returned by the client's handler is returned from here.
+ */
+css_error css_event_parser_append_data(css_event_parser *parser,
+		const uint8_t *data, size_t len)
+{
+	if (parser == NULL || data == NULL)
+		return CSS_BADPARM;
+
+	return css__parser_parse_chunk(parser->parser, data, len);
+}
+
+/**
+ * Flag that the last of an event parser's data has been appended
+ *
+ * \param parser  The parser in question
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The events closing any constructs left open, and END_STYLESHEET, are
+ * reported before this returns.
+ */
+css_error css_event_parser_data_done(css_event_parser *parser)
+{
+	if (parser == NULL)
+		return CSS_BADPARM;
+
+	return css__parser_completed(parser->parser);
+}
+
+/**
+ * Retrieve the charset an event parser is decoding its data with
+ *
+ * \param parser   The parser to consider
+ * \param charset  Pointer to location to receive charset name
+ * \param source   Pointer to location to receive charset source
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The charset may change once the first data has been appended, if the
+ * data declares it or it is detected from the data.
+ */
+css_error css_event_parser_get_charset(css_event_parser *parser,
+		const char **charset, css_charset_source *source)
+{
+	if (parser == NULL || charset == NULL || source == NULL)
+		return CSS_BADPARM;
+
+	*charset = css__parser_read_charset(parser->parser, source);
+
+	return CSS_OK;
+}
+
+/**
+ * Report a core parser event to the client
+ *
+ * \param type    The event type
+ * \param tokens  Vector of tokens read since last event, or NULL
+ * \param pw      Pointer to event parser instance
+ * \return CSS_OK on success, or the error returned by the client
+ */
+css_error event_parser_handle_event(css_parser_event type,
+		const parserutils_vector *tokens, void *pw)
+{
+	css_event_parser *parser = (css_event_parser *) pw;
+	const css_token *token;
+	size_t n_tokens = 0;
+	int32_t ctx = 0;
+
+	if (tokens != NULL) {
+		parserutils_vector_get_length(
+				(parserutils_vector *) tokens, &n_tokens);
+	}
+
+	if (n_tokens > parser->tokens_allocated) {
+		size_t allocated = parser->tokens_allocated * 2;
+		css_event_token *temp;
+
+		if (allocated < n_tokens)
+			allocated = n_tokens < 32 ? 32 : n_tokens;
+
+		temp = realloc(parser->tokens,
+				allocated * sizeof(css_event_token));
+		if (temp == NULL)
+			return CSS_NOMEM;
+
+		parser->tokens = temp;
+		parser->tokens_allocated = allocated;
+	}
+
+	n_tokens = 0;
+
+	while (tokens != NULL &&
+			(token = parserutils_vector_iterate(tokens, &ctx)) !=
+			NULL) {
+		css_event_token *view = &parser->tokens[n_tokens++];
+
+		view->type = token_types[token->type];
+
+		/* Interned tokens' text is the interned string; the other
+		 * tokens with text borrowed theirs from the parser. */
+		if (token->idata != NULL) {
+			view->data = (const uint8_t *)
+					lwc_string_data(token->idata);
+			view->len = lwc_string_length(token->idata);
+		} else if (token->type < CSS_TOKEN_LAST_DATA &&
+				token->data.data != NULL) {
+			view->data = token->data.data;
+			view->len = token->data.len;
+		} else {
+			view->data = NULL;
+			view->len = 0;
+		}
+
+		view->line = token->line;
+		view->col = token->col;
+	}
+
+	return parser->handler(parser->pw, event_types[type],
+			n_tokens > 0 ? parser->tokens : NULL, n_tokens);
+}
+
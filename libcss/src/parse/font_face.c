@@ -318,11 +318,9 @@ static css_error font_face_parse_font_weight(css_language *c,
 	}
 
 	if (token->type == CSS_TOKEN_NUMBER) {
-		size_t consumed = 0;
-		css_fixed num = css__number_from_lwc_string(token->idata, 
-				true, &consumed);
+		css_fixed num = token->number.value;
 		/* Invalid if there are trailing characters */
-		if (consumed != lwc_string_length(token->idata)) {
+		if (tokenIsWholeNumber(token, true) == false) {
 			*ctx = orig_ctx;
 			return CSS_INVALID;
 		}
@@ -12,6 +12,7 @@
 
 #include "../stylesheet.h"
 #include "../lex/lex.h"
+#include "../lex/scan.h"
 #include "../parse/font_face.h"
 #include "../parse/important.h"
 #include "../parse/language.h"
@@ -52,6 +53,10 @@ static css_error handleBlockContent(css_language *c,
 static css_error handleDeclaration(css_language *c, 
 		const parserutils_vector *vector);
 
+/* Lazy style compilation */
+static css_error startLazyRule(css_language *c, css_rule *rule);
+static css_error endLazyRule(css_language *c);
+
 /* At-rule parsing */
 static css_error parseMediaList(css_language *c,
 		const parserutils_vector *vector, int *ctx,
@@ -157,6 +162,7 @@ css_error css__language_create(css_stylesheet *sheet, css_parser *parser,
 	c->namespaces = NULL;
 	c->num_namespaces = 0;
 	c->strings = sheet->propstrings;
+	c->lazy_rule = NULL;
 
 	*language = c;
 
@@ -266,6 +272,13 @@ css_error handleEndStylesheet(css_language *c, const parserutils_vector *vector)
 
 	assert(c != NULL);
 
+	/* The data ended in the middle of a ruleset */
+	if (c->lazy_rule != NULL) {
+		css_error error = endLazyRule(c);
+		if (error != CSS_OK)
+			return error;
+	}
+
 	entry = parserutils_stack_get_current(c->context);
 	if (entry == NULL || entry->type != CSS_PARSER_START_STYLESHEET)
 		return CSS_INVALID;
@@ -328,6 +341,10 @@ css_error handleStartRuleset(css_language *c, const parserutils_vector *vector)
 
 	/* Rule is now owned by the sheet, so no need to destroy it */
 
+	/* The block of a ruleset in @media is reported separately */
+	if (c->sheet->lazy_styles && parent_rule == NULL)
+		return startLazyRule(c, rule);
+
 	return CSS_OK;
 }
 
@@ -344,6 +361,12 @@ css_error handleEndRuleset(css_language *c, const parserutils_vector *vector)
 	if (entry == NULL || entry->type != CSS_PARSER_START_RULESET)
 		return CSS_INVALID;
 
+	if (entry->data != NULL && entry->data == c->lazy_rule) {
+		css_error error = endLazyRule(c);
+		if (error != CSS_OK)
+			return error;
+	}
+
 	perror = parserutils_stack_pop(c->context, NULL);
 	if (perror != PARSERUTILS_OK) {
 		return css_error_from_parserutils_error(perror);
@@ -677,6 +700,13 @@ css_error handleEndAtRule(css_language *c, const parserutils_vector *vector)
 
 	assert(c != NULL);
 
+	/* The data ended in the middle of a ruleset in @media */
+	if (c->lazy_rule != NULL) {
+		css_error error = endLazyRule(c);
+		if (error != CSS_OK)
+			return error;
+	}
+
 	entry = parserutils_stack_get_current(c->context);
 	if (entry == NULL || entry->type != CSS_PARSER_START_ATRULE)
 		return CSS_INVALID;
@@ -709,6 +739,11 @@ css_error handleStartBlock(css_language *c, const parserutils_vector *vector)
 		return css_error_from_parserutils_error(perror);
 	}
 
+	/* This is the block of a ruleset in @media */
+	if (c->sheet->lazy_styles && c->lazy_rule == NULL &&
+			cur != NULL && cur->type == CSS_PARSER_START_RULESET)
+		return startLazyRule(c, cur->data);
+
 	return CSS_OK;
 }
 
@@ -805,6 +840,10 @@ css_error handleDeclaration(css_language *c, const parserutils_vector *vector)
 				rule->type != CSS_RULE_FONT_FACE))
 		return CSS_INVALID;
 
+	/* The ruleset's declarations will be compiled when it's used */
+	if (rule == c->lazy_rule)
+		return CSS_OK;
+
 	/* Strip any leading whitespace (can happen if in nested block) */
 	consumeWhitespace(vector, &ctx);
 
@@ -837,6 +876,61 @@ css_error handleDeclaration(css_language *c, const parserutils_vector *vector)
 	return CSS_OK;
 }
 
+/******************************************************************************
+ * Lazy style compilation						      *
+ ******************************************************************************/
+
+/**
+ * Start keeping the text of a ruleset's declarations
+ *
+ * \param c     Parsing context
+ * \param rule  The ruleset, whose '{' has just been read
+ * \return CSS_OK on success, appropriate error otherwise
+ */
+css_error startLazyRule(css_language *c, css_rule *rule)
+{
+	css_error error;
+
+	error = css__parser_capture_block(c->sheet->parser);
+	if (error != CSS_OK)
+		return error;
+
+	c->lazy_rule = rule;
+
+	return CSS_OK;
+}
+
+/**
+ * Give the ruleset being read the text of its declarations
+ *
+ * \param c  Parsing context
+ * \return CSS_OK on success, appropriate error otherwise
+ */
+css_error endLazyRule(css_language *c)
+{
+	css_rule *rule = c->lazy_rule;
+	const uint8_t *data;
+	size_t len, i;
+	css_error error;
+
+	c->lazy_rule = NULL;
+
+	error = css__parser_block_text(c->sheet->parser, &data, &len);
+	if (error != CSS_OK)
+		return error;
+
+	/* An empty block leaves the rule without a style, as when compiled */
+	for (i = 0; i < len; i++) {
+		if (isSpace(data[i]) == false)
+			break;
+	}
+
+	if (i == len)
+		return CSS_OK;
+
+	return css__stylesheet_rule_set_source(c->sheet, rule, data, len);
+}
+
 /******************************************************************************
  * At-rule parsing functions						      *
  ******************************************************************************/
@@ -1385,10 +1479,9 @@ css_error parseMediaFeatureIntegerValue( const parserutils_vector *vector,
 			token = parserutils_vector_iterate(vector, ctx);
 			if (token != NULL && token->type == CSS_TOKEN_NUMBER) {
 
-				size_t consumed = 0;
-				*num = css__number_from_lwc_string(token->idata, true, &consumed);
+				*num = token->number.value;
 				/* Invalid if there are trailing characters */
-				if (consumed != lwc_string_length(token->idata)) {
+				if (tokenIsWholeNumber(token, true) == false) {
 					return CSS_INVALID;
 				}
 
@@ -1580,7 +1673,7 @@ css_error parseAttrib(css_language *c, const parserutils_vector *vector,
 
 		temp = parserutils_vector_peek(vector, *ctx);
 		if (temp != NULL && tokenIsChar(temp, '|')) {
-			prefix = token->idata;
+			prefix = tokenName(c, token);
 
 			parserutils_vector_iterate(vector, ctx);
 
@@ -1678,12 +1771,10 @@ css_error parseNth(css_language *c,
 		value->nth.a = 2;
 		value->nth.b = 0;
 	} else if (token->type == CSS_TOKEN_NUMBER) {
-		size_t consumed = 0;
 		css_fixed val = 0;
 
-		val = css__number_from_lwc_string(token->idata,
-				true, &consumed);
-		if (consumed != lwc_string_length(token->idata))
+		val = token->number.value;
+		if (tokenIsWholeNumber(token, true) == false)
 			return CSS_INVALID;
 
 		value->nth.a = 0;
@@ -1700,8 +1791,13 @@ css_error parseNth(css_language *c,
 		int sign = 1;
 		bool had_sign = false, had_b = false;
 
-		len = lwc_string_length(token->idata);
-		data = lwc_string_data(token->idata);
+		if (token->type == CSS_TOKEN_IDENT) {
+			len = lwc_string_length(token->idata);
+			data = lwc_string_data(token->idata);
+		} else {
+			len = token->data.len;
+			data = (const char *) token->data.data;
+		}
 
 		/* Compute a */
 		if (token->type == CSS_TOKEN_IDENT) {
@@ -1753,9 +1849,10 @@ css_error parseNth(css_language *c,
 			}
 		} else {
 			/* 2n */
-			a = css__number_from_lwc_string(token->idata, 
-					true, &consumed);
-			if (consumed == 0 || (data[consumed] != 'n' &&
+			a = token->number.value;
+			consumed = token->number.len;
+			if (token->number.integer == false || consumed == 0 || 
+					(data[consumed] != 'n' &&
 					data[consumed] != 'N'))
 				return CSS_INVALID;
 
@@ -1819,17 +1916,15 @@ css_error parseNth(css_language *c,
 				/* If we've already seen a sign, ensure one
 				 * does not occur at the start of this token
 				 */
-				if (had_sign && lwc_string_length(
-						token->idata) > 0) {
-					data = lwc_string_data(token->idata);
+				if (had_sign && token->data.len > 0) {
+					data = (const char *) token->data.data;
 
 					if (data[0] == '-' || data[0] == '+')
 						return CSS_INVALID;
 				}
 
-				b = css__number_from_lwc_string(token->idata,
-						true, &consumed);
-				if (consumed != lwc_string_length(token->idata))
+				b = token->number.value;
+				if (tokenIsWholeNumber(token, true) == false)
 					return CSS_INVALID;
 			}
 		}
@@ -2132,7 +2227,7 @@ css_error parseTypeSelector(css_language *c, const parserutils_vector *vector,
 		return CSS_INVALID;
 
 	if (tokenIsChar(token, '|') == false) {
-		prefix = token->idata;
+		prefix = tokenName(c, token);
 
 		parserutils_vector_iterate(vector, ctx);
 
@@ -2155,7 +2250,7 @@ css_error parseTypeSelector(css_language *c, const parserutils_vector *vector,
 		if (error != CSS_OK)
 			return error;
 
-		qname->name = token->idata;
+		qname->name = tokenName(c, token);
 	} else {
 		/* No namespace prefix */
 		if (c->default_namespace == NULL) {
@@ -2418,15 +2513,8 @@ css_error parseProperty(css_language *c, const css_token *property,
 	const css_token *token;
 
 	/* Find property index */
-	/** \todo improve on this linear search */
-	for (i = FIRST_PROP; i <= LAST_PROP; i++) {
-		bool match = false;
-
-		if (lwc_string_caseless_isequal(property->idata, c->strings[i],
-				&match) == lwc_error_ok && match)
-			break;
-	}
-	if (i == LAST_PROP + 1)
+	i = css__propstrings_find(property->idata, FIRST_PROP, LAST_PROP);
+	if (i < 0)
 		return CSS_OK; // property unsupported, skip
 
 	/* Get handler */
@@ -48,6 +48,9 @@ typedef struct css_language {
 	lwc_string *default_namespace;	/**< Default namespace URI */
 	css_namespace *namespaces;	/**< Array of namespace mappings */
 	uint32_t num_namespaces;	/**< Number of namespace mappings */
+
+	css_rule *lazy_rule;		/**< Ruleset whose declarations are 
+					 * being kept for later, or NULL */
 } css_language;
 
 css_error css__language_create(css_stylesheet *sheet, css_parser *parser,
@@ -85,8 +88,8 @@ static inline bool tokenIsChar(const css_token *token, uint8_t c)
 	bool result = false;
 
 	if (token != NULL && token->type == CSS_TOKEN_CHAR && 
-	                lwc_string_length(token->idata) == 1) {
-		char d = lwc_string_data(token->idata)[0];
+	                token->data.len == 1) {
+		char d = token->data.data[0];
 
 		/* Ensure lowercase comparison */
 		if ('A' <= d && d <= 'Z')
@@ -105,5 +108,35 @@ static inline bool tokenIsString (const css_token *token, lwc_string *string) {
 			string, &match) == lwc_error_ok && match;
 }
 
+/**
+ * Determine if a numeric token's data is wholly its number
+ *
+ * \param token     The token to consider
+ * \param int_only  Whether the number must also be an integer
+ * \return True if the token's number is acceptable, false otherwise
+ */
+static inline bool tokenIsWholeNumber(const css_token *token, bool int_only)
+{
+	return token->number.len == token->data.len &&
+			(int_only == false || token->number.integer);
+}
+
+/**
+ * Retrieve the name carried by an IDENT or universal selector token
+ *
+ * \param c      Parsing context
+ * \param token  The token to consider
+ * \return Pointer to the token's interned name (not referenced)
+ *
+ * The parser does not intern CHAR tokens, so '*' maps to the known string.
+ */
+static inline lwc_string *tokenName(css_language *c, const css_token *token)
+{
+	if (tokenIsChar(token, '*'))
+		return c->strings[UNIVERSAL];
+
+	return token->idata;
+}
+
 #endif
 
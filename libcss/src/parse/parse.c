@@ -13,6 +13,7 @@
 #include <stdio.h>
 
 #include "../../../libparserutils/include/parserutils/input/inputstream.h"
+#include "../../../libparserutils/include/parserutils/utils/buffer.h"
 #include "../../../libparserutils/include/parserutils/utils/stack.h"
 #include "../../../libparserutils/include/parserutils/utils/vector.h"
 
@@ -94,6 +95,7 @@ struct css_parser
 	parserutils_stack *states;	/**< Stack of states */
 
 	parserutils_vector *tokens;	/**< Vector of pending tokens */
+	parserutils_buffer *token_data;	/**< Text of uninterned tokens */
 
 	const css_token *pushback;	/**< Push back buffer */
 
@@ -106,6 +108,10 @@ struct css_parser
 
 	css_parser_event_handler event;	/**< Client's event handler */
 	void *event_pw;			/**< Client data for event handler */
+
+	parserutils_buffer *block_text;	/**< Text of captured block, or NULL */
+	bool capturing;			/**< A block is being captured */
+	uint32_t capture_depth;		/**< Blocks open in captured block */
 };
 
 static css_error css__parser_create_internal(const char *charset, 
@@ -120,6 +126,7 @@ static css_error expect(css_parser *parser, css_token_type type);
 static css_error getToken(css_parser *parser, const css_token **token);
 static css_error pushBack(css_parser *parser, const css_token *token);
 static css_error eatWS(css_parser *parser);
+static css_error endCapture(css_parser *parser);
 
 static css_error parseStart(css_parser *parser);
 static css_error parseStylesheet(css_parser *parser);
@@ -148,7 +155,8 @@ static css_error parseInlineStyle(css_parser *parser);
 static css_error parseISBody0(css_parser *parser);
 static css_error parseISBody(css_parser *parser);
 
-static void unref_interned_strings_in_tokens(css_parser *parser);
+static css_error borrowTokenData(css_parser *parser, css_token *token);
+static void release_token_data(css_parser *parser);
 
 /**
  * Dispatch table for parsing, indexed by major state number
@@ -233,10 +241,15 @@ css_error css__parser_destroy(css_parser *parser)
 
 	parserutils_stack_destroy(parser->open_items);
 
+	parserutils_buffer_destroy(parser->token_data);
+
 	parserutils_vector_destroy(parser->tokens);
 
 	parserutils_stack_destroy(parser->states);
 
+	if (parser->block_text != NULL)
+		parserutils_buffer_destroy(parser->block_text);
+
 	css__lexer_destroy(parser->lexer);
 
 	parserutils_inputstream_destroy(parser->stream);
@@ -291,7 +304,10 @@ css_error css__parser_parse_chunk(css_parser *parser, const uint8_t *data,
 	if (parser == NULL || data == NULL)
 		return CSS_BADPARM;
 
-	perror = parserutils_inputstream_append(parser->stream, data, len);
+	/* The input stream may read the data in place. It's released before
+	 * returning, as the client may discard the data once we do. */
+	perror = parserutils_inputstream_append_borrowed(parser->stream, 
+			data, len);
 	if (perror != PARSERUTILS_OK)
 		return css_error_from_parserutils_error(perror);
 
@@ -303,6 +319,10 @@ css_error css__parser_parse_chunk(css_parser *parser, const uint8_t *data,
 		error = parseFuncs[state->state](parser);
 	} while (error == CSS_OK);
 
+	perror = parserutils_inputstream_release(parser->stream);
+	if (perror != PARSERUTILS_OK)
+		return css_error_from_parserutils_error(perror);
+
 	return error;
 }
 
@@ -372,6 +392,66 @@ bool css__parser_quirks_permitted(css_parser *parser)
 	return parser->quirks;
 }
 
+/**
+ * Capture the text of the block opened by the current token
+ *
+ * \param parser  Parser to capture the block for
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * This must be called from the event handler for the start of a ruleset or 
+ * block, when the token last read is the '{' that opens it. The text of the 
+ * block, up to but excluding its closing '}', is then available from 
+ * css__parser_block_text once the end of the ruleset or block is reported.
+ */
+css_error css__parser_capture_block(css_parser *parser)
+{
+	parserutils_error perror;
+
+	if (parser == NULL)
+		return CSS_BADPARM;
+
+	if (parser->block_text == NULL) {
+		perror = parserutils_buffer_create(&parser->block_text);
+		if (perror != PARSERUTILS_OK)
+			return css_error_from_parserutils_error(perror);
+	}
+
+	parser->block_text->length = 0;
+	parser->capturing = true;
+	parser->capture_depth = 0;
+
+	return css__lexer_capture(parser->lexer, parser->block_text);
+}
+
+/**
+ * Retrieve the text of the block most recently captured
+ *
+ * \param parser  Parser to query
+ * \param data    Pointer to location to receive pointer to text
+ * \param len     Pointer to location to receive length of text, in bytes
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The text is owned by the parser, and remains valid until the next block 
+ * is captured. If the input ended before the block was closed, the text 
+ * runs to the end of the input.
+ */
+css_error css__parser_block_text(css_parser *parser, const uint8_t **data,
+		size_t *len)
+{
+	if (parser == NULL || data == NULL || len == NULL)
+		return CSS_BADPARM;
+
+	if (parser->block_text == NULL) {
+		*data = NULL;
+		*len = 0;
+	} else {
+		*data = parser->block_text->data;
+		*len = parser->block_text->length;
+	}
+
+	return CSS_OK;
+}
+
 /******************************************************************************
  * Parser creation helper                                                     *
  ******************************************************************************/
@@ -435,9 +515,20 @@ css_error css__parser_create_internal(const char *charset,
 		return css_error_from_parserutils_error(perror);
 	}
 
+	perror = parserutils_buffer_create(&p->token_data);
+	if (perror != PARSERUTILS_OK) {
+		parserutils_vector_destroy(p->tokens);
+		parserutils_stack_destroy(p->states);
+		css__lexer_destroy(p->lexer);
+		parserutils_inputstream_destroy(p->stream);
+		free(p);
+		return css_error_from_parserutils_error(perror);
+	}
+
 	perror = parserutils_stack_create(sizeof(char), 
 			STACK_CHUNK, &p->open_items);
 	if (perror != PARSERUTILS_OK) {
+		parserutils_buffer_destroy(p->token_data);
 		parserutils_vector_destroy(p->tokens);
 		parserutils_stack_destroy(p->states);
 		css__lexer_destroy(p->lexer);
@@ -449,6 +540,7 @@ css_error css__parser_create_internal(const char *charset,
 	perror = parserutils_stack_push(p->states, (void *) &initial);
 	if (perror != PARSERUTILS_OK) {
 		parserutils_stack_destroy(p->open_items);
+		parserutils_buffer_destroy(p->token_data);
 		parserutils_vector_destroy(p->tokens);
 		parserutils_stack_destroy(p->states);
 		css__lexer_destroy(p->lexer);
@@ -464,6 +556,9 @@ css_error css__parser_create_internal(const char *charset,
 	p->event = NULL;
 	p->last_was_ws = false;
 	p->event_pw = NULL;
+	p->block_text = NULL;
+	p->capturing = false;
+	p->capture_depth = 0;
 
 	*parser = p;
 
@@ -616,13 +711,16 @@ css_error getToken(css_parser *parser, const css_token **token)
 
 		/* We need only intern for the following token types:
 		 *
-		 * CSS_TOKEN_IDENT, CSS_TOKEN_ATKEYWORD, CSS_TOKEN_STRING,
-		 * CSS_TOKEN_INVALID_STRING, CSS_TOKEN_HASH, CSS_TOKEN_URI,
-		 * CSS_TOKEN_UNICODE_RANGE?, CSS_TOKEN_FUNCTION, CSS_TOKEN_CHAR,
-		 * CSS_TOKEN_NUMBER, CSS_TOKEN_PERCENTAGE, CSS_TOKEN_DIMENSION
+		 * CSS_TOKEN_IDENT, CSS_TOKEN_ATKEYWORD, CSS_TOKEN_HASH,
+		 * CSS_TOKEN_FUNCTION, CSS_TOKEN_STRING, CSS_TOKEN_URI
 		 *
 		 * These token types all appear before CSS_TOKEN_LAST_INTERN.
-		 * All other token types appear after this magic value.
+		 *
+		 * The remaining token types with text of interest (numbers,
+		 * dimensions, single characters and the like) are only ever
+		 * examined while their declaration is being processed, so
+		 * they borrow a copy of their text from the parser instead.
+		 * These appear before CSS_TOKEN_LAST_DATA.
 		 */
 
 		if (t->type < CSS_TOKEN_LAST_INTERN && t->data.data != NULL) {
@@ -631,6 +729,13 @@ css_error getToken(css_parser *parser, const css_token **token)
                                                     t->data.len, &t->idata);
                         if (lerror != lwc_error_ok)
                                 return css_error_from_lwc_error(lerror);
+		} else if (t->type < CSS_TOKEN_LAST_DATA && 
+				t->data.data != NULL) {
+			t->idata = NULL;
+
+			error = borrowTokenData(parser, t);
+			if (error != CSS_OK)
+				return error;
 		} else {
 			t->idata = NULL;
 		}
@@ -673,6 +778,50 @@ css_error pushBack(css_parser *parser, const css_token *token)
 	return CSS_OK;
 }
 
+/**
+ * Copy the text of an uninterned token into the parser
+ *
+ * \param parser  The parser instance
+ * \param token   The token to copy the text of
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The lexer reuses its token data as soon as the next token is read, 
+ * so the copy is what the token refers to from now on. It remains valid 
+ * until the token vector is next cleared.
+ */
+css_error borrowTokenData(css_parser *parser, css_token *token)
+{
+	parserutils_buffer *buffer = parser->token_data;
+	const uint8_t *old = buffer->data;
+	size_t offset = buffer->length;
+	parserutils_error perror;
+
+	perror = parserutils_buffer_append(buffer, 
+			token->data.data, token->data.len);
+	if (perror != PARSERUTILS_OK)
+		return css_error_from_parserutils_error(perror);
+
+	/* If the buffer moved, so did the text of the pending tokens */
+	if (buffer->data != old) {
+		int32_t ctx = 0;
+		const css_token *tok;
+
+		while ((tok = parserutils_vector_iterate(
+				parser->tokens, &ctx)) != NULL) {
+			css_token *t = (css_token *) tok;
+
+			if (t->idata == NULL && t->type < CSS_TOKEN_LAST_DATA &&
+					t->data.data != NULL)
+				t->data.data = buffer->data + 
+						(t->data.data - old);
+		}
+	}
+
+	token->data.data = buffer->data + offset;
+
+	return CSS_OK;
+}
+
 /**
  * Eat whitespace tokens
  *
@@ -697,13 +846,29 @@ css_error eatWS(css_parser *parser)
 	return CSS_OK;
 }
 
+/**
+ * Stop capturing the text of a block
+ *
+ * \param parser  The parser instance
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The token last read must be the '}' that closes the captured block.
+ */
+css_error endCapture(css_parser *parser)
+{
+	parser->capturing = false;
+	parser->capture_depth = 0;
+
+	return css__lexer_capture(parser->lexer, NULL);
+}
+
 /******************************************************************************
  * Parser stages                                                              *
  ******************************************************************************/
 
 css_error parseStart(css_parser *parser)
 {
-	enum { Initial = 0, AfterWS = 1, AfterStylesheet = 2 };
+	enum { Initial = 0, AfterWS = 1, AfterStylesheet = 2, WS = 3 };
 	parser_state *state = parserutils_stack_get_current(parser->states);
 	css_error error = CSS_OK;
 
@@ -721,6 +886,10 @@ css_error parseStart(css_parser *parser)
 				return error;
 		}
 
+		/* Don't report the start again if we run out of data */
+		state->substate = WS;
+		/* Fall through */
+	case WS:
 		error = eatWS(parser);
 		if (error != CSS_OK)
 			return error;
@@ -752,7 +921,7 @@ css_error parseStart(css_parser *parser)
 			return error;
 	}
         
-        unref_interned_strings_in_tokens(parser);
+        release_token_data(parser);
 	parserutils_vector_clear(parser->tokens);
 
 	return done(parser);
@@ -784,7 +953,7 @@ css_error parseStylesheet(css_parser *parser)
 				if (error != CSS_OK)
 					return error;
 
-                                unref_interned_strings_in_tokens(parser);
+                                release_token_data(parser);
 				parserutils_vector_clear(parser->tokens);
 
 				return done(parser);
@@ -855,7 +1024,7 @@ css_error parseRuleset(css_parser *parser)
 
 	switch (state->substate) {
 	case Initial:
-                unref_interned_strings_in_tokens(parser);
+                release_token_data(parser);
 		parserutils_vector_clear(parser->tokens);
 
 		error = getToken(parser, &token);
@@ -866,19 +1035,21 @@ css_error parseRuleset(css_parser *parser)
 		 * brace. We're going to assume that that won't happen, 
 		 * however. */
 		if (token->type == CSS_TOKEN_CHAR && 
-				lwc_string_length(token->idata) == 1 && 
-				lwc_string_data(token->idata)[0] == '{') {
+				token->data.len == 1 && 
+				token->data.data[0] == '{') {
 #if !defined(NDEBUG) && defined(DEBUG_EVENTS)
 			printf("Begin ruleset\n");
 #endif
 			if (parser->event != NULL) {
-				if (parser->event(CSS_PARSER_START_RULESET, 
-						NULL, parser->event_pw) == 
-						CSS_INVALID) {
+				error = parser->event(CSS_PARSER_START_RULESET,
+						NULL, parser->event_pw);
+				if (error == CSS_INVALID) {
 					parser_state to = 
 						{ sMalformedSelector, Initial };
 
 					return transitionNoRet(parser, to);
+				} else if (error != CSS_OK) {
+					return error;
 				}
 			}
 
@@ -901,10 +1072,12 @@ css_error parseRuleset(css_parser *parser)
 		parserutils_vector_dump(parser->tokens, __func__, tprinter);
 #endif
 		if (parser->parseError == false && parser->event != NULL) {
-			if (parser->event(CSS_PARSER_START_RULESET, 
-					parser->tokens, parser->event_pw) ==
-					CSS_INVALID)
+			error = parser->event(CSS_PARSER_START_RULESET,
+					parser->tokens, parser->event_pw);
+			if (error == CSS_INVALID)
 				parser->parseError = true;
+			else if (error != CSS_OK)
+				return error;
 		}
 
 		if (parser->parseError == true) {
@@ -926,8 +1099,8 @@ css_error parseRuleset(css_parser *parser)
 		}
 
 		if (token->type != CSS_TOKEN_CHAR || 
-				lwc_string_length(token->idata) != 1 ||
-				lwc_string_data(token->idata)[0] != '{') {
+				token->data.len != 1 ||
+				token->data.data[0] != '{') {
 			/* This should never happen, as FOLLOW(selector) 
 			 * contains only '{' */
 			return CSS_INVALID;
@@ -976,9 +1149,9 @@ css_error parseRulesetEnd(css_parser *parser)
 		 * input at this point and read to the start of the next
 		 * declaration. FIRST(decl-list) = (';', '}') */
 		if (token->type != CSS_TOKEN_CHAR || 
-				lwc_string_length(token->idata) != 1 ||
-				(lwc_string_data(token->idata)[0] != '}' &&
-				lwc_string_data(token->idata)[0] != ';')) {
+				token->data.len != 1 ||
+				(token->data.data[0] != '}' &&
+				token->data.data[0] != ';')) {
 			parser_state to = { sDeclaration, Initial };
 			parser_state subsequent = { sRulesetEnd, DeclList };
 
@@ -1008,13 +1181,19 @@ css_error parseRulesetEnd(css_parser *parser)
 		}
 
 		if (token->type != CSS_TOKEN_CHAR || 
-				lwc_string_length(token->idata) != 1 ||
-				lwc_string_data(token->idata)[0] != '}') {
+				token->data.len != 1 ||
+				token->data.data[0] != '}') {
 			/* This should never happen, as FOLLOW(decl-list)
 			 * contains only '}' */
 			return CSS_INVALID;
 		}
 
+		if (parser->capturing) {
+			error = endCapture(parser);
+			if (error != CSS_OK)
+				return error;
+		}
+
 		state->substate = WS;
 		/* Fall through */
 	case WS:
@@ -1049,7 +1228,7 @@ css_error parseAtRule(css_parser *parser)
 
 	switch (state->substate) {
 	case Initial:
-                unref_interned_strings_in_tokens(parser);
+                release_token_data(parser);
 		parserutils_vector_clear(parser->tokens);
 
 		error = getToken(parser, &token);
@@ -1089,10 +1268,9 @@ css_error parseAtRule(css_parser *parser)
 		/* Grammar ambiguity: any0 can be followed by '{',';',')',']'. 
 		 * at-rule can only be followed by '{' and ';'. */
 		if (token->type == CSS_TOKEN_CHAR && 
-				lwc_string_length(token->idata) == 1) {
-			if (lwc_string_data(token->idata)[0] == ')' ||
-					lwc_string_data(
-						token->idata)[0] == ']') {
+				token->data.len == 1) {
+			if (token->data.data[0] == ')' ||
+					token->data.data[0] == ']') {
 				parser_state to = { sAny0, Initial };
 				parser_state subsequent = { sAtRule, AfterAny };
 
@@ -1128,12 +1306,14 @@ css_error parseAtRuleEnd(css_parser *parser)
 		parserutils_vector_dump(parser->tokens, __func__, tprinter);
 #endif
 		if (parser->event != NULL) {
-			if (parser->event(CSS_PARSER_START_ATRULE, 
-					parser->tokens, parser->event_pw) ==
-					CSS_INVALID) {
+			error = parser->event(CSS_PARSER_START_ATRULE,
+					parser->tokens, parser->event_pw);
+			if (error == CSS_INVALID) {
 				parser_state to = { sMalformedAtRule, Initial };
 
 				return transitionNoRet(parser, to);
+			} else if (error != CSS_OK) {
+				return error;
 			}
 		}
 
@@ -1150,12 +1330,12 @@ css_error parseAtRuleEnd(css_parser *parser)
 		}
 
 		if (token->type != CSS_TOKEN_CHAR || 
-				lwc_string_length(token->idata) != 1) {
+				token->data.len != 1) {
 			/* Should never happen FOLLOW(at-rule) == '{', ';'*/
 			return CSS_INVALID;
 		}
 		
-		if (lwc_string_data(token->idata)[0] == '{') {
+		if (token->data.data[0] == '{') {
 			parser_state to = { sBlock, Initial };
 			parser_state subsequent = { sAtRuleEnd, AfterBlock };
 
@@ -1164,7 +1344,7 @@ css_error parseAtRuleEnd(css_parser *parser)
 				return error;
 
 			return transition(parser, to, subsequent);
-		} else if (lwc_string_data(token->idata)[0] != ';') {
+		} else if (token->data.data[0] != ';') {
 			/* Again, should never happen */
 			return CSS_INVALID;
 		}
@@ -1211,6 +1391,10 @@ css_error parseBlock(css_parser *parser)
 #if !defined(NDEBUG) && defined(DEBUG_EVENTS)
 		printf("Begin block\n");
 #endif
+		/* Blocks nested in a captured block are part of its text */
+		if (parser->capturing)
+			parser->capture_depth++;
+
 		if (parser->event != NULL) {
 			error = parser->event(CSS_PARSER_START_BLOCK, NULL,
 					parser->event_pw);
@@ -1219,13 +1403,13 @@ css_error parseBlock(css_parser *parser)
 		}
 
 		if (token->type != CSS_TOKEN_CHAR || 
-				lwc_string_length(token->idata) != 1 ||
-				lwc_string_data(token->idata)[0] != '{') {
+				token->data.len != 1 ||
+				token->data.data[0] != '{') {
 			/* This should never happen, as FIRST(block) == '{' */
 			return CSS_INVALID;
 		}
 
-                unref_interned_strings_in_tokens(parser);
+                release_token_data(parser);
 		parserutils_vector_clear(parser->tokens);
 
 		state->substate = WS;
@@ -1258,13 +1442,23 @@ css_error parseBlock(css_parser *parser)
 		}
 
 		if (token->type != CSS_TOKEN_CHAR || 
-				lwc_string_length(token->idata) != 1 ||
-				lwc_string_data(token->idata)[0] != '}') {
+				token->data.len != 1 ||
+				token->data.data[0] != '}') {
 			/* This should never happen, as 
 			 * FOLLOW(block-content) == '}' */
 			return CSS_INVALID;
 		}
 
+		if (parser->capturing) {
+			if (parser->capture_depth > 0) {
+				parser->capture_depth--;
+			} else {
+				error = endCapture(parser);
+				if (error != CSS_OK)
+					return error;
+			}
+		}
+
 		state->substate = WS2;
 		/* Fall through */
 	case WS2:
@@ -1284,7 +1478,7 @@ css_error parseBlock(css_parser *parser)
 			return error;
 	}
 
-        unref_interned_strings_in_tokens(parser);
+        release_token_data(parser);
 	parserutils_vector_clear(parser->tokens);
 
 	return done(parser);
@@ -1314,9 +1508,8 @@ css_error parseBlockContent(css_parser *parser)
 			if (token->type == CSS_TOKEN_ATKEYWORD) {
 				state->substate = WS;
 			} else if (token->type == CSS_TOKEN_CHAR) {
-				if (lwc_string_length(token->idata) == 1 && 
-						lwc_string_data(
-						token->idata)[0] == '{') {
+				if (token->data.len == 1 && 
+						token->data.data[0] == '{') {
 					/* Grammar ambiguity. Assume block */
 					parser_state to = { sBlock, Initial };
 					parser_state subsequent = 
@@ -1339,17 +1532,15 @@ css_error parseBlockContent(css_parser *parser)
 							return error;
 					}
 
-					unref_interned_strings_in_tokens(
+					release_token_data(
 							parser);
 					parserutils_vector_clear(
 							parser->tokens);
 
 					return transition(parser, to, 
 							subsequent);
-				} else if (lwc_string_length(
-						token->idata) == 1 &&
-						lwc_string_data(
-						token->idata)[0] == ';') {
+				} else if (token->data.len == 1 &&
+						token->data.data[0] == ';') {
 					/* Grammar ambiguity. Assume semi */
 					error = pushBack(parser, token);
 					if (error != CSS_OK)
@@ -1372,16 +1563,14 @@ css_error parseBlockContent(css_parser *parser)
 					if (error != CSS_OK)
 						return error;
 
-					unref_interned_strings_in_tokens(
+					release_token_data(
 							parser);
 					parserutils_vector_clear(
 							parser->tokens);
 
 					state->substate = WS;
-				} else if (lwc_string_length(
-						token->idata) == 1 &&
-						lwc_string_data(
-						token->idata)[0] == '}') {
+				} else if (token->data.len == 1 &&
+						token->data.data[0] == '}') {
 					/* Grammar ambiguity. Assume end */
 					error = pushBack(parser, token);
 					if (error != CSS_OK)
@@ -1400,7 +1589,7 @@ css_error parseBlockContent(css_parser *parser)
 							return error;
 					}
 
-					unref_interned_strings_in_tokens(
+					release_token_data(
 							parser);
 					parserutils_vector_clear(
 							parser->tokens);
@@ -1424,7 +1613,7 @@ css_error parseBlockContent(css_parser *parser)
 						return error;
 				}
 
-				unref_interned_strings_in_tokens(parser);
+				release_token_data(parser);
 				parserutils_vector_clear(parser->tokens);
 
 				return done(parser);
@@ -1468,7 +1657,7 @@ css_error parseSelector(css_parser *parser)
 		parser_state to = { sAny1, Initial };
 		parser_state subsequent = { sSelector, AfterAny1 };
 
-                unref_interned_strings_in_tokens(parser);
+                release_token_data(parser);
 		parserutils_vector_clear(parser->tokens);
 
 		return transition(parser, to, subsequent);
@@ -1495,7 +1684,7 @@ css_error parseDeclaration(css_parser *parser)
 		parser_state to = { sProperty, Initial };
 		parser_state subsequent = { sDeclaration, Colon };
 
-                unref_interned_strings_in_tokens(parser);
+                release_token_data(parser);
 		parserutils_vector_clear(parser->tokens);
 
 		return transition(parser, to, subsequent);
@@ -1522,8 +1711,8 @@ css_error parseDeclaration(css_parser *parser)
 		}
 
 		if (token->type != CSS_TOKEN_CHAR || 
-				lwc_string_length(token->idata) != 1 ||
-				lwc_string_data(token->idata)[0] != ':') {
+				token->data.len != 1 ||
+				token->data.data[0] != ':') {
 			/* parse error -- expected : */
 			parser_state to = { sMalformedDecl, Initial };
 
@@ -1598,14 +1787,14 @@ css_error parseDeclList(css_parser *parser)
 		}
 
 		if (token->type != CSS_TOKEN_CHAR || 
-				lwc_string_length(token->idata) != 1 ||
-				(lwc_string_data(token->idata)[0] != '}' && 
-				lwc_string_data(token->idata)[0] != ';')) {
+				token->data.len != 1 ||
+				(token->data.data[0] != '}' && 
+				token->data.data[0] != ';')) {
 			/* Should never happen */
 			return CSS_INVALID;
 		}
 
-		if (lwc_string_data(token->idata)[0] == '}') {
+		if (token->data.data[0] == '}') {
 			error = pushBack(parser, token);
 			if (error != CSS_OK)
 				return error;
@@ -1647,9 +1836,9 @@ css_error parseDeclListEnd(css_parser *parser)
 			return error;
 
 		if (token->type != CSS_TOKEN_CHAR || 
-				lwc_string_length(token->idata) != 1 || 
-				(lwc_string_data(token->idata)[0] != ';' &&
-				lwc_string_data(token->idata)[0] != '}')) {
+				token->data.len != 1 || 
+				(token->data.data[0] != ';' &&
+				token->data.data[0] != '}')) {
 			parser_state to = { sDeclaration, Initial };
 			parser_state subsequent = 
 					{ sDeclListEnd, AfterDeclaration };
@@ -1743,9 +1932,9 @@ css_error parseValue1(css_parser *parser)
 
 		/* Grammar ambiguity -- assume ';' or '}' mark end */
 		if (token->type == CSS_TOKEN_CHAR && 
-				lwc_string_length(token->idata) == 1 &&
-				(lwc_string_data(token->idata)[0] == ';' ||
-				lwc_string_data(token->idata)[0] == '}')) {
+				token->data.len == 1 &&
+				(token->data.data[0] == ';' ||
+				token->data.data[0] == '}')) {
 			/* Parse error */
 			parser->parseError = true;
 
@@ -1794,12 +1983,9 @@ css_error parseValue0(css_parser *parser)
 
 			/* Grammar ambiguity -- assume ';' or '}' mark end */
 			if (token->type == CSS_TOKEN_CHAR && 
-					lwc_string_length(
-						token->idata) == 1 &&
-					(lwc_string_data(
-						token->idata)[0] == ';' ||
-					lwc_string_data(
-						token->idata)[0] == '}')) {
+					token->data.len == 1 &&
+					(token->data.data[0] == ';' ||
+					token->data.data[0] == '}')) {
 				return done(parser);
 			}
 
@@ -1839,8 +2025,8 @@ css_error parseValue(css_parser *parser)
 		if (token->type == CSS_TOKEN_ATKEYWORD) {
 			state->substate = WS;
 		} else if (token->type == CSS_TOKEN_CHAR && 
-				lwc_string_length(token->idata) == 1 && 
-				lwc_string_data(token->idata)[0] == '{') {
+				token->data.len == 1 && 
+				token->data.data[0] == '{') {
 			/* Grammar ambiguity. Assume block. */
 			parser_state to = { sBlock, Initial };
 
@@ -1903,16 +2089,11 @@ css_error parseAny0(css_parser *parser)
 			/* Grammar ambiguity: 
 			 * assume '{', ';', ')', ']' mark end */
 			if (token->type == CSS_TOKEN_CHAR && 
-					lwc_string_length(
-						token->idata) == 1 &&
-					(lwc_string_data(
-						token->idata)[0] == '{' ||
-					lwc_string_data(
-						token->idata)[0] == ';' ||
-					lwc_string_data(
-						token->idata)[0] == ')' ||
-					lwc_string_data(
-						token->idata)[0] == ']')) {
+					token->data.len == 1 &&
+					(token->data.data[0] == '{' ||
+					token->data.data[0] == ';' ||
+					token->data.data[0] == ')' ||
+					token->data.data[0] == ']')) {
 				return done(parser);
 			}
 
@@ -1973,17 +2154,15 @@ css_error parseAny1(css_parser *parser)
 		/* Grammar ambiguity: any0 can be followed by 
 		 * '{', ';', ')', ']'. any1 can only be followed by '{'. */
 		if (token->type == CSS_TOKEN_CHAR && 
-				lwc_string_length(token->idata) == 1) {
-			if (lwc_string_data(token->idata)[0] == ';' ||
-					lwc_string_data(
-						token->idata)[0] == ')' ||
-					lwc_string_data(
-						token->idata)[0] == ']') {
+				token->data.len == 1) {
+			if (token->data.data[0] == ';' ||
+					token->data.data[0] == ')' ||
+					token->data.data[0] == ']') {
 				parser_state to = { sAny, Initial };
 				parser_state subsequent = { sAny1, AfterAny };
 
 				return transition(parser, to, subsequent);
-			} else if (lwc_string_data(token->idata)[0] != '{') {
+			} else if (token->data.data[0] != '{') {
 				/* parse error */
 				parser->parseError = true;
 			}
@@ -2053,11 +2232,11 @@ css_error parseAny(css_parser *parser)
 			parser->match_char = ')';
 			state->substate = WS;
 		} else if (token->type == CSS_TOKEN_CHAR && 
-				lwc_string_length(token->idata) == 1 && 
-				(lwc_string_data(token->idata)[0] == '(' || 
-				lwc_string_data(token->idata)[0] == '[')) {
-			parser->match_char = lwc_string_data(
-					token->idata)[0] == '(' ? ')' : ']';
+				token->data.len == 1 && 
+				(token->data.data[0] == '(' || 
+				token->data.data[0] == '[')) {
+			parser->match_char =
+					token->data.data[0] == '(' ? ')' : ']';
 			state->substate = WS;
 		} else { // Sofya Kiseleva: seems that here should be else case, otherwise it overrides substates, defined inside if's
 			state->substate = WS2;
@@ -2094,8 +2273,8 @@ css_error parseAny(css_parser *parser)
 
 		/* Match correct close bracket (grammar ambiguity) */
 		if (token->type == CSS_TOKEN_CHAR && 
-				lwc_string_length(token->idata) == 1 &&
-				lwc_string_data(token->idata)[0] == 
+				token->data.len == 1 &&
+				token->data.data[0] == 
 				parser->match_char) {
 			state->substate = WS2;
 			goto ws2;
@@ -2133,7 +2312,7 @@ css_error parseMalformedDeclaration(css_parser *parser)
 		while (1) {
 			char want;
 			char *match;
-			const char *data;
+			const uint8_t *data;
 			size_t len;
 
 			error = getToken(parser, &token);
@@ -2146,8 +2325,8 @@ css_error parseMalformedDeclaration(css_parser *parser)
 			if (token->type != CSS_TOKEN_CHAR)
 				continue;
 
-			len = lwc_string_length(token->idata);
-			data = lwc_string_data(token->idata);
+			len = token->data.len;
+			data = token->data.data;
 
 			if (len != 1 || (data[0] != '{' && data[0] != '}' &&
 					data[0] != '[' && data[0] != ']' &&
@@ -2203,7 +2382,7 @@ css_error parseMalformedDeclaration(css_parser *parser)
 		return error;
 
 	/* Discard the tokens we've read */
-        unref_interned_strings_in_tokens(parser);
+        release_token_data(parser);
 	parserutils_vector_clear(parser->tokens);
 
 	return done(parser);
@@ -2211,7 +2390,7 @@ css_error parseMalformedDeclaration(css_parser *parser)
 
 css_error parseMalformedSelector(css_parser *parser)
 {
-	enum { Initial = 0, Go = 1 };
+	enum { Initial = 0, Go = 1, WS = 2 };
 	parser_state *state = parserutils_stack_get_current(parser->states);
 	const css_token *token;
 	css_error error;
@@ -2232,7 +2411,7 @@ css_error parseMalformedSelector(css_parser *parser)
 		while (1) {
 			char want;
 			char *match;
-			const char *data;
+			const uint8_t *data;
 			size_t len;
 
 			error = getToken(parser, &token);
@@ -2245,8 +2424,8 @@ css_error parseMalformedSelector(css_parser *parser)
 			if (token->type != CSS_TOKEN_CHAR)
 				continue;
 
-			len = lwc_string_length(token->idata);
-			data = lwc_string_data(token->idata);
+			len = token->data.len;
+			data = token->data.data;
 
 			if (len != 1 || (data[0] != '{' && data[0] != '}' &&
 					data[0] != '[' && data[0] != ']' &&
@@ -2291,15 +2470,18 @@ css_error parseMalformedSelector(css_parser *parser)
 					parser->open_items) == NULL)
 				break;
 		}
-	}
 
-	/* Consume any trailing whitespace after the ruleset */
-	error = eatWS(parser);
-	if (error != CSS_OK)
-		return error;
+		state->substate = WS;
+		/* Fall through */
+	case WS:
+		/* Consume any trailing whitespace after the ruleset */
+		error = eatWS(parser);
+		if (error != CSS_OK)
+			return error;
+	}
 
 	/* Discard the tokens we've read */
-        unref_interned_strings_in_tokens(parser);
+        release_token_data(parser);
 	parserutils_vector_clear(parser->tokens);
 
 	return done(parser);
@@ -2307,7 +2489,7 @@ css_error parseMalformedSelector(css_parser *parser)
 
 css_error parseMalformedAtRule(css_parser *parser)
 {
-	enum { Initial = 0, Go = 1 };
+	enum { Initial = 0, Go = 1, WS = 2 };
 	parser_state *state = parserutils_stack_get_current(parser->states);
 	const css_token *token = NULL;
 	css_error error;
@@ -2331,7 +2513,7 @@ css_error parseMalformedAtRule(css_parser *parser)
 		while (1) {
 			char want;
 			char *match;
-			const char *data;
+			const uint8_t *data;
 			size_t len;
 
 			error = getToken(parser, &token);
@@ -2344,8 +2526,8 @@ css_error parseMalformedAtRule(css_parser *parser)
 			if (token->type != CSS_TOKEN_CHAR)
 				continue;
 
-			len = lwc_string_length(token->idata);
-			data = lwc_string_data(token->idata);
+			len = token->data.len;
+			data = token->data.data;
 
 			if (len != 1 || (data[0] != '{' && data[0] != '}' &&
 					data[0] != '[' && data[0] != ']' &&
@@ -2400,15 +2582,18 @@ css_error parseMalformedAtRule(css_parser *parser)
 					parser->open_items) == NULL)
 				break;
 		}
-	}
 
-	/* Consume any trailing whitespace after the at-rule */
-	error = eatWS(parser);
-	if (error != CSS_OK)
-		return error;
+		state->substate = WS;
+		/* Fall through */
+	case WS:
+		/* Consume any trailing whitespace after the at-rule */
+		error = eatWS(parser);
+		if (error != CSS_OK)
+			return error;
+	}
 
 	/* Discard the tokens we've read */
-        unref_interned_strings_in_tokens(parser);
+        release_token_data(parser);
 	parserutils_vector_clear(parser->tokens);
 
 	return done(parser);
@@ -2429,12 +2614,16 @@ css_error parseInlineStyle(css_parser *parser)
 
 		if (parser->event != NULL) {
 			/* 1) begin stylesheet */
-			parser->event(CSS_PARSER_START_STYLESHEET, NULL,
+			error = parser->event(CSS_PARSER_START_STYLESHEET, NULL,
 					parser->event_pw);
+			if (error != CSS_OK)
+				return error;
 
-			/* 2) begin ruleset */
-			parser->event(CSS_PARSER_START_RULESET, NULL,
+			/* 2) begin ruleset; there's no rule to skip instead */
+			error = parser->event(CSS_PARSER_START_RULESET, NULL,
 					parser->event_pw);
+			if (error != CSS_OK)
+				return error;
 		}
 
 		/* Fall through */
@@ -2454,17 +2643,21 @@ css_error parseInlineStyle(css_parser *parser)
 	}
 	case AfterISBody0:
 		/* Clean up any remaining tokens */
-		unref_interned_strings_in_tokens(parser);
+		release_token_data(parser);
 
 		/* Emit remaining fake events to end the parse */
 		if (parser->event != NULL) {
 			/* 1) end ruleset */
-			parser->event(CSS_PARSER_END_RULESET, NULL, 
+			error = parser->event(CSS_PARSER_END_RULESET, NULL,
 					parser->event_pw);
+			if (error != CSS_OK)
+				return error;
 
 			/* 2) end stylesheet */
-			parser->event(CSS_PARSER_END_STYLESHEET, NULL,
+			error = parser->event(CSS_PARSER_END_STYLESHEET, NULL,
 					parser->event_pw);
+			if (error != CSS_OK)
+				return error;
 		}
 
 		break;
@@ -2548,9 +2741,9 @@ css_error parseISBody(css_parser *parser)
 		 * input at this point and read to the start of the next
 		 * declaration. FIRST(decl-list) = (';', '}') */
 		if (token->type != CSS_TOKEN_CHAR || 
-				lwc_string_length(token->idata) != 1 ||
-				(lwc_string_data(token->idata)[0] != '}' &&
-				lwc_string_data(token->idata)[0] != ';')) {
+				token->data.len != 1 ||
+				(token->data.data[0] != '}' &&
+				token->data.data[0] != ';')) {
 			parser_state to = { sDeclaration, Initial };
 			parser_state subsequent = { sISBody, DeclList };
 
@@ -2580,8 +2773,8 @@ css_error parseISBody(css_parser *parser)
 		}
 
 		if (token->type != CSS_TOKEN_CHAR || 
-				lwc_string_length(token->idata) != 1 ||
-				lwc_string_data(token->idata)[0] != '}') {
+				token->data.len != 1 ||
+				token->data.data[0] != '}') {
 			/* This should never happen, as FOLLOW(decl-list)
 			 * contains only '}' */
 			return CSS_INVALID;
@@ -2601,14 +2794,17 @@ css_error parseISBody(css_parser *parser)
 }
 
 /**
- * Iterate the token vector and unref any interned strings in the tokens.
+ * Iterate the token vector and unref any interned strings in the tokens, 
+ * then release the text borrowed by uninterned tokens.
  *
  * \param parser The parser whose tokens we are cleaning up.
  */
-void unref_interned_strings_in_tokens(css_parser *parser)
+void release_token_data(css_parser *parser)
 {
         int32_t ctx = 0;
         const css_token *tok;
+	const css_token *pb = parser->pushback;
+	parserutils_buffer *buffer = parser->token_data;
         
         while ((tok = parserutils_vector_iterate(
 			parser->tokens, &ctx)) != NULL) {
@@ -2616,6 +2812,18 @@ void unref_interned_strings_in_tokens(css_parser *parser)
                         lwc_string_unref(tok->idata);
 		}
         }
+
+	/* The text of a pushed back token is the last to have been 
+	 * borrowed, and must survive until the token is read again */
+	if (pb != NULL && pb->idata == NULL && 
+			pb->type < CSS_TOKEN_LAST_DATA && 
+			pb->data.data != NULL) {
+		parserutils_buffer_discard(buffer, 0, 
+				pb->data.data - buffer->data);
+		((css_token *) pb)->data.data = buffer->data;
+	} else {
+		parserutils_buffer_discard(buffer, 0, buffer->length);
+	}
 }
 
 #ifndef NDEBUG
@@ -74,5 +74,9 @@ const char *css__parser_read_charset(css_parser *parser,
 		css_charset_source *source);
 bool css__parser_quirks_permitted(css_parser *parser);
 
+css_error css__parser_capture_block(css_parser *parser);
+css_error css__parser_block_text(css_parser *parser, const uint8_t **data,
+		size_t *len);
+
 #endif
 
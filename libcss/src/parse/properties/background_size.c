@@ -35,6 +35,7 @@ css_error css__parse_background_size(css_language *c,
     int orig_ctx = *ctx;
     css_error error;
     const css_token *token;
+    int keyword;
     bool match;
 
     /* [length | percentage | IDENT(auto)]{1,2}
@@ -48,20 +49,14 @@ css_error css__parse_background_size(css_language *c,
         return CSS_INVALID;
     }
 
-    if (token->type == CSS_TOKEN_IDENT &&
-        lwc_string_caseless_isequal(
-                 token->idata, c->strings[INHERIT],
-                 &match) == lwc_error_ok && match) {
+    keyword = (token->type == CSS_TOKEN_IDENT) ?
+            css__parse_keyword(token) : -1;
+
+    if (keyword == INHERIT) {
         error = css_stylesheet_style_inherit(result, CSS_PROP_BACKGROUND_SIZE);
-    } else if (token->type == CSS_TOKEN_IDENT &&
-               lwc_string_caseless_isequal(
-                       token->idata, c->strings[COVER],
-                       &match) == lwc_error_ok && match) {
+    } else if (keyword == COVER) {
         error = css__stylesheet_style_appendOPV(result, CSS_PROP_BACKGROUND_SIZE, 0,BACKGROUND_SIZE_COVER);
-    } else if (token->type == CSS_TOKEN_IDENT &&
-               lwc_string_caseless_isequal(
-                       token->idata, c->strings[CONTAIN],
-                       &match) == lwc_error_ok && match) {
+    } else if (keyword == CONTAIN) {
         error = css__stylesheet_style_appendOPV(result, CSS_PROP_BACKGROUND_SIZE, 0,BACKGROUND_SIZE_CONTAIN);
     }
     else {
@@ -91,10 +91,9 @@ css_error css__parse_border_radius_side(css_language *c,
                 }
             } else if (token->type == CSS_TOKEN_NUMBER) {
                 side_values[side_count].has_dimension = false;
-                size_t consumed = 0;
-                side_values[side_count].length = css__number_from_lwc_string(token->idata, true, &consumed);
+                side_values[side_count].length = token->number.value;
                 /* Invalid if there are trailing characters */
-                if (consumed != lwc_string_length(token->idata)) {
+                if (tokenIsWholeNumber(token, true) == false) {
                     *ctx = orig_ctx;
                     return CSS_INVALID;
                 }
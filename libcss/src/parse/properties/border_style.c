@@ -36,7 +36,7 @@ css_error css__parse_border_style(css_language *c,
 	const css_token *token;
 	uint16_t side_val[4];
 	uint32_t side_count = 0;
-	bool match;
+	bool known;
 	css_error error;
 
 	/* Firstly, handle inherit */
@@ -76,30 +76,47 @@ css_error css__parse_border_style(css_language *c,
 		if (token->type != CSS_TOKEN_IDENT) 
 			break;
 
-		if ((lwc_string_caseless_isequal(token->idata, c->strings[NONE], &match) == lwc_error_ok && match)) {
+		known = true;
+
+		switch (css__parse_keyword(token)) {
+		case NONE:
 			side_val[side_count] = BORDER_STYLE_NONE;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[HIDDEN], &match) == lwc_error_ok && match)) {
+			break;
+		case HIDDEN:
 			side_val[side_count] = BORDER_STYLE_HIDDEN;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[DOTTED], &match) == lwc_error_ok && match)) {
+			break;
+		case DOTTED:
 			side_val[side_count] = BORDER_STYLE_DOTTED;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[DASHED], &match) == lwc_error_ok && match)) {
+			break;
+		case DASHED:
 			side_val[side_count] = BORDER_STYLE_DASHED;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[SOLID], &match) == lwc_error_ok && match)) {
+			break;
+		case SOLID:
 			side_val[side_count] = BORDER_STYLE_SOLID;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[LIBCSS_DOUBLE], &match) == lwc_error_ok && match)) {
+			break;
+		case LIBCSS_DOUBLE:
 			side_val[side_count] = BORDER_STYLE_DOUBLE;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[GROOVE], &match) == lwc_error_ok && match)) {
+			break;
+		case GROOVE:
 			side_val[side_count] = BORDER_STYLE_GROOVE;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[RIDGE], &match) == lwc_error_ok && match)) {
+			break;
+		case RIDGE:
 			side_val[side_count] = BORDER_STYLE_RIDGE;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[INSET], &match) == lwc_error_ok && match)) {
+			break;
+		case INSET:
 			side_val[side_count] = BORDER_STYLE_INSET;
-		} else if ((lwc_string_caseless_isequal(token->idata, c->strings[OUTSET], &match) == lwc_error_ok && match)) {
+			break;
+		case OUTSET:
 			side_val[side_count] = BORDER_STYLE_OUTSET;
-		} else {
+			break;
+		default:
+			known = false;
 			break;
 		}
 
+		if (known == false)
+			break;
+
 		side_count++;
 				
 		parserutils_vector_iterate(vector, ctx);
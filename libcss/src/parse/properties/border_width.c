@@ -38,7 +38,7 @@ css_error css__parse_border_width(css_language *c,
 	css_fixed side_length[4];
 	uint32_t side_unit[4];
 	uint32_t side_count = 0;
-	bool match;
+	int keyword;
 	css_error error;
 
 	/* Firstly, handle inherit */
@@ -75,15 +75,18 @@ css_error css__parse_border_width(css_language *c,
 			return CSS_INVALID;
 		}
 
-		if ((token->type == CSS_TOKEN_IDENT) && (lwc_string_caseless_isequal(token->idata, c->strings[THIN], &match) == lwc_error_ok && match)) {
+		keyword = (token->type == CSS_TOKEN_IDENT) ?
+				css__parse_keyword(token) : -1;
+
+		if (keyword == THIN) {
 			side_val[side_count] =  BORDER_WIDTH_THIN;
 			parserutils_vector_iterate(vector, ctx);
 			error = CSS_OK;
-		} else if ((token->type == CSS_TOKEN_IDENT) && (lwc_string_caseless_isequal(token->idata, c->strings[MEDIUM], &match) == lwc_error_ok && match)) {
+		} else if (keyword == MEDIUM) {
 			side_val[side_count] =  BORDER_WIDTH_MEDIUM;
 			parserutils_vector_iterate(vector, ctx);
 			error = CSS_OK;
-		} else if ((token->type == CSS_TOKEN_IDENT) && (lwc_string_caseless_isequal(token->idata, c->strings[THICK], &match) == lwc_error_ok && match)) {
+		} else if (keyword == THICK) {
 			parserutils_vector_iterate(vector, ctx);
 			error = CSS_OK;
 			side_val[side_count] =  BORDER_WIDTH_THICK;
@@ -37,6 +37,7 @@ css_error css__parse_clip(css_language *c,
 	int num_lengths = 0;
 	css_fixed length[4] = { 0 };
 	uint32_t unit[4] = { 0 };
+	int keyword;
 	bool match;
 
 	/* FUNCTION(rect) [ [ IDENT(auto) | length ] CHAR(,)? ]{3} 
@@ -48,26 +49,21 @@ css_error css__parse_clip(css_language *c,
 		return CSS_INVALID;
 	}
 
-	if ((token->type == CSS_TOKEN_IDENT) &&
-	    (lwc_string_caseless_isequal(
-		    token->idata, c->strings[INHERIT],
-		    &match) == lwc_error_ok && match)) {
+	keyword = (token->type == CSS_TOKEN_IDENT ||
+			token->type == CSS_TOKEN_FUNCTION) ?
+			css__parse_keyword(token) : -1;
+
+	if ((token->type == CSS_TOKEN_IDENT) && keyword == INHERIT) {
 		error = css__stylesheet_style_appendOPV(result,
 						       CSS_PROP_CLIP,
 						       FLAG_INHERIT,
 						       0);
-	} else if ((token->type == CSS_TOKEN_IDENT) &&
-		   (lwc_string_caseless_isequal(
-			   token->idata, c->strings[AUTO],
-			   &match) == lwc_error_ok && match)) {
+	} else if ((token->type == CSS_TOKEN_IDENT) && keyword == AUTO) {
 		error = css__stylesheet_style_appendOPV(result,
 						       CSS_PROP_CLIP,
 						       0,
 						       CLIP_AUTO);
-	} else if ((token->type == CSS_TOKEN_FUNCTION) &&
-		   (lwc_string_caseless_isequal(
-			   token->idata, c->strings[RECT],
-			   &match) == lwc_error_ok && match)) {
+	} else if ((token->type == CSS_TOKEN_FUNCTION) && keyword == RECT) {
 		int i;
 		uint16_t value = CLIP_SHAPE_RECT;
 
@@ -35,7 +35,7 @@ css_error css__parse_content(css_language *c,
 	int orig_ctx = *ctx;
 	css_error error;
 	const css_token *token;
-	bool match;
+	int keyword;
 
 	/* IDENT(normal, none, inherit) | [ ... ]+ */
 	token = parserutils_vector_iterate(vector, ctx);
@@ -45,20 +45,14 @@ css_error css__parse_content(css_language *c,
 	}
 
 
-	if ((token->type == CSS_TOKEN_IDENT) &&
-	    (lwc_string_caseless_isequal(token->idata,
-					 c->strings[INHERIT],
-					 &match) == lwc_error_ok && match)) {
+	keyword = (token->type == CSS_TOKEN_IDENT) ?
+			css__parse_keyword(token) : -1;
+
+	if (keyword == INHERIT) {
 		error = css_stylesheet_style_inherit(result, CSS_PROP_CONTENT);
-	} else if ((token->type == CSS_TOKEN_IDENT) &&
-		   (lwc_string_caseless_isequal(token->idata,
-						c->strings[NORMAL],
-						&match) == lwc_error_ok && match)) {
+	} else if (keyword == NORMAL) {
 		error = css__stylesheet_style_appendOPV(result, CSS_PROP_CONTENT, 0, CONTENT_NORMAL);
-	} else if ((token->type == CSS_TOKEN_IDENT) &&
-		   (lwc_string_caseless_isequal(token->idata,
-						c->strings[NONE],
-						&match) == lwc_error_ok && match)) {
+	} else if (keyword == NONE) {
 		error = css__stylesheet_style_appendOPV(result, CSS_PROP_CONTENT, 0, CONTENT_NONE);
 	} else {
 
@@ -82,28 +76,24 @@ css_error css__parse_content(css_language *c,
 		 */
 
 		while (token != NULL) {
-			if ((token->type == CSS_TOKEN_IDENT) &&
-			    (lwc_string_caseless_isequal(
-				    token->idata, c->strings[OPEN_QUOTE],
-				    &match) == lwc_error_ok && match)) {
+			keyword = (token->type == CSS_TOKEN_IDENT ||
+					token->type == CSS_TOKEN_FUNCTION) ?
+					css__parse_keyword(token) : -1;
+
+			if (token->type == CSS_TOKEN_IDENT &&
+					keyword == OPEN_QUOTE) {
 
 				error = CSS_APPEND(CONTENT_OPEN_QUOTE);
 
 			} else if (token->type == CSS_TOKEN_IDENT &&
-				   (lwc_string_caseless_isequal(
-					   token->idata, c->strings[CLOSE_QUOTE],
-					   &match) == lwc_error_ok && match)) {
+					keyword == CLOSE_QUOTE) {
 
 				error = CSS_APPEND(CONTENT_CLOSE_QUOTE);
 			} else if (token->type == CSS_TOKEN_IDENT &&
-				   (lwc_string_caseless_isequal(
-					   token->idata, c->strings[NO_OPEN_QUOTE],
-					   &match) == lwc_error_ok && match)) {
+					keyword == NO_OPEN_QUOTE) {
 				error = CSS_APPEND(CONTENT_NO_OPEN_QUOTE);
 			} else if (token->type == CSS_TOKEN_IDENT &&
-				   (lwc_string_caseless_isequal(
-					   token->idata, c->strings[NO_CLOSE_QUOTE],
-					   &match) == lwc_error_ok && match)) {
+					keyword == NO_CLOSE_QUOTE) {
 				error = CSS_APPEND(CONTENT_NO_CLOSE_QUOTE);
 			} else if (token->type == CSS_TOKEN_STRING) {
 				uint32_t snumber;
@@ -150,9 +140,7 @@ css_error css__parse_content(css_language *c,
 
 				error = css__stylesheet_style_append(result, uri_snumber);
 			} else if (token->type == CSS_TOKEN_FUNCTION &&
-				   (lwc_string_caseless_isequal(
-					   token->idata, c->strings[ATTR],
-					   &match) == lwc_error_ok && match)) {
+					keyword == ATTR) {
 				uint32_t snumber;
 
 				consumeWhitespace(vector, ctx);
@@ -187,9 +175,7 @@ css_error css__parse_content(css_language *c,
 					return CSS_INVALID;
 				}
 			} else if (token->type == CSS_TOKEN_FUNCTION &&
-				   (lwc_string_caseless_isequal(
-					   token->idata, c->strings[COUNTER],
-					   &match) == lwc_error_ok && match)) {
+					keyword == COUNTER) {
 				lwc_string *name;
 				uint32_t snumber;
 				uint32_t opv;
@@ -271,9 +257,7 @@ css_error css__parse_content(css_language *c,
 
 				error = css__stylesheet_style_append(result, snumber);
 			} else if (token->type == CSS_TOKEN_FUNCTION &&
-				   (lwc_string_caseless_isequal(
-					   token->idata, c->strings[COUNTERS],
-					   &match) == lwc_error_ok && match)) {
+					keyword == COUNTERS) {
 				lwc_string *name;
 				lwc_string *sep;
 				uint32_t name_snumber;
@@ -0,0 +1,718 @@
+/*
+ * This file is part of LibCSS.
+ * Licensed under the MIT License,
+ *		  http://www.opensource.org/licenses/mit-license.php
+ * Copyright 2010 Vincent Sanders <vince@kyllikki.org>
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+/* Descriptors are space separated key:value pairs. Brackets () are
+ * used to quote in values.
+ *
+ * Examples:
+ * list_style_image:CSS_PROP_LIST_STYLE_IMAGE IDENT:( INHERIT: NONE:0,LIST_STYLE_IMAGE_NONE IDENT:) URI:LIST_STYLE_IMAGE_URI
+ *
+ * list_style_position:CSS_PROP_LIST_STYLE_POSITION IDENT:( INHERIT: INSIDE:0,LIST_STYLE_POSITION_INSIDE OUTSIDE:0,LIST_STYLE_POSITION_OUTSIDE IDENT:)
+ */
+
+struct keyval {
+	char *key;
+	char *val;
+};
+
+struct keyval_list {
+	struct keyval *item[100];
+	int count;
+};
+
+static struct keyval *get_keyval(char **pos)
+{
+	char *endpos;
+	struct keyval *nkeyval;
+	int kvlen;
+
+	endpos = strchr(*pos, ' '); /* single space separated pairs */
+	if (endpos == NULL) {
+		/* no space, but might be the end of the input */
+		kvlen = strlen(*pos);
+		if (kvlen == 0)
+			return NULL;
+		endpos = *pos + kvlen;
+	} else {
+		kvlen = (endpos - *pos);
+	}
+	nkeyval = calloc(1, sizeof(struct keyval) + kvlen + 1);
+	if (nkeyval == NULL)
+		return NULL;
+
+	memcpy(nkeyval + 1, *pos, kvlen);
+
+	nkeyval->key = (char *) nkeyval + sizeof(struct keyval);
+
+	endpos = strchr(nkeyval->key, ':'); /* split key and value on : */
+	if (endpos != NULL) {
+		endpos[0] = 0; /* change : to null terminator */
+		nkeyval->val = endpos + 1; /* skip : */
+	}
+
+	*pos += kvlen; /* update position */
+
+	/* skip spaces */
+	while ((*pos[0] != 0) && (*pos[0] == ' ')) {
+		(*pos)++;
+	}
+
+	return nkeyval;
+}
+
+static void output_header(FILE *outputf, const char *descriptor,
+		struct keyval *parser_id, bool is_generic)
+{
+	fprintf(outputf,
+		"/*\n"
+		" * This file was generated by LibCSS gen_parser \n"
+		" * \n"
+		" * Generated from:\n"
+		" *\n"
+		" * %s\n"
+		" * \n"
+		" * Licensed under the MIT License,\n"
+		" *		  http://www.opensource.org/licenses/mit-license.php\n"
+		" * Copyright 2010 The NetSurf Browser Project.\n"
+		" */\n"
+		"\n"
+		"#include <assert.h>\n"
+		"#include <string.h>\n"
+		"\n"
+		"#include \"bytecode/bytecode.h\"\n"
+		"#include \"bytecode/opcodes.h\"\n"
+		"#include \"parse/properties/properties.h\"\n"
+		"#include \"parse/properties/utils.h\"\n"
+		"\n"
+		"/**\n"
+		" * Parse %s\n"
+		" *\n"
+		" * \\param c	  Parsing context\n"
+		" * \\param vector  Vector of tokens to process\n"
+		" * \\param ctx	  Pointer to vector iteration context\n"
+		" * \\param result  resulting style\n"
+		"%s"
+		" * \\return CSS_OK on success,\n"
+		" *	   CSS_NOMEM on memory exhaustion,\n"
+		" *	   CSS_INVALID if the input is not valid\n"
+		" *\n"
+		" * Post condition: \\a *ctx is updated with the next token to process\n"
+		" *		   If the input is invalid, then \\a *ctx remains unchanged.\n"
+		" */\n"
+		"css_error css__parse_%s(css_language *c,\n"
+		"		const parserutils_vector *vector, int *ctx,\n"
+		"		css_style *result%s)\n"
+		"{\n",
+		descriptor,
+		parser_id->key,
+		is_generic ? " * \\param op	 Bytecode OpCode for CSS property to encode\n" : "",
+		parser_id->key,
+		is_generic ? ", enum css_properties_e op" : "");
+}
+
+static void output_footer(FILE *outputf)
+{
+	fprintf(outputf,
+		"\n"
+		"	if (error != CSS_OK)\n"
+		"		*ctx = orig_ctx;\n"
+		"	\n"
+		"	return error;\n"
+		"}\n\n");
+}
+
+static void output_wrap(FILE *outputf, struct keyval *parser_id,
+		struct keyval_list *WRAP)
+{
+	fprintf(outputf,
+		"	return %s(c, vector, ctx, result, %s);\n}\n",
+		WRAP->item[0]->val,
+		parser_id->val);
+}
+
+static const char str_INHERIT[] = "INHERIT";
+
+static void output_token_type_check(FILE *outputf, bool do_token_check,
+		struct keyval_list *IDENT, struct keyval_list *URI,
+		struct keyval_list *NUMBER)
+{
+	fprintf(outputf,
+		"	token = parserutils_vector_iterate(vector, ctx);\n"
+		"	if (");
+
+	if (do_token_check) {
+		bool prev = false; /* there was a previous check - add && */
+
+		fprintf(outputf,"(token == NULL) || (");
+
+		if (IDENT->count > 0) {
+			fprintf(outputf,"(token->type != CSS_TOKEN_IDENT)");
+			prev = true;
+		}
+		if (URI->count > 0) {
+			if (prev)
+				fprintf(outputf," && ");
+			fprintf(outputf,"(token->type != CSS_TOKEN_URI)");
+			prev = true;
+		}
+		if (NUMBER->count > 0) {
+			if (prev)
+				fprintf(outputf," && ");
+			fprintf(outputf,"(token->type != CSS_TOKEN_NUMBER)");
+			prev = true;
+		}
+
+		fprintf(outputf,")");
+	} else {
+		fprintf(outputf,"token == NULL");
+	}
+
+	fprintf(outputf,
+		") {\n"
+		"\t\t*ctx = orig_ctx;\n"
+		"\t\treturn CSS_INVALID;\n"
+		"\t}\n\n\t");
+}
+
+static void output_ident(FILE *outputf, bool only_ident,
+		struct keyval *parser_id, struct keyval_list *IDENT)
+{
+	int i;
+
+	if (only_ident) {
+		fprintf(outputf,
+			"switch (css__parse_keyword(token)) {\n");
+	} else {
+		fprintf(outputf,
+			"switch ((token->type == CSS_TOKEN_IDENT) ?\n"
+			"\t\t\tcss__parse_keyword(token) : -1) {\n");
+	}
+
+	for (i = 0; i < IDENT->count; i++) {
+		struct keyval *ckv = IDENT->item[i];
+
+		fprintf(outputf,
+			"\tcase %s:\n",
+			ckv->key);
+
+		if (strcmp(ckv->key, str_INHERIT) == 0) {
+			fprintf(outputf,
+				"\t\terror = css_stylesheet_style_inherit(result, %s);\n",
+				parser_id->val);
+		} else {
+			fprintf(outputf,
+				"\t\terror = css__stylesheet_style_appendOPV(result, %s, %s);\n",
+				parser_id->val,
+				ckv->val);
+		}
+		fprintf(outputf, "\t\tbreak;\n");
+	}
+
+	fprintf(outputf, "\tdefault:\n");
+}
+
+/**
+ * Output the code for tokens other than the keywords, as the default case
+ * of the keyword switch.
+ *
+ * The code is written at the indentation of the switch, so each line of it
+ * is indented one more level.
+ */
+static void output_default(FILE *outputf, const char *code)
+{
+	const char *line;
+
+	fprintf(outputf, "\t\t");
+
+	for (line = code; *line != '\0'; line++) {
+		fputc(*line, outputf);
+
+		if (*line == '\n' && line[1] != '\0' && line[1] != '\n')
+			fputc('\t', outputf);
+	}
+
+	fprintf(outputf,
+		"\t\tbreak;\n"
+		"\t}\n");
+}
+
+static void output_uri(FILE *outputf, struct keyval *parser_id,
+		struct keyval_list *kvlist)
+{
+	struct keyval *ckv = kvlist->item[0];
+
+	fprintf(outputf,
+		"if (token->type == CSS_TOKEN_URI) {\n"
+		"		lwc_string *uri = NULL;\n"
+		"		uint32_t uri_snumber;\n"
+		"\n"
+		"		error = c->sheet->resolve(c->sheet->resolve_pw,\n"
+		"				c->sheet->url,\n"
+		"				token->idata, &uri);\n"
+		"		if (error != CSS_OK) {\n"
+		"			*ctx = orig_ctx;\n"
+		"			return error;\n"
+		"		}\n"
+		"\n"
+		"		error = css__stylesheet_string_add(c->sheet, uri, &uri_snumber);\n"
+		"		if (error != CSS_OK) {\n"
+		"			*ctx = orig_ctx;\n"
+		"			return error;\n"
+		"		}\n"
+		"\n"
+		"		error = css__stylesheet_style_appendOPV(result, %s, 0, %s);\n"
+		"		if (error != CSS_OK) {\n"
+		"			*ctx = orig_ctx;\n"
+		"			return error;\n"
+		"		}\n"
+		"\n"
+		"		error = css__stylesheet_style_append(result, uri_snumber);\n"
+		"	} else ",
+		parser_id->val,
+		ckv->val);
+}
+
+static void output_number(FILE *outputf, struct keyval *parser_id,
+		struct keyval_list *kvlist)
+{
+	struct keyval *ckv = kvlist->item[0];
+	int i;
+
+	fprintf(outputf,
+		"if (token->type == CSS_TOKEN_NUMBER) {\n"
+		"\t\tcss_fixed num = 0;\n"
+		"\n"
+		"\t\tnum = token->number.value;\n"
+		"\t\t/* Invalid if there are trailing characters */\n"
+		"\t\tif (tokenIsWholeNumber(token, %s) == false) {\n"
+		"\t\t\t*ctx = orig_ctx;\n"
+		"\t\t\treturn CSS_INVALID;\n"
+		"\t\t}\n",
+		ckv->key);
+
+	for (i = 1; i < kvlist->count; i++) {
+		struct keyval *ulkv = kvlist->item[i];
+
+		if (strcmp(ulkv->key, "RANGE") == 0) {
+			fprintf(outputf,
+				"\t\tif (%s) {\n"
+				"\t\t\t*ctx = orig_ctx;\n"
+				"\t\t\treturn CSS_INVALID;\n"
+				"\t\t}\n\n",
+				ulkv->val);
+		}
+	}
+
+	fprintf(outputf,
+		"\t\terror = css__stylesheet_style_appendOPV(result, %s, 0, %s);\n"
+		"\t\tif (error != CSS_OK) {\n"
+		"\t\t\t*ctx = orig_ctx;\n"
+		"\t\t\treturn error;\n"
+		"\t\t}\n"
+		"\n"
+		"\t\terror = css__stylesheet_style_append(result, num);\n"
+		"\t} else ",
+		parser_id->val,
+		ckv->val);
+}
+
+static void output_color(FILE *outputf, struct keyval *parser_id,
+		struct keyval_list *kvlist)
+{
+	(void) kvlist;
+
+	fprintf(outputf,
+		"{\n"
+		"\t\tuint16_t value = 0;\n"
+		"\t\tuint32_t color = 0;\n"
+		"\t\t*ctx = orig_ctx;\n"
+		"\n"
+		"\t\terror = css__parse_colour_specifier(c, vector, ctx, &value, &color);\n"
+		"\t\tif (error != CSS_OK) {\n"
+		"\t\t\t*ctx = orig_ctx;\n"
+		"\t\t\treturn error;\n"
+		"\t\t}\n"
+		"\n"
+		"\t\terror = css__stylesheet_style_appendOPV(result, %s, 0, value);\n"
+		"\t\tif (error != CSS_OK) {\n"
+		"\t\t\t*ctx = orig_ctx;\n"
+		"\t\t\treturn error;\n"
+		"\t\t}\n"
+		"\n"
+		"\t\tif (value == COLOR_SET)\n"
+		"\t\t\terror = css__stylesheet_style_append(result, color);\n"
+		"\t}\n",
+		parser_id->val);
+}
+
+static void output_length_unit(FILE *outputf, struct keyval *parser_id,
+		struct keyval_list *kvlist)
+{
+	struct keyval *ckv = kvlist->item[0];
+	int i;
+
+	fprintf(outputf,
+		"{\n"
+		"\t\tcss_fixed length = 0;\n"
+		"\t\tuint32_t unit = 0;\n"
+		"\t\t*ctx = orig_ctx;\n"
+		"\n"
+		"\t\terror = css__parse_unit_specifier(c, vector, ctx, %s, &length, &unit);\n"
+		"\t\tif (error != CSS_OK) {\n"
+		"\t\t\t*ctx = orig_ctx;\n"
+		"\t\t\treturn error;\n"
+		"\t\t}\n"
+		"\n",
+		ckv->key);
+
+	for (i = 1; i < kvlist->count; i++) {
+		struct keyval *ulkv = kvlist->item[i];
+
+		if (strcmp(ulkv->key, "ALLOW") == 0) {
+			fprintf(outputf,
+				"\t\tif ((%s) == false) {\n"
+				"\t\t\t*ctx = orig_ctx;\n"
+				"\t\t\treturn CSS_INVALID;\n"
+				"\t\t}\n"
+				"\n",
+				ulkv->val);
+		} else if (strcmp(ulkv->key, "DISALLOW") == 0) {
+			fprintf(outputf,
+				"\t\tif (%s) {\n"
+				"\t\t\t*ctx = orig_ctx;\n"
+				"\t\t\treturn CSS_INVALID;\n"
+				"\t\t}\n"
+				"\n",
+				ulkv->val);
+		} else if (strcmp(ulkv->key, "RANGE") == 0) {
+			fprintf(outputf,
+				"\t\tif (length %s) {\n"
+				"\t\t\t*ctx = orig_ctx;\n"
+				"\t\t\treturn CSS_INVALID;\n"
+				"\t\t}\n"
+				"\n",
+				ulkv->val);
+		}
+	}
+
+	fprintf(outputf,
+		"\t\terror = css__stylesheet_style_appendOPV(result, %s, 0, %s);\n"
+		"\t\tif (error != CSS_OK) {\n"
+		"\t\t\t*ctx = orig_ctx;\n"
+		"\t\t\treturn error;\n"
+		"\t\t}\n"
+		"\n"
+		"\t\terror = css__stylesheet_style_vappend(result, 2, length, unit);\n"
+		"\t}\n",
+		parser_id->val,
+		ckv->val);
+}
+
+static void output_ident_list(FILE *outputf, struct keyval *parser_id,
+		struct keyval_list *kvlist)
+{
+	if (strcmp(kvlist->item[0]->key, "STRING_OPTNUM") == 0) {
+		/* list of IDENT and optional numbers */
+		struct keyval *ikey = kvlist->item[0];
+		struct keyval *nkey = kvlist->item[1];
+
+		fprintf(outputf,
+			"{\n"
+			"\t\terror = css__stylesheet_style_appendOPV(result, %s, 0, %s);\n"
+			"\t\tif (error != CSS_OK) {\n"
+			"\t\t\t*ctx = orig_ctx;\n"
+			"\t\t\treturn error;\n"
+			"\t\t}\n"
+			"\n"
+			"\t\twhile ((token != NULL) && (token->type == CSS_TOKEN_IDENT)) {\n"
+			"\t\t\tuint32_t snumber;\n"
+			"\t\t\tcss_fixed num;\n"
+			"\t\t\tint pctx;\n"
+			"\n"
+			"\t\t\terror = css__stylesheet_string_add(c->sheet, lwc_string_ref(token->idata), &snumber);\n"
+			"\t\t\tif (error != CSS_OK) {\n"
+			"\t\t\t\t*ctx = orig_ctx;\n"
+			"\t\t\t\treturn error;\n"
+			"\t\t\t}\n"
+			"\n"
+			"\t\t\terror = css__stylesheet_style_append(result, snumber);\n"
+			"\t\t\tif (error != CSS_OK) {\n"
+			"\t\t\t\t*ctx = orig_ctx;\n"
+			"\t\t\t\treturn error;\n"
+			"\t\t\t}\n"
+			"\n"
+			"\t\t\tconsumeWhitespace(vector, ctx);\n"
+			"\n"
+			"\t\t\tpctx = *ctx;\n"
+			"\t\t\ttoken = parserutils_vector_iterate(vector, ctx);\n"
+			"\t\t\tif ((token != NULL) && (token->type == CSS_TOKEN_NUMBER)) {\n"
+			"\n"
+			"\t\t\t\tnum = token->number.value;\n"
+			"\t\t\t\tif (tokenIsWholeNumber(token, true) == false) {\n"
+			"\t\t\t\t\t*ctx = orig_ctx;\n"
+			"\t\t\t\t\treturn CSS_INVALID;\n"
+			"\t\t\t\t}\n"
+			"\t\t\t\tconsumeWhitespace(vector, ctx);\n"
+			"\n"
+			"\t\t\t\tpctx = *ctx;\n"
+			"\t\t\t\ttoken = parserutils_vector_iterate(vector, ctx);\n"
+			"\t\t\t} else {\n"
+			"\t\t\t\tnum = INTTOFIX(%s);\n"
+			"\t\t\t}\n"
+			"\n"
+			"\t\t\terror = css__stylesheet_style_append(result, num);\n"
+			"\t\t\tif (error != CSS_OK) {\n"
+			"\t\t\t\t*ctx = orig_ctx;\n"
+			"\t\t\t\treturn error;\n"
+			"\t\t\t}\n"
+			"\n"
+			"\t\t\tif (token == NULL)\n"
+			"\t\t\t\tbreak;\n"
+			"\n"
+			"\t\t\tif (token->type == CSS_TOKEN_IDENT) {\n"
+			"\t\t\t\terror = css__stylesheet_style_append(result, %s);\n"
+			"\t\t\t\tif (error != CSS_OK) {\n"
+			"\t\t\t\t\t*ctx = orig_ctx;\n"
+			"\t\t\t\t\treturn error;\n"
+			"\t\t\t\t}\n"
+			"\t\t\t} else {\n"
+			"\t\t\t\t*ctx = pctx; /* rewind one token back */\n"
+			"\t\t\t}\n"
+			"\t\t}\n"
+			"\n"
+			"\t\terror = css__stylesheet_style_append(result, %s);\n"
+			"\t}\n",
+			parser_id->val,
+			ikey->val,
+			nkey->key,
+			ikey->val,
+			nkey->val);
+	} else {
+		fprintf(stderr, "unknown IDENT list type %s\n",
+				kvlist->item[0]->key);
+		exit(4);
+	}
+}
+
+static void output_invalidcss(FILE *outputf)
+{
+	fprintf(outputf, "{\n\t\terror = CSS_INVALID;\n\t}\n");
+}
+
+static void output_others(FILE *outputf, struct keyval *parser_id,
+		struct keyval_list *URI, struct keyval_list *NUMBER,
+		struct keyval_list *COLOR, struct keyval_list *LENGTH_UNIT,
+		struct keyval_list *IDENT_LIST)
+{
+	if (URI->count > 0)
+		output_uri(outputf, parser_id, URI);
+
+	if (NUMBER->count > 0)
+		output_number(outputf, parser_id, NUMBER);
+
+	/* terminal blocks, these end the ladder ie no trailing else */
+	if (COLOR->count > 0) {
+		output_color(outputf, parser_id, COLOR);
+	} else if (LENGTH_UNIT->count > 0) {
+		output_length_unit(outputf, parser_id, LENGTH_UNIT);
+	} else if (IDENT_LIST->count > 0) {
+		output_ident_list(outputf, parser_id, IDENT_LIST);
+	} else {
+		output_invalidcss(outputf);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	char *descriptor;
+	char *curpos; /* current position in input string */
+	struct keyval *parser_id; /* the parser we are creating output for */
+	FILE *outputf;
+	struct keyval *rkv; /* current read key:val */
+	struct keyval_list *curlist;
+	bool do_token_check = true; /* if the check for valid tokens is done */
+	bool only_ident = true; /* if the only token type is ident */
+	bool is_generic = false;
+
+	struct keyval_list base;
+	struct keyval_list IDENT;
+	struct keyval_list IDENT_LIST;
+	struct keyval_list LENGTH_UNIT;
+	struct keyval_list URI;
+	struct keyval_list WRAP;
+	struct keyval_list NUMBER;
+	struct keyval_list COLOR;
+
+	if (argc < 2) {
+		fprintf(stderr,"Usage: %s [-o <filename>] <descriptor>\n", argv[0]);
+		return 1;
+	}
+
+	if ((argv[1][0] == '-') && (argv[1][1] == 'o')) {
+		if (argc != 4) {
+			fprintf(stderr,"Usage: %s [-o <filename>] <descriptor>\n", argv[0]);
+			return 1;
+		}
+		outputf = fopen(argv[2], "w");
+		if (outputf == NULL) {
+			perror("unable to open file");
+			return 2;
+		}
+		descriptor = strdup(argv[3]);
+	} else {
+		outputf = stdout;
+		descriptor = strdup(argv[1]);
+	}
+
+	if (descriptor == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 3;
+	}
+
+	curpos = descriptor;
+
+	base.count = 0;
+	IDENT.count = 0;
+	URI.count = 0;
+	WRAP.count = 0;
+	NUMBER.count = 0;
+	COLOR.count = 0;
+	LENGTH_UNIT.count = 0;
+	IDENT_LIST.count = 0;
+
+	curlist = &base;
+
+	while (*curpos != 0) {
+		rkv = get_keyval(&curpos);
+		if (rkv == NULL) {
+			fprintf(stderr,"Token error at offset %ld\n",
+					(long) (curpos - descriptor));
+			fclose(outputf);
+			return 2;
+		}
+
+		if (strcmp(rkv->key, "WRAP") == 0) {
+			WRAP.item[WRAP.count++] = rkv;
+			only_ident = false;
+		} else if (strcmp(rkv->key, "NUMBER") == 0) {
+			if (rkv->val[0] == '(') {
+				curlist = &NUMBER;
+			} else if (rkv->val[0] == ')') {
+				curlist = &base;
+			} else {
+				NUMBER.item[NUMBER.count++] = rkv;
+			}
+			only_ident = false;
+		} else if (strcmp(rkv->key, "IDENT") == 0) {
+			if (rkv->val[0] == '(') {
+				curlist = &IDENT;
+			} else if (rkv->val[0] == ')') {
+				curlist = &base;
+			} else if (strcmp(rkv->val, str_INHERIT) == 0) {
+				IDENT.item[IDENT.count++] = rkv;
+				rkv->key = (char *) str_INHERIT;
+			}
+		} else if (strcmp(rkv->key, "IDENT_LIST") == 0) {
+			if (rkv->val[0] == '(') {
+				curlist = &IDENT_LIST;
+			} else if (rkv->val[0] == ')') {
+				curlist = &base;
+			}
+		} else if (strcmp(rkv->key, "LENGTH_UNIT") == 0) {
+			if (rkv->val[0] == '(') {
+				curlist = &LENGTH_UNIT;
+			} else if (rkv->val[0] == ')') {
+				curlist = &base;
+			}
+			only_ident = false;
+			do_token_check = false;
+		} else if (strcmp(rkv->key, "COLOR") == 0) {
+			COLOR.item[COLOR.count++] = rkv;
+			do_token_check = false;
+			only_ident = false;
+		} else if (strcmp(rkv->key, "URI") == 0) {
+			URI.item[URI.count++] = rkv;
+			only_ident = false;
+		} else if (strcmp(rkv->key, "GENERIC") == 0) {
+			is_generic = true;
+		} else {
+			/* just append to current list */
+			curlist->item[curlist->count++] = rkv;
+		}
+	}
+
+	if (base.count != 1) {
+		fprintf(stderr,"Incorrect base element count (got %d expected 1)\n", base.count);
+		fclose(outputf);
+		return 3;
+	}
+
+	parser_id = base.item[0];
+
+	output_header(outputf, descriptor, parser_id, is_generic);
+
+	if (WRAP.count > 0) {
+		output_wrap(outputf, parser_id, &WRAP);
+	} else {
+		bool uses_context = (URI.count > 0 || COLOR.count > 0 ||
+				LENGTH_UNIT.count > 0 || IDENT_LIST.count > 0);
+		bool keywords_only = (uses_context == false &&
+				NUMBER.count == 0);
+
+		fprintf(outputf,
+			"\tint orig_ctx = *ctx;\n"
+			"\tcss_error error;\n"
+			"\tconst css_token *token;\n\n");
+
+		/* Keywords and numbers are parsed without the context */
+		if (uses_context == false)
+			fprintf(outputf, "\tUNUSED(c);\n\n");
+
+		output_token_type_check(outputf, do_token_check,
+				&IDENT, &URI, &NUMBER);
+
+		if (IDENT.count > 0 && keywords_only) {
+			output_ident(outputf, only_ident, parser_id, &IDENT);
+			output_default(outputf, "error = CSS_INVALID;\n");
+		} else if (IDENT.count > 0) {
+			char *code = NULL;
+			size_t len = 0;
+			FILE *others;
+
+			/* Everything but the keywords is the default case */
+			others = open_memstream(&code, &len);
+			if (others == NULL) {
+				perror("unable to open memory stream");
+				fclose(outputf);
+				return 2;
+			}
+
+			output_others(others, parser_id, &URI, &NUMBER,
+					&COLOR, &LENGTH_UNIT, &IDENT_LIST);
+			fclose(others);
+
+			output_ident(outputf, only_ident, parser_id, &IDENT);
+			output_default(outputf, code);
+
+			free(code);
+		} else {
+			output_others(outputf, parser_id, &URI, &NUMBER,
+					&COLOR, &LENGTH_UNIT, &IDENT_LIST);
+		}
+
+		output_footer(outputf);
+	}
+
+	fclose(outputf);
+
+	return 0;
+}
@@ -36,7 +36,6 @@ css_error css__parse_font_weight(css_language *c,
 	const css_token *token;
 	uint8_t flags = 0;
 	uint16_t value = 0;
-	bool match;
 
 	/* NUMBER (100, 200, 300, 400, 500, 600, 700, 800, 900) | 
 	 * IDENT (normal, bold, bolder, lighter, inherit) */
@@ -47,16 +46,12 @@ css_error css__parse_font_weight(css_language *c,
 		return CSS_INVALID;
 	}
 
-	if ((lwc_string_caseless_isequal(
-			token->idata, c->strings[INHERIT],
-			&match) == lwc_error_ok && match)) {
+	if (is_css_inherit(c, token)) {
 		flags |= FLAG_INHERIT;
 	} else if (token->type == CSS_TOKEN_NUMBER) {
-		size_t consumed = 0;
-		css_fixed num = css__number_from_lwc_string(token->idata, 
-				true, &consumed);
+		css_fixed num = token->number.value;
 		/* Invalid if there are trailing characters */
-		if (consumed != lwc_string_length(token->idata)) {
+		if (tokenIsWholeNumber(token, true) == false) {
 			*ctx = orig_ctx;
 			return CSS_INVALID;
 		}
@@ -73,25 +68,24 @@ css_error css__parse_font_weight(css_language *c,
 		case 900: value = FONT_WEIGHT_900; break;
 		default: *ctx = orig_ctx; return CSS_INVALID;
 		}
-	} else if ((lwc_string_caseless_isequal(
-			token->idata, c->strings[NORMAL],
-			&match) == lwc_error_ok && match)) {
-		value = FONT_WEIGHT_NORMAL;
-	} else if ((lwc_string_caseless_isequal(
-			token->idata, c->strings[BOLD],
-			&match) == lwc_error_ok && match)) {
-		value = FONT_WEIGHT_BOLD;
-	} else if ((lwc_string_caseless_isequal(
-			token->idata, c->strings[BOLDER],
-			&match) == lwc_error_ok && match)) {
-		value = FONT_WEIGHT_BOLDER;
-	} else if ((lwc_string_caseless_isequal(
-			token->idata, c->strings[LIGHTER],
-			&match) == lwc_error_ok && match)) {
-		value = FONT_WEIGHT_LIGHTER;
 	} else {
-		*ctx = orig_ctx;
-		return CSS_INVALID;
+		switch (css__parse_keyword(token)) {
+		case NORMAL:
+			value = FONT_WEIGHT_NORMAL;
+			break;
+		case BOLD:
+			value = FONT_WEIGHT_BOLD;
+			break;
+		case BOLDER:
+			value = FONT_WEIGHT_BOLDER;
+			break;
+		case LIGHTER:
+			value = FONT_WEIGHT_LIGHTER;
+			break;
+		default:
+			*ctx = orig_ctx;
+			return CSS_INVALID;
+		}
 	}
 
 	error = css__stylesheet_style_appendOPV(result,
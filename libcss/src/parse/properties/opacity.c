@@ -45,11 +45,10 @@ css_error css__parse_opacity(css_language *c,
 			error = css_stylesheet_style_inherit(result, CSS_PROP_OPACITY);
 	} else if (token->type == CSS_TOKEN_NUMBER) {
 		css_fixed num = 0;
-		size_t consumed = 0;
 
-		num = css__number_from_lwc_string(token->idata, false, &consumed);
+		num = token->number.value;
 		/* Invalid if there are trailing characters */
-		if (consumed != lwc_string_length(token->idata)) {
+		if (tokenIsWholeNumber(token, false) == false) {
 			*ctx = orig_ctx;
 			return CSS_INVALID;
 		}
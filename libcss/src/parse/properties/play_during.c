@@ -37,7 +37,6 @@ css_error css__parse_play_during(css_language *c,
 	uint8_t flags = 0;
 	uint16_t value = 0;
 	lwc_string *uri;
-	bool match;
 	uint32_t uri_snumber;
 
 	/* URI [ IDENT(mix) || IDENT(repeat) ]? | IDENT(auto,none,inherit) */
@@ -50,19 +49,17 @@ css_error css__parse_play_during(css_language *c,
 	}
 
 	if (token->type == CSS_TOKEN_IDENT) {
-		if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[INHERIT],
-				&match) == lwc_error_ok && match)) {
+		switch (css__parse_keyword(token)) {
+		case INHERIT:
 			flags |= FLAG_INHERIT;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[NONE],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case NONE:
 			value = PLAY_DURING_NONE;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[AUTO],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case AUTO:
 			value = PLAY_DURING_AUTO;
-		} else {
+			break;
+		default:
 			*ctx = orig_ctx;
 			return CSS_INVALID;
 		}
@@ -93,28 +90,24 @@ css_error css__parse_play_during(css_language *c,
 
 			token = parserutils_vector_peek(vector, *ctx);
 			if (token != NULL && token->type == CSS_TOKEN_IDENT) {
-				if ((lwc_string_caseless_isequal(
-						token->idata, c->strings[MIX],
-						&match) == lwc_error_ok && 
-						match)) {
+				switch (css__parse_keyword(token)) {
+				case MIX:
 					if ((value & PLAY_DURING_MIX) == 0)
 						value |= PLAY_DURING_MIX;
 					else {
 						*ctx = orig_ctx;
 						return CSS_INVALID;
 					}
-				} else if (lwc_string_caseless_isequal(
-						token->idata, 
-						c->strings[REPEAT],
-						&match) == lwc_error_ok &&
-						match) {
+					break;
+				case REPEAT:
 					if ((value & PLAY_DURING_REPEAT) == 0)
 						value |= PLAY_DURING_REPEAT;
 					else {
 						*ctx = orig_ctx;
 						return CSS_INVALID;
 					}
-				} else {
+					break;
+				default:
 					*ctx = orig_ctx;
 					return CSS_INVALID;
 				}
@@ -34,7 +34,7 @@ css_error css__parse_quotes(css_language *c,
 	int orig_ctx = *ctx;
 	css_error error = CSS_INVALID;
 	const css_token *token;
-	bool match;
+	int keyword;
 
 	/* [ STRING STRING ]+ | IDENT(none,inherit) */
 	token = parserutils_vector_iterate(vector, ctx);
@@ -45,15 +45,12 @@ css_error css__parse_quotes(css_language *c,
 		return CSS_INVALID;
 	}
 
-	if ((token->type == CSS_TOKEN_IDENT) &&
-	    (lwc_string_caseless_isequal(token->idata,
-			c->strings[INHERIT],
-			&match) == lwc_error_ok && match)) {
+	keyword = (token->type == CSS_TOKEN_IDENT) ?
+			css__parse_keyword(token) : -1;
+
+	if (keyword == INHERIT) {
 		error = css_stylesheet_style_inherit(result, CSS_PROP_QUOTES);
-	} else if ((token->type == CSS_TOKEN_IDENT) &&
-		   (lwc_string_caseless_isequal(token->idata,
-				c->strings[NONE],
-				&match) == lwc_error_ok && match)) {
+	} else if (keyword == NONE) {
 		error = css__stylesheet_style_appendOPV(result,
 				CSS_PROP_QUOTES, 0, QUOTES_NONE);
 	} else if (token->type == CSS_TOKEN_STRING) {
@@ -15,6 +15,7 @@
 #include "../../parse/properties/properties.h"
 #include "../../parse/properties/utils.h"
 #include "../../utils/parserutilserror.h"
+#include "../../utils/utils.h"
 
 
 /**
@@ -29,75 +30,62 @@
 css_error css__parse_list_style_type_value(css_language *c, const css_token *ident,
 		uint16_t *value)
 {
-	bool match;
+	UNUSED(c);
 
 	/* IDENT (disc, circle, square, decimal, decimal-leading-zero,
 	 *	  lower-roman, upper-roman, lower-greek, lower-latin,
 	 *	  upper-latin, armenian, georgian, lower-alpha, upper-alpha,
 	 *	  none)
 	 */
-	if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[DISC],
-			&match) == lwc_error_ok && match)) {
+	switch (css__parse_keyword(ident)) {
+	case DISC:
 		*value = LIST_STYLE_TYPE_DISC;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[CIRCLE],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case CIRCLE:
 		*value = LIST_STYLE_TYPE_CIRCLE;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[SQUARE],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case SQUARE:
 		*value = LIST_STYLE_TYPE_SQUARE;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[DECIMAL],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case DECIMAL:
 		*value = LIST_STYLE_TYPE_DECIMAL;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[DECIMAL_LEADING_ZERO],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case DECIMAL_LEADING_ZERO:
 		*value = LIST_STYLE_TYPE_DECIMAL_LEADING_ZERO;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[LOWER_ROMAN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case LOWER_ROMAN:
 		*value = LIST_STYLE_TYPE_LOWER_ROMAN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[UPPER_ROMAN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case UPPER_ROMAN:
 		*value = LIST_STYLE_TYPE_UPPER_ROMAN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[LOWER_GREEK],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case LOWER_GREEK:
 		*value = LIST_STYLE_TYPE_LOWER_GREEK;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[LOWER_LATIN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case LOWER_LATIN:
 		*value = LIST_STYLE_TYPE_LOWER_LATIN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[UPPER_LATIN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case UPPER_LATIN:
 		*value = LIST_STYLE_TYPE_UPPER_LATIN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[ARMENIAN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case ARMENIAN:
 		*value = LIST_STYLE_TYPE_ARMENIAN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[GEORGIAN],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case GEORGIAN:
 		*value = LIST_STYLE_TYPE_GEORGIAN;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[LOWER_ALPHA],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case LOWER_ALPHA:
 		*value = LIST_STYLE_TYPE_LOWER_ALPHA;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[UPPER_ALPHA],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case UPPER_ALPHA:
 		*value = LIST_STYLE_TYPE_UPPER_ALPHA;
-	} else if ((lwc_string_caseless_isequal(
-			ident->idata, c->strings[NONE],
-			&match) == lwc_error_ok && match)) {
+		break;
+	case NONE:
 		*value = LIST_STYLE_TYPE_NONE;
-	} else
+		break;
+	default:
 		return CSS_INVALID;
+	}
 
 	return CSS_OK;
 }
@@ -365,7 +353,6 @@ css_error css__parse_colour_specifier(css_language *c,
 {
 	int orig_ctx = *ctx;
 	const css_token *token;
-	bool match;
 	css_error error;
 
 	consumeWhitespace(vector, ctx);
@@ -392,23 +379,24 @@ css_error css__parse_colour_specifier(css_language *c,
 	}
 
 	if (token->type == CSS_TOKEN_IDENT) {
-		if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[TRANSPARENT],
-				&match) == lwc_error_ok && match)) {
+		switch (css__parse_keyword(token)) {
+		case TRANSPARENT:
 			*value = COLOR_TRANSPARENT;
 			*result = 0; /* black transparent */
 			return CSS_OK;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[CURRENTCOLOR],
-				&match) == lwc_error_ok && match)) {
+		case CURRENTCOLOR:
 			*value = COLOR_CURRENT_COLOR;
 			*result = 0;
 			return CSS_OK;
+		default:
+			break;
 		}
 
 		error = css__parse_named_colour(c, token->idata, result);
 		if (error != CSS_OK && c->sheet->quirks_allowed) {
-			error = css__parse_hash_colour(token->idata, result);
+			error = css__parse_hash_colour(
+					lwc_string_data(token->idata),
+					lwc_string_length(token->idata), result);
 			if (error == CSS_OK)
 				c->sheet->quirks_used = true;
 		}
@@ -416,19 +404,22 @@ css_error css__parse_colour_specifier(css_language *c,
 		if (error != CSS_OK)
 			goto invalid;
 	} else if (token->type == CSS_TOKEN_HASH) {
-		error = css__parse_hash_colour(token->idata, result);
+		error = css__parse_hash_colour(lwc_string_data(token->idata),
+				lwc_string_length(token->idata), result);
 		if (error != CSS_OK)
 			goto invalid;
 	} else if (c->sheet->quirks_allowed &&
 			token->type == CSS_TOKEN_NUMBER) {
-		error = css__parse_hash_colour(token->idata, result);
+		error = css__parse_hash_colour((const char *) token->data.data,
+				token->data.len, result);
 		if (error == CSS_OK)
 			c->sheet->quirks_used = true;
 		else
 			goto invalid;
 	} else if (c->sheet->quirks_allowed &&
 			token->type == CSS_TOKEN_DIMENSION) {
-		error = css__parse_hash_colour(token->idata, result);
+		error = css__parse_hash_colour((const char *) token->data.data,
+				token->data.len, result);
 		if (error == CSS_OK)
 			c->sheet->quirks_used = true;
 		else
@@ -437,22 +428,21 @@ css_error css__parse_colour_specifier(css_language *c,
 		uint8_t r = 0, g = 0, b = 0, a = 0xff;
 		int colour_channels = 0;
 
-		if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[RGB],
-				&match) == lwc_error_ok && match)) {
+		switch (css__parse_keyword(token)) {
+		case RGB:
 			colour_channels = 3;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[RGBA],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case RGBA:
 			colour_channels = 4;
-		} if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[HSL],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case HSL:
 			colour_channels = 5;
-		} else if ((lwc_string_caseless_isequal(
-				token->idata, c->strings[HSLA],
-				&match) == lwc_error_ok && match)) {
+			break;
+		case HSLA:
 			colour_channels = 6;
+			break;
+		default:
+			break;
 		}
 
 		if (colour_channels == 3 || colour_channels == 4) {
@@ -463,7 +453,6 @@ css_error css__parse_colour_specifier(css_language *c,
 			for (i = 0; i < colour_channels; i++) {
 				uint8_t *component;
 				css_fixed num;
-				size_t consumed = 0;
 				int32_t intval;
 				bool int_only;
 
@@ -489,9 +478,8 @@ css_error css__parse_colour_specifier(css_language *c,
 				else
 					int_only = false;
 
-				num = css__number_from_lwc_string(token->idata,
-						int_only, &consumed);
-				if (consumed != lwc_string_length(token->idata))
+				num = token->number.value;
+				if (tokenIsWholeNumber(token, int_only) == false)
 					goto invalid;
 
 				if (valid == CSS_TOKEN_NUMBER) {
@@ -535,7 +523,6 @@ css_error css__parse_colour_specifier(css_language *c,
 			}
 		} else if (colour_channels == 5 || colour_channels == 6) {
 			/* hue - saturation - lightness */
-			size_t consumed = 0;
 			css_fixed hue, sat, lit;
 			int32_t alpha = 255;
 
@@ -548,8 +535,8 @@ css_error css__parse_colour_specifier(css_language *c,
 			if ((token == NULL) || (token->type != CSS_TOKEN_NUMBER))
 				goto invalid;
 
-			hue = css__number_from_lwc_string(token->idata, false, &consumed);
-			if (consumed != lwc_string_length(token->idata))
+			hue = token->number.value;
+			if (tokenIsWholeNumber(token, false) == false)
 				goto invalid; /* failed to consume the whole string as a number */
 
 			/* Normalise hue to the range [0, 360) */
@@ -572,8 +559,8 @@ css_error css__parse_colour_specifier(css_language *c,
 			if ((token == NULL) || (token->type != CSS_TOKEN_PERCENTAGE))
 				goto invalid;
 
-			sat = css__number_from_lwc_string(token->idata, false, &consumed);
-			if (consumed != lwc_string_length(token->idata))
+			sat = token->number.value;
+			if (tokenIsWholeNumber(token, false) == false)
 				goto invalid; /* failed to consume the whole string as a number */
 
 			/* Normalise saturation to the range [0, 100] */
@@ -596,8 +583,8 @@ css_error css__parse_colour_specifier(css_language *c,
 			if ((token == NULL) || (token->type != CSS_TOKEN_PERCENTAGE))
 				goto invalid;
 
-			lit = css__number_from_lwc_string(token->idata, false, &consumed);
-			if (consumed != lwc_string_length(token->idata))
+			lit = token->number.value;
+			if (tokenIsWholeNumber(token, false) == false)
 				goto invalid; /* failed to consume the whole string as a number */
 
 			/* Normalise lightness to the range [0, 100] */
@@ -622,8 +609,8 @@ css_error css__parse_colour_specifier(css_language *c,
 				if ((token == NULL) || (token->type != CSS_TOKEN_NUMBER))
 					goto invalid;
 
-				alpha = css__number_from_lwc_string(token->idata, false, &consumed);
-				if (consumed != lwc_string_length(token->idata))
+				alpha = token->number.value;
+				if (tokenIsWholeNumber(token, false) == false)
 					goto invalid; /* failed to consume the whole string as a number */
 				
 				alpha = FIXTOINT(FMUL(alpha, F_255));
@@ -829,15 +816,9 @@ css_error css__parse_named_colour(css_language *c, lwc_string *data,
 		0xff9acd32  /* YELLOWGREEN */
 	};
 	int i;
-	bool match;
 
-	for (i = FIRST_COLOUR; i <= LAST_COLOUR; i++) {
-		if (lwc_string_caseless_isequal(data, c->strings[i],
-				&match) == lwc_error_ok && match)
-			break;
-	}
-
-	if (i <= LAST_COLOUR) {
+	i = css__propstrings_find(data, FIRST_COLOUR, LAST_COLOUR);
+	if (i >= 0) {
 		/* Known named colour */
 		*result = colourmap[i - FIRST_COLOUR];
 		return CSS_OK;
@@ -854,16 +835,16 @@ css_error css__parse_named_colour(css_language *c, lwc_string *data,
 /**
  * Parse a hash colour (#rgb or #rrggbb)
  *
- * \param data    Pointer to colour string
+ * \param input   Pointer to colour string
+ * \param len     Length, in bytes, of colour string
  * \param result  Pointer to location to receive result (AARRGGBB)
  * \return CSS_OK      on success,
  *         CSS_INVALID if the input is invalid
  */
-css_error css__parse_hash_colour(lwc_string *data, uint32_t *result)
+css_error css__parse_hash_colour(const char *input, size_t len,
+		uint32_t *result)
 {
 	uint8_t r = 0, g = 0, b = 0, a = 0xff;
-	size_t len = lwc_string_length(data);
-	const char *input = lwc_string_data(data);
 
 	if (len == 3 &&	isHex(input[0]) && isHex(input[1]) &&
 			isHex(input[2])) {
@@ -914,7 +895,6 @@ css_error css__parse_unit_specifier(css_language *c,
 	int orig_ctx = *ctx;
 	const css_token *token;
 	css_fixed num;
-	size_t consumed = 0;
 	css_error error;
 
 	consumeWhitespace(vector, ctx);
@@ -927,21 +907,16 @@ css_error css__parse_unit_specifier(css_language *c,
 		return CSS_INVALID;
 	}
 
-	num = css__number_from_lwc_string(token->idata, false, &consumed);
+	num = token->number.value;
 
 	if (token->type == CSS_TOKEN_DIMENSION) {
-		size_t len = lwc_string_length(token->idata);
-		const char *data = lwc_string_data(token->idata);
-		css_unit temp_unit = CSS_UNIT_PX;
-
-		error = css__parse_unit_keyword(data + consumed, len - consumed,
-				&temp_unit);
-		if (error != CSS_OK) {
+		/* The lexer has already decoded the unit */
+		if (token->number.unit == CSS_TOKEN_UNIT_UNKNOWN) {
 			*ctx = orig_ctx;
-			return error;
+			return CSS_INVALID;
 		}
 
-		*unit = (uint32_t) temp_unit;
+		*unit = token->number.unit;
 	} else if (token->type == CSS_TOKEN_NUMBER) {
 		/* Non-zero values are permitted in quirks mode */
 		if (num != 0) {
@@ -981,7 +956,7 @@ css_error css__parse_unit_specifier(css_language *c,
 		}
 	} else {
 		/* Percentage -- number must be entire token data */
-		if (consumed != lwc_string_length(token->idata)) {
+		if (tokenIsWholeNumber(token, false) == false) {
 			*ctx = orig_ctx;
 			return CSS_INVALID;
 		}
@@ -993,71 +968,6 @@ css_error css__parse_unit_specifier(css_language *c,
 	return CSS_OK;
 }
 
-/**
- * Parse a unit keyword
- *
- * \param ptr   Pointer to keyword string
- * \param len   Length, in bytes, of string
- * \param unit  Pointer to location to receive computed unit
- * \return CSS_OK      on success,
- *         CSS_INVALID on encountering an unknown keyword
- */
-css_error css__parse_unit_keyword(const char *ptr, size_t len, uint32_t *unit)
-{
-	if (len == 4) {
-		if (strncasecmp(ptr, "grad", 4) == 0)
-			*unit = UNIT_GRAD;
-		else if (strncasecmp(ptr, "dpcm", 4) == 0)
-			*unit = UNIT_DPCM;
-		else if (strncasecmp(ptr, "dppx", 4) == 0)
-			*unit = UNIT_DPPX;
-		else
-			return CSS_INVALID;
-	} else if (len == 3) {
-		if (strncasecmp(ptr, "kHz", 3) == 0)
-			*unit = UNIT_KHZ;
-		else if (strncasecmp(ptr, "deg", 3) == 0)
-			*unit = UNIT_DEG;
-		else if (strncasecmp(ptr, "rad", 3) == 0)
-			*unit = UNIT_RAD;
-		else if (strncasecmp(ptr, "dpi", 3) == 0)
-			*unit = UNIT_DPI;
-		else
-			return CSS_INVALID;
-	} else if (len == 2) {
-		if (strncasecmp(ptr, "Hz", 2) == 0)
-			*unit = UNIT_HZ;
-		else if (strncasecmp(ptr, "ms", 2) == 0)
-			*unit = UNIT_MS;
-		else if (strncasecmp(ptr, "px", 2) == 0)
-			*unit = UNIT_PX;
-		else if (strncasecmp(ptr, "ex", 2) == 0)
-			*unit = UNIT_EX;
-		else if (strncasecmp(ptr, "em", 2) == 0)
-			*unit = UNIT_EM;
-		else if (strncasecmp(ptr, "in", 2) == 0)
-			*unit = UNIT_IN;
-		else if (strncasecmp(ptr, "cm", 2) == 0)
-			*unit = UNIT_CM;
-		else if (strncasecmp(ptr, "mm", 2) == 0)
-			*unit = UNIT_MM;
-		else if (strncasecmp(ptr, "pt", 2) == 0)
-			*unit = UNIT_PT;
-		else if (strncasecmp(ptr, "pc", 2) == 0)
-			*unit = UNIT_PC;
-		else
-			return CSS_INVALID;
-	} else if (len == 1) {
-		if (strncasecmp(ptr, "s", 1) == 0)
-			*unit = UNIT_S;
-		else
-			return CSS_INVALID;
-	} else
-		return CSS_INVALID;
-
-	return CSS_OK;
-}
-
 /**
  * Create a string from a list of IDENT/S tokens if the next token is IDENT
  * or references the next token's string if it is a STRING
@@ -19,6 +19,35 @@ static inline bool is_css_inherit(css_language *c, const css_token *token)
 			&match) == lwc_error_ok && match));
 }
 
+/**
+ * Find the known string a string matches
+ *
+ * \param string  String to consider
+ * \return Number of the matching known string, or -1 if there is none
+ *
+ * Some keywords, such as PAGE and ALL, are also at-rule names or media
+ * types, so every string up to the colour names is searched; none of
+ * those appears twice.
+ */
+static inline int css__parse_keyword_string(lwc_string *string)
+{
+	return css__propstrings_find(string, 0, LAST_COLOUR);
+}
+
+/**
+ * Find the known string an identifier matches
+ *
+ * \param ident  Identifier token to consider
+ * \return Number of the matching known string, or -1 if there is none
+ *
+ * Parsers switch on the result rather than comparing the identifier
+ * against each keyword they accept in turn.
+ */
+static inline int css__parse_keyword(const css_token *ident)
+{
+	return css__parse_keyword_string(ident->idata);
+}
+
 enum border_side_e { BORDER_SIDE_TOP = 0, BORDER_SIDE_RIGHT = 1, BORDER_SIDE_BOTTOM = 2, BORDER_SIDE_LEFT = 3 };
 
 /**
@@ -189,16 +218,14 @@ css_error css__parse_colour_specifier(css_language *c,
 css_error css__parse_named_colour(css_language *c, lwc_string *data, 
 		uint32_t *result);
 
-css_error css__parse_hash_colour(lwc_string *data, uint32_t *result);
+css_error css__parse_hash_colour(const char *input, size_t len,
+		uint32_t *result);
 
 css_error css__parse_unit_specifier(css_language *c,
 		const parserutils_vector *vector, int *ctx,
 		uint32_t default_unit,
 		css_fixed *length, uint32_t *unit);
 
-css_error css__parse_unit_keyword(const char *ptr, size_t len, 
-		uint32_t *unit);
-
 css_error css__ident_list_or_string_to_string(css_language *c,
 		const parserutils_vector *vector, int *ctx,
 		bool (*reserved)(css_language *c, const css_token *ident),
@@ -9,18 +9,29 @@
 #include "stylesheet.h"
 
 #include <assert.h>
+#include <pthread.h>
 
 typedef struct stringmap_entry {
 	const char *data;
 	size_t len;
 } stringmap_entry;
 
+/* Size of the index of known strings. Must be a power of two, and is at
+ * least twice LAST_KNOWN to keep probe sequences short. */
+#define INDEX_SIZE (2048)
+
 typedef struct css__propstrings_ctx {
-	uint32_t count;
+	css_error error;
 	lwc_string *strings[LAST_KNOWN];
+	lwc_static_string storage[LAST_KNOWN];
+	uint16_t index[INDEX_SIZE];	/**< Open addressed hash table of
+					 * string numbers + 1, keyed on
+					 * the caseless hash of the string,
+					 * with 0 marking an empty slot */
 } css__propstrings_ctx;
 
 static css__propstrings_ctx css__propstrings;
+static pthread_once_t css__propstrings_once = PTHREAD_ONCE_INIT;
 
 /* Must be synchronised with enum in propstrings.h */
 const stringmap_entry stringmap[LAST_KNOWN] = {
@@ -631,6 +642,35 @@ const stringmap_entry stringmap[LAST_KNOWN] = {
 };
 
 
+/**
+ * Intern all known strings as immortal strings in static storage.
+ */
+static void css__propstrings_init(void)
+{
+	int i;
+	lwc_error lerror;
+
+	for (i = 0; i < LAST_KNOWN; i++) {
+		uint32_t slot;
+
+		lerror = lwc_intern_static_string(
+				&css__propstrings.storage[i],
+				stringmap[i].data, stringmap[i].len,
+				&css__propstrings.strings[i]);
+
+		if (lerror != lwc_error_ok) {
+			css__propstrings.error = CSS_NOMEM;
+			return;
+		}
+
+		slot = css__propstrings.strings[i]->lcase_hash;
+		while (css__propstrings.index[slot & (INDEX_SIZE - 1)] != 0)
+			slot++;
+
+		css__propstrings.index[slot & (INDEX_SIZE - 1)] = i + 1;
+	}
+}
+
 /**
  * Obtain pointer to interned propstring list
  *
@@ -639,28 +679,16 @@ const stringmap_entry stringmap[LAST_KNOWN] = {
  *	   CSS_NOMEM on memory exhaustion
  *
  * The propstring list is generated with the first call to this function and
- * destroyed when it has no more users.  Call css__propstrings_unref() when
- * finished with the propstring list.
+ * lives for the rest of the process.  Its strings are immortal, so they
+ * need no unreffing and comparing against them is a plain pointer
+ * compare.
  */
 css_error css__propstrings_get(lwc_string ***strings)
 {
-	if (css__propstrings.count > 0) {
-		css__propstrings.count++;
-	} else {
-		int i;
-		lwc_error lerror;
-
-		/* Intern all known strings */
-		for (i = 0; i < LAST_KNOWN; i++) {
-			lerror = lwc_intern_string(stringmap[i].data,
-					stringmap[i].len,
-					&css__propstrings.strings[i]);
-
-			if (lerror != lwc_error_ok)
-				return CSS_NOMEM;
-		}
-		css__propstrings.count++;
-	}
+	pthread_once(&css__propstrings_once, css__propstrings_init);
+
+	if (css__propstrings.error != CSS_OK)
+		return css__propstrings.error;
 
 	*strings = css__propstrings.strings;
 
@@ -668,20 +696,32 @@ css_error css__propstrings_get(lwc_string ***strings)
 }
 
 /**
- * Reduce reference count for propstring list by one.
+ * Find the known string in a range which matches a string, ignoring case
+ *
+ * \param string  The string to look for
+ * \param first   Number of the first known string in the range
+ * \param last    Number of the last known string in the range
+ * \return Number of the matching known string, or -1 if there is none
  *
- * When count hits zero, the list is destroyed.
+ * css__propstrings_get must have succeeded before this is called.
  */
-void css__propstrings_unref(void)
+int css__propstrings_find(lwc_string *string, int first, int last)
 {
-	css__propstrings.count--;
+	uint32_t slot = string->lcase_hash;
+	int i;
 
-	if (css__propstrings.count == 0) {
-		int i;
+	while ((i = css__propstrings.index[slot & (INDEX_SIZE - 1)]) != 0) {
+		bool match = false;
 
-		for (i = 0; i < LAST_KNOWN; i++)
-			lwc_string_unref(css__propstrings.strings[i]);
-	}
-}
+		i--;
 
+		if (i >= first && i <= last && lwc_string_caseless_isequal(
+				string, css__propstrings.strings[i],
+				&match) == lwc_error_ok && match)
+			return i;
 
+		slot++;
+	}
+
+	return -1;
+}
@@ -195,7 +195,7 @@ enum {
 };
 
 css_error css__propstrings_get(lwc_string ***strings);
-void css__propstrings_unref(void);
+int css__propstrings_find(lwc_string *string, int first, int last);
 
 #endif
 
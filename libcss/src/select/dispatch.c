@@ -48,6 +48,11 @@ struct prop_table prop_dispatch[CSS_N_PROPERTIES] = {
 		0,
 		GROUP_NORMAL
 	},
+	{
+		PROPERTY_FUNCS(background_size),
+		0,
+		GROUP_NORMAL
+	},
 	{
 		PROPERTY_FUNCS(border_collapse),
 		1,
@@ -118,6 +123,31 @@ struct prop_table prop_dispatch[CSS_N_PROPERTIES] = {
 		0,
 		GROUP_NORMAL
 	},
+	{
+		PROPERTY_FUNCS(border_radius),
+		0,
+		GROUP_NORMAL
+	},
+	{
+		PROPERTY_FUNCS(border_top_left_radius),
+		0,
+		GROUP_NORMAL
+	},
+	{
+		PROPERTY_FUNCS(border_top_right_radius),
+		0,
+		GROUP_NORMAL
+	},
+	{
+		PROPERTY_FUNCS(border_bottom_left_radius),
+		0,
+		GROUP_NORMAL
+	},
+	{
+		PROPERTY_FUNCS(border_bottom_right_radius),
+		0,
+		GROUP_NORMAL
+	},
 	{
 		PROPERTY_FUNCS(bottom),
 		0,
@@ -228,6 +258,11 @@ struct prop_table prop_dispatch[CSS_N_PROPERTIES] = {
 		0,
 		GROUP_NORMAL
 	},
+	{
+		PROPERTY_FUNCS(hyphens),
+		1,
+		GROUP_NORMAL
+	},
 	{
 		PROPERTY_FUNCS(left),
 		0,
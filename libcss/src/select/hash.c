@@ -75,9 +75,13 @@ static css_error _iterate_universal(
 
 
 /* No bytecode if rule body is empty or wholly invalid --
- * Only interested in rules with bytecode */
+ * Only interested in rules with bytecode, or with a body yet to be compiled.
+ * Another thread may compile the body, which sets the style before it
+ * clears the source, so the source is read first */
 #define RULE_HAS_BYTECODE(r) \
-	(((css_rule_selector *)(r->sel->rule))->style != NULL)
+	(__atomic_load_n(&((css_rule_selector *)(r->sel->rule))->source, \
+			__ATOMIC_ACQUIRE) != NULL || \
+	 ((css_rule_selector *)(r->sel->rule))->style != NULL)
 
 
 /**
@@ -0,0 +1,68 @@
+/*
+ * This file is part of LibCSS
+ * Licensed under the MIT License,
+ *		  http://www.opensource.org/licenses/mit-license.php
+ */
+
+#include "bytecode/bytecode.h"
+#include "bytecode/opcodes.h"
+#include "select/propset.h"
+#include "select/propget.h"
+#include "utils/utils.h"
+
+#include "select/properties/properties.h"
+#include "select/properties/helpers.h"
+
+/* Computed styles have nowhere to keep background-size yet, so its values
+ * are only stepped over */
+
+css_error css__cascade_background_size(uint32_t opv, css_style *style,
+		css_select_state *state)
+{
+	uint32_t value;
+
+	UNUSED(state);
+
+	if (isInherit(opv) || getValue(opv) == BACKGROUND_SIZE_COVER ||
+			getValue(opv) == BACKGROUND_SIZE_CONTAIN)
+		return CSS_OK;
+
+	do {
+		value = *((uint32_t *) style->bytecode);
+		advance_bytecode(style, sizeof(value));
+
+		if (value == BACKGROUND_SIZE_VALUE)
+			advance_bytecode(style,
+					sizeof(css_fixed) + sizeof(uint32_t));
+	} while (value != BACKGROUND_SIZE_END);
+
+	return CSS_OK;
+}
+
+css_error css__set_background_size_from_hint(const css_hint *hint,
+		css_computed_style *style)
+{
+	UNUSED(hint);
+	UNUSED(style);
+
+	return CSS_OK;
+}
+
+css_error css__initial_background_size(css_select_state *state)
+{
+	UNUSED(state);
+
+	return CSS_OK;
+}
+
+css_error css__compose_background_size(const css_computed_style *parent,
+		const css_computed_style *child,
+		css_computed_style *result)
+{
+	UNUSED(parent);
+	UNUSED(child);
+	UNUSED(result);
+
+	return CSS_OK;
+}
+
@@ -0,0 +1,223 @@
+/*
+ * This file is part of LibCSS
+ * Licensed under the MIT License,
+ *		  http://www.opensource.org/licenses/mit-license.php
+ */
+
+#include "bytecode/bytecode.h"
+#include "bytecode/opcodes.h"
+#include "select/propset.h"
+#include "select/propget.h"
+#include "utils/utils.h"
+
+#include "select/properties/properties.h"
+#include "select/properties/helpers.h"
+
+/* Computed styles have nowhere to keep border radii yet, so the values of
+ * border-radius and its longhands are only stepped over */
+
+/**
+ * Step over the values of a border radius property
+ *
+ * \param opv    The property's opcode-value
+ * \param style  Style whose bytecode is at the values
+ * eturn CSS_OK
+ */
+static css_error cascade_border_radius(uint32_t opv, css_style *style)
+{
+	uint32_t value;
+
+	if (isInherit(opv))
+		return CSS_OK;
+
+	value = *((uint32_t *) style->bytecode);
+	advance_bytecode(style, sizeof(value));
+
+	while (value != BORDER_RADIUS_END) {
+		if (value == BORDER_RADIUS_DIMENSION_VALUE)
+			advance_bytecode(style,
+					sizeof(css_fixed) + sizeof(uint32_t));
+		else if (value == BORDER_RADIUS_NUMBER_VALUE)
+			advance_bytecode(style, sizeof(css_fixed));
+
+		value = *((uint32_t *) style->bytecode);
+		advance_bytecode(style, sizeof(value));
+	}
+
+	return CSS_OK;
+}
+
+css_error css__cascade_border_radius(uint32_t opv, css_style *style,
+		css_select_state *state)
+{
+	UNUSED(state);
+
+	return cascade_border_radius(opv, style);
+}
+
+css_error css__set_border_radius_from_hint(const css_hint *hint,
+		css_computed_style *style)
+{
+	UNUSED(hint);
+	UNUSED(style);
+
+	return CSS_OK;
+}
+
+css_error css__initial_border_radius(css_select_state *state)
+{
+	UNUSED(state);
+
+	return CSS_OK;
+}
+
+css_error css__compose_border_radius(const css_computed_style *parent,
+		const css_computed_style *child,
+		css_computed_style *result)
+{
+	UNUSED(parent);
+	UNUSED(child);
+	UNUSED(result);
+
+	return CSS_OK;
+}
+
+css_error css__cascade_border_top_left_radius(uint32_t opv, css_style *style,
+		css_select_state *state)
+{
+	UNUSED(state);
+
+	return cascade_border_radius(opv, style);
+}
+
+css_error css__set_border_top_left_radius_from_hint(const css_hint *hint,
+		css_computed_style *style)
+{
+	UNUSED(hint);
+	UNUSED(style);
+
+	return CSS_OK;
+}
+
+css_error css__initial_border_top_left_radius(css_select_state *state)
+{
+	UNUSED(state);
+
+	return CSS_OK;
+}
+
+css_error css__compose_border_top_left_radius(const css_computed_style *parent,
+		const css_computed_style *child,
+		css_computed_style *result)
+{
+	UNUSED(parent);
+	UNUSED(child);
+	UNUSED(result);
+
+	return CSS_OK;
+}
+
+css_error css__cascade_border_top_right_radius(uint32_t opv, css_style *style,
+		css_select_state *state)
+{
+	UNUSED(state);
+
+	return cascade_border_radius(opv, style);
+}
+
+css_error css__set_border_top_right_radius_from_hint(const css_hint *hint,
+		css_computed_style *style)
+{
+	UNUSED(hint);
+	UNUSED(style);
+
+	return CSS_OK;
+}
+
+css_error css__initial_border_top_right_radius(css_select_state *state)
+{
+	UNUSED(state);
+
+	return CSS_OK;
+}
+
+css_error css__compose_border_top_right_radius(const css_computed_style *parent,
+		const css_computed_style *child,
+		css_computed_style *result)
+{
+	UNUSED(parent);
+	UNUSED(child);
+	UNUSED(result);
+
+	return CSS_OK;
+}
+
+css_error css__cascade_border_bottom_left_radius(uint32_t opv, css_style *style,
+		css_select_state *state)
+{
+	UNUSED(state);
+
+	return cascade_border_radius(opv, style);
+}
+
+css_error css__set_border_bottom_left_radius_from_hint(const css_hint *hint,
+		css_computed_style *style)
+{
+	UNUSED(hint);
+	UNUSED(style);
+
+	return CSS_OK;
+}
+
+css_error css__initial_border_bottom_left_radius(css_select_state *state)
+{
+	UNUSED(state);
+
+	return CSS_OK;
+}
+
+css_error css__compose_border_bottom_left_radius(const css_computed_style *parent,
+		const css_computed_style *child,
+		css_computed_style *result)
+{
+	UNUSED(parent);
+	UNUSED(child);
+	UNUSED(result);
+
+	return CSS_OK;
+}
+
+css_error css__cascade_border_bottom_right_radius(uint32_t opv, css_style *style,
+		css_select_state *state)
+{
+	UNUSED(state);
+
+	return cascade_border_radius(opv, style);
+}
+
+css_error css__set_border_bottom_right_radius_from_hint(const css_hint *hint,
+		css_computed_style *style)
+{
+	UNUSED(hint);
+	UNUSED(style);
+
+	return CSS_OK;
+}
+
+css_error css__initial_border_bottom_right_radius(css_select_state *state)
+{
+	UNUSED(state);
+
+	return CSS_OK;
+}
+
+css_error css__compose_border_bottom_right_radius(const css_computed_style *parent,
+		const css_computed_style *child,
+		css_computed_style *result)
+{
+	UNUSED(parent);
+	UNUSED(child);
+	UNUSED(result);
+
+	return CSS_OK;
+}
@@ -0,0 +1,55 @@
+/*
+ * This file is part of LibCSS
+ * Licensed under the MIT License,
+ *		  http://www.opensource.org/licenses/mit-license.php
+ */
+
+#include "bytecode/bytecode.h"
+#include "bytecode/opcodes.h"
+#include "select/propset.h"
+#include "select/propget.h"
+#include "utils/utils.h"
+
+#include "select/properties/properties.h"
+#include "select/properties/helpers.h"
+
+/* Computed styles have nowhere to keep hyphens yet; its values have no
+ * operands, so there's nothing to step over either */
+
+css_error css__cascade_hyphens(uint32_t opv, css_style *style,
+		css_select_state *state)
+{
+	UNUSED(opv);
+	UNUSED(style);
+	UNUSED(state);
+
+	return CSS_OK;
+}
+
+css_error css__set_hyphens_from_hint(const css_hint *hint,
+		css_computed_style *style)
+{
+	UNUSED(hint);
+	UNUSED(style);
+
+	return CSS_OK;
+}
+
+css_error css__initial_hyphens(css_select_state *state)
+{
+	UNUSED(state);
+
+	return CSS_OK;
+}
+
+css_error css__compose_hyphens(const css_computed_style *parent,
+		const css_computed_style *child,
+		css_computed_style *result)
+{
+	UNUSED(parent);
+	UNUSED(child);
+	UNUSED(result);
+
+	return CSS_OK;
+}
+
@@ -27,6 +27,7 @@ PROPERTY_FUNCS(background_color);
 PROPERTY_FUNCS(background_image);
 PROPERTY_FUNCS(background_position);
 PROPERTY_FUNCS(background_repeat);
+PROPERTY_FUNCS(background_size);
 PROPERTY_FUNCS(border_collapse);
 PROPERTY_FUNCS(border_spacing);
 PROPERTY_FUNCS(border_top_color);
@@ -41,6 +42,11 @@ PROPERTY_FUNCS(border_top_width);
 PROPERTY_FUNCS(border_right_width);
 PROPERTY_FUNCS(border_bottom_width);
 PROPERTY_FUNCS(border_left_width);
+PROPERTY_FUNCS(border_radius);
+PROPERTY_FUNCS(border_top_left_radius);
+PROPERTY_FUNCS(border_top_right_radius);
+PROPERTY_FUNCS(border_bottom_left_radius);
+PROPERTY_FUNCS(border_bottom_right_radius);
 PROPERTY_FUNCS(bottom);
 PROPERTY_FUNCS(break_after);
 PROPERTY_FUNCS(break_before);
@@ -74,6 +80,7 @@ PROPERTY_FUNCS(font_style);
 PROPERTY_FUNCS(font_variant);
 PROPERTY_FUNCS(font_weight);
 PROPERTY_FUNCS(height);
+PROPERTY_FUNCS(hyphens);
 PROPERTY_FUNCS(left);
 PROPERTY_FUNCS(letter_spacing);
 PROPERTY_FUNCS(line_height);
@@ -1637,6 +1637,8 @@ css_error match_selector_chain(css_select_ctx *ctx,
 	const css_selector *s = selector;
 	void *node = state->node;
 	const css_selector_detail *detail = &s->data;
+	css_rule_selector *rule;
+	css_stylesheet *sheet;
 	bool match = false, may_optimise = true;
 	bool rejected_by_cache;
 	css_pseudo_element pseudo;
@@ -1715,6 +1717,23 @@ css_error match_selector_chain(css_select_ctx *ctx,
 	} while (s != NULL);
 
 	/* If we got here, then the entire selector chain matched, so cascade */
+	rule = (css_rule_selector *) selector->rule;
+
+	/* Lazy sheets are written to while selecting from them, under
+	 * their compile lock */
+	sheet = (css_stylesheet *) state->sheet;
+
+	/* Compile the rule's declarations, if that's yet to happen. The rule 
+	 * may turn out to have none. */
+	if (__atomic_load_n(&rule->source, __ATOMIC_ACQUIRE) != NULL) {
+		error = css__stylesheet_rule_compile(sheet, selector->rule);
+		if (error != CSS_OK)
+			return error;
+
+		if (rule->style == NULL)
+			return CSS_OK;
+	}
+
 	state->current_specificity = selector->specificity;
 
 	/* Ensure that the appropriate computed style exists */
@@ -1728,8 +1747,16 @@ css_error match_selector_chain(css_select_ctx *ctx,
 	state->current_pseudo = pseudo;
 	state->computed = state->results->styles[pseudo];
 
-	return cascade_style(((css_rule_selector *) selector->rule)->style, 
-			state);
+	if (sheet->lazy_styles == false)
+		return cascade_style(rule->style, state);
+
+	/* Another thread compiling one of the sheet's rules may grow the
+	 * string vector the style's strings are read from */
+	pthread_rwlock_rdlock(&sheet->compile_lock);
+	error = cascade_style(rule->style, state);
+	pthread_rwlock_unlock(&sheet->compile_lock);
+
+	return error;
 }
 
 css_error match_named_combinator(css_select_ctx *ctx, css_combinator type,
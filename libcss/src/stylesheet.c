@@ -6,11 +6,23 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
 #include <string.h>
+#include <strings.h>
 #include <stdarg.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../libparserutils/include/parserutils/charset/mibenum.h"
 
 #include "./stylesheet.h"
 #include "./bytecode/bytecode.h"
+#include "./charset/detect.h"
+#include "./lex/prescan.h"
+#include "./lex/scan.h"
 #include "./parse/language.h"
 #include "./utils/parserutilserror.h"
 #include "./utils/utils.h"
@@ -21,6 +33,37 @@ static css_error _add_selectors(css_stylesheet *sheet, css_rule *rule);
 static css_error _remove_selectors(css_stylesheet *sheet, css_rule *rule);
 static size_t _rule_size(const css_rule *rule);
 static css_error _style_create_impl(css_stylesheet *sheet, css_style **style);
+static css_error _string_add(css_stylesheet *sheet, lwc_string *string,
+		uint32_t *string_number);
+static size_t _find_segments(const uint8_t *data, size_t len, size_t count,
+		size_t *ends);
+static bool _may_split_at_rule(const uint8_t *name, size_t len, bool first);
+static void *_parse_segment(void *pw);
+static css_error _splice_segment(css_stylesheet *sheet, 
+		css_stylesheet *segment, size_t base_size);
+static css_error _splice_rule(css_stylesheet *sheet, css_rule *rule,
+		css_rule *parent);
+
+/** Smallest segment worth parsing on a thread of its own, in bytes */
+#define PARALLEL_MIN_SEGMENT (64 * 1024)
+/** Most segments a sheet's data is split into */
+#define PARALLEL_MAX_SEGMENTS (64)
+
+/**
+ * Segment of a stylesheet's data being parsed on its own thread
+ */
+typedef struct parallel_segment {
+	css_stylesheet *sheet;		/**< Sheet the data belongs to */
+	const uint8_t *data;		/**< Data of segment */
+	size_t len;			/**< Length of segment, in bytes */
+	lwc_context *ctx;		/**< Context to intern strings in */
+
+	pthread_t thread;		/**< Thread parsing the segment */
+
+	css_stylesheet *segment;	/**< Sheet holding segment's rules */
+	size_t base_size;		/**< Size of segment before parsing */
+	css_error error;		/**< Result of parsing */
+} parallel_segment;
 
 /**
  * Add a string to a stylesheet's string vector.
@@ -36,6 +79,33 @@ static css_error _style_create_impl(css_stylesheet *sheet, css_style **style);
  * \note The returned string number is guaranteed to be non-zero
  */
 css_error css__stylesheet_string_add(css_stylesheet *sheet, lwc_string *string, uint32_t *string_number)
+{
+	css_error error;
+
+	/* Segments share the string vector of the sheet they belong to */
+	if (sheet->segment_of != NULL)
+		sheet = sheet->segment_of;
+
+	if (sheet->string_lock == NULL)
+		return _string_add(sheet, string, string_number);
+
+	pthread_mutex_lock(sheet->string_lock);
+	error = _string_add(sheet, string, string_number);
+	pthread_mutex_unlock(sheet->string_lock);
+
+	return error;
+}
+
+/**
+ * Add a string to a stylesheet's string vector, without locking
+ *
+ * \param sheet The stylesheet to add string to.
+ * \param string The string to add.
+ * \param string_number Pointer to location to receive string number.
+ * \return CSS_OK on success, appropriate error otherwise
+ */
+css_error _string_add(css_stylesheet *sheet, lwc_string *string, 
+		uint32_t *string_number)
 {
 	uint32_t new_string_number; /* The string number count */
 
@@ -66,12 +136,16 @@ css_error css__stylesheet_string_add(css_stylesheet *sheet, lwc_string *string,
 
 	if (sheet->string_vector_c >= sheet->string_vector_l) {
 		/* additional storage must be allocated to deal with
-		 * this request. 
+		 * this request. Double it, so that sheets with many
+		 * strings don't copy the vector every 256 of them.
 		 */
 		lwc_string **new_vector;
 		uint32_t new_vector_len;
 
-		new_vector_len = sheet->string_vector_l + 256;
+		if (sheet->string_vector_l == 0)
+			new_vector_len = 256;
+		else
+			new_vector_len = sheet->string_vector_l * 2;
 		new_vector = realloc(sheet->string_vector,
 				new_vector_len * sizeof(lwc_string *));
 
@@ -102,6 +176,9 @@ css_error css__stylesheet_string_add(css_stylesheet *sheet, lwc_string *string,
 css_error css__stylesheet_string_get(css_stylesheet *sheet,
 		uint32_t string_number, lwc_string **string)
 {
+	if (sheet->segment_of != NULL)
+		sheet = sheet->segment_of;
+
 	/* External string numbers = index into vector + 1 */
 	string_number--;
 
@@ -129,8 +206,11 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 	css_error error;
 	css_stylesheet *sheet;
 
-	if (params == NULL || params->params_version != 
-				CSS_STYLESHEET_PARAMS_VERSION_1 ||
+	if (params == NULL || 
+			(params->params_version != 
+				CSS_STYLESHEET_PARAMS_VERSION_1 &&
+			params->params_version != 
+				CSS_STYLESHEET_PARAMS_VERSION_2) ||
 			params->url == NULL || params->resolve == NULL ||
 			stylesheet == NULL)
 		return CSS_BADPARM;
@@ -147,6 +227,11 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 	
 	sheet->inline_style = params->inline_style;
 
+	/* Inline styles are a single declaration block, so gain nothing */
+	if (params->params_version >= CSS_STYLESHEET_PARAMS_VERSION_2)
+		sheet->lazy_styles = params->lazy_styles && 
+				params->inline_style == false;
+
 	if (params->inline_style) {
 		error = css__parser_create_for_inline_style(params->charset, 
 				(params->charset != NULL) ?
@@ -160,7 +245,6 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 	}
 
 	if (error != CSS_OK) {
-		css__propstrings_unref();
 		free(sheet);
 		return error;
 	}
@@ -174,7 +258,6 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 				&optparams);
 		if (error != CSS_OK) {
 			css__parser_destroy(sheet->parser);
-			css__propstrings_unref();
 			free(sheet);
 			return error;
 		}
@@ -185,7 +268,6 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 			&sheet->parser_frontend);
 	if (error != CSS_OK) {
 		css__parser_destroy(sheet->parser);
-		css__propstrings_unref();
 		free(sheet);
 		return error;
 	}
@@ -194,7 +276,6 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 	if (error != CSS_OK) {
 		css__language_destroy(sheet->parser_frontend);
 		css__parser_destroy(sheet->parser);
-		css__propstrings_unref();
 		free(sheet);
 		return error;
 	}
@@ -204,7 +285,6 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 		css__selector_hash_destroy(sheet->selectors);
 		css__language_destroy(sheet->parser_frontend);
 		css__parser_destroy(sheet->parser);
-		css__propstrings_unref();
 		free(sheet);
 		return CSS_NOMEM;
 	}
@@ -216,7 +296,6 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 			css__selector_hash_destroy(sheet->selectors);
 			css__language_destroy(sheet->parser_frontend);
 			css__parser_destroy(sheet->parser);
-			css__propstrings_unref();
 			free(sheet);
 			return CSS_NOMEM;
 		}
@@ -238,6 +317,9 @@ css_error css_stylesheet_create(const css_stylesheet_params *params,
 	if (sheet->title != NULL)
 		sheet->size += strlen(sheet->title);
 
+	if (sheet->lazy_styles)
+		pthread_rwlock_init(&sheet->compile_lock, NULL);
+
 	*stylesheet = sheet;
 
 	return CSS_OK;
@@ -293,8 +375,9 @@ css_error css_stylesheet_destroy(css_stylesheet *sheet)
 	if (sheet->string_vector != NULL)
 		free(sheet->string_vector);
 
-	css__propstrings_unref();
-	
+	if (sheet->lazy_styles)
+		pthread_rwlock_destroy(&sheet->compile_lock);
+
 	free(sheet);
 
 	return CSS_OK;
@@ -320,6 +403,219 @@ css_error css_stylesheet_append_data(css_stylesheet *sheet,
 	return css__parser_parse_chunk(sheet->parser, data, len);
 }
 
+/**
+ * Append the contents of a file to a stylesheet
+ *
+ * \param sheet	 The stylesheet to append data to
+ * \param path	 Path of file to append
+ * \return CSS_OK on success,
+ *	   CSS_FILENOTFOUND if the file cannot be opened,
+ *	   appropriate error otherwise
+ *
+ * Regular files are mapped into memory and parsed in place, so their 
+ * contents are not copied unless the charset requires conversion. The 
+ * file must not be truncated while this is in progress. Other files are 
+ * read and appended a chunk at a time.
+ */
+css_error css_stylesheet_append_file(css_stylesheet *sheet, const char *path)
+{
+	uint8_t buf[4096];
+	struct stat st;
+	ssize_t len;
+	css_error error = CSS_OK;
+	int fd;
+
+	if (sheet == NULL || path == NULL)
+		return CSS_BADPARM;
+
+	if (sheet->parser == NULL)
+		return CSS_INVALID;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return CSS_FILENOTFOUND;
+
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+			(uintmax_t) st.st_size <= SIZE_MAX) {
+		size_t size = st.st_size;
+		void *data;
+
+		data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			close(fd);
+
+			/* The parser reads the data once, from start to end */
+			posix_madvise(data, size, POSIX_MADV_SEQUENTIAL);
+
+			/* The parser has released the data when this returns */
+			error = css__parser_parse_chunk(sheet->parser, 
+					data, size);
+
+			munmap(data, size);
+
+			return error;
+		}
+	}
+
+	while ((len = read(fd, buf, sizeof(buf))) != 0) {
+		if (len < 0) {
+			if (errno == EINTR)
+				continue;
+
+			error = CSS_INVALID;
+			break;
+		}
+
+		error = css__parser_parse_chunk(sheet->parser, buf, len);
+		if (error != CSS_OK && error != CSS_NEEDDATA)
+			break;
+	}
+
+	close(fd);
+
+	return error;
+}
+
+/**
+ * Append all of a stylesheet's source data, parsing it on several threads
+ *
+ * \param sheet	   The stylesheet to append data to
+ * \param data	   Pointer to the stylesheet's data
+ * \param len	   Length, in bytes, of data
+ * \param threads  Number of threads to use, or 0 for one per processor
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The data is split at the ends of top-level rules, the segments are 
+ * parsed concurrently, and their rules appended to the sheet in source 
+ * order. The rules, their indices and the selector hash are the same 
+ * as if the data had been passed to css_stylesheet_append_data.
+ *
+ * This must be the only data appended to the sheet, and must be followed
+ * by a call to css_stylesheet_data_done. Data that is too small to be 
+ * worth splitting, or which cannot be split safely (for instance, if it 
+ * is not UTF-8 or uses @namespace) is parsed on the calling thread.
+ *
+ * Strings are interned in the calling thread's lwc context, on every
+ * thread, just as css_stylesheet_append_data would intern them.
+ *
+ * \note The client's URL, colour and font resolution callbacks may be
+ *       called concurrently from several threads.
+ */
+css_error css_stylesheet_append_data_parallel(css_stylesheet *sheet,
+		const uint8_t *data, size_t len, uint32_t threads)
+{
+	parallel_segment segments[PARALLEL_MAX_SEGMENTS];
+	size_t ends[PARALLEL_MAX_SEGMENTS];
+	css_charset_source source;
+	const char *charset;
+	uint16_t mibenum = 0;
+	uint32_t src;
+	pthread_mutex_t lock;
+	lwc_context *ctx;
+	size_t count, started, i;
+	css_error error;
+
+	if (sheet == NULL || data == NULL)
+		return CSS_BADPARM;
+
+	if (sheet->parser == NULL)
+		return CSS_INVALID;
+
+	if (threads == 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+		threads = n > 0 ? n : 1;
+	}
+
+	count = len / PARALLEL_MIN_SEGMENT;
+	if (count > threads)
+		count = threads;
+	if (count > PARALLEL_MAX_SEGMENTS)
+		count = PARALLEL_MAX_SEGMENTS;
+
+	/* Segments are split, and decoded, as UTF-8 */
+	charset = css__parser_read_charset(sheet->parser, &source);
+	if (charset != NULL)
+		mibenum = parserutils_charset_mibenum_from_name(charset,
+				strlen(charset));
+	src = source;
+
+	if (css__charset_extract(data, len, &mibenum, &src) != 
+			PARSERUTILS_OK || mibenum != 
+			parserutils_charset_mibenum_from_name("UTF-8", 
+					SLEN("UTF-8")))
+		count = 1;
+
+	if (sheet->inline_style || sheet->rule_list != NULL)
+		count = 1;
+
+	if (count > 1)
+		count = _find_segments(data, len, count, ends);
+
+	if (count < 2)
+		return css__parser_parse_chunk(sheet->parser, data, len);
+
+	pthread_mutex_init(&lock, NULL);
+	sheet->string_lock = &lock;
+
+	/* Find the caller's intern context, which the segments' threads
+	 * must select so that all the sheet's strings are interned in it */
+	ctx = lwc_context_select(NULL);
+	lwc_context_select(ctx);
+
+	for (i = 1; i < count; i++) {
+		segments[i].sheet = sheet;
+		segments[i].data = data + ends[i - 1];
+		segments[i].len = ends[i] - ends[i - 1];
+		segments[i].ctx = ctx;
+		segments[i].segment = NULL;
+		segments[i].error = CSS_OK;
+
+		if (pthread_create(&segments[i].thread, NULL, 
+				_parse_segment, &segments[i]) != 0)
+			break;
+	}
+	started = i;
+
+	/* The first segment is parsed here, by the sheet's own parser, 
+	 * as it's the only one which may hold @charset and @import */
+	error = css__parser_parse_chunk(sheet->parser, data, ends[0]);
+
+	for (i = 1; i < started; i++)
+		pthread_join(segments[i].thread, NULL);
+
+	/* Parse any segments we failed to start a thread for */
+	for (i = started; i < count; i++)
+		_parse_segment(&segments[i]);
+
+	sheet->string_lock = NULL;
+	pthread_mutex_destroy(&lock);
+
+	/* The parser normally wants more data at this point, as it's not 
+	 * been told that this is the end of it */
+	for (i = 1; i < count && (error == CSS_OK || error == CSS_NEEDDATA) &&
+			segments[i].error == CSS_OK; i++) {
+		css_error serror = _splice_segment(sheet, 
+				segments[i].segment, segments[i].base_size);
+		if (serror != CSS_OK)
+			error = serror;
+	}
+
+	/* If a segment failed, parse the rest of the data here instead, 
+	 * so that it fails just as it would have done without splitting */
+	if ((error == CSS_OK || error == CSS_NEEDDATA) && i < count) {
+		error = css__parser_parse_chunk(sheet->parser, 
+				data + ends[i - 1], len - ends[i - 1]);
+	}
+
+	for (i = 1; i < count; i++) {
+		if (segments[i].segment != NULL)
+			css_stylesheet_destroy(segments[i].segment);
+	}
+
+	return error;
+}
+
 /**
  * Flag that the last of a stylesheet's data has been seen
  *
@@ -1184,6 +1480,9 @@ css_error css__stylesheet_rule_destroy(css_stylesheet *sheet, css_rule *rule)
 
 		if (s->style != NULL)
 			css__stylesheet_style_destroy(s->style);
+
+		if (s->source != NULL)
+			free(s->source);
 	}
 		break;
 	case CSS_RULE_CHARSET:
@@ -1340,6 +1639,152 @@ css_error css__stylesheet_rule_append_style(css_stylesheet *sheet,
 	return CSS_OK;
 }
 
+/**
+ * Set the declaration block of a CSS rule, to be compiled on first use
+ *
+ * \param sheet  The stylesheet context
+ * \param rule   The rule to add to (must be CSS_RULE_SELECTOR)
+ * \param data   The text of the declaration block, in UTF-8
+ * \param len    Length, in bytes, of data
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The text is copied. See css__stylesheet_rule_compile.
+ */
+css_error css__stylesheet_rule_set_source(css_stylesheet *sheet,
+		css_rule *rule, const uint8_t *data, size_t len)
+{
+	css_rule_selector *r = (css_rule_selector *) rule;
+
+	if (sheet == NULL || rule == NULL || data == NULL || len == 0)
+		return CSS_BADPARM;
+
+	/* Ensure rule is a CSS_RULE_SELECTOR, without a block already */
+	if (rule->type != CSS_RULE_SELECTOR || r->style != NULL || 
+			r->source != NULL)
+		return CSS_INVALID;
+
+	r->source = malloc(len);
+	if (r->source == NULL)
+		return CSS_NOMEM;
+
+	memcpy(r->source, data, len);
+	r->source_len = len;
+
+	/* Add to the sheet's size */
+	sheet->size += len;
+
+	return CSS_OK;
+}
+
+/**
+ * Compile the pending declaration block of a CSS rule
+ *
+ * \param sheet  The stylesheet containing the rule
+ * \param rule   The rule to compile (must be CSS_RULE_SELECTOR)
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The block is parsed as an inline style, and the resulting style replaces
+ * the rule's source. The rule is left without a style if the block has no
+ * valid declarations. Rules without a pending block are left untouched.
+ *
+ * As parsing the block may use quirks, the sheet's quirks_used flag is
+ * only complete once all its rules are compiled.
+ *
+ * The sheet's compile lock is held for writing while the block is
+ * compiled, so that rules may be compiled while selecting on several
+ * threads. The source is cleared last, with release semantics, so that a
+ * thread which sees it cleared also sees the style.
+ */
+css_error css__stylesheet_rule_compile(css_stylesheet *sheet, css_rule *rule)
+{
+	css_rule_selector *r = (css_rule_selector *) rule;
+	css_stylesheet_params params;
+	css_stylesheet *block;
+	css_rule_selector *compiled;
+	uint8_t *source;
+	css_error error;
+
+	if (sheet == NULL || rule == NULL)
+		return CSS_BADPARM;
+
+	if (rule->type != CSS_RULE_SELECTOR)
+		return CSS_INVALID;
+
+	/* Only lazy sheets have pending blocks, or a compile lock */
+	if (sheet->lazy_styles == false)
+		return CSS_OK;
+
+	pthread_rwlock_wrlock(&sheet->compile_lock);
+
+	/* Another thread may have compiled the rule while we waited */
+	if (r->source == NULL) {
+		pthread_rwlock_unlock(&sheet->compile_lock);
+		return CSS_OK;
+	}
+
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_1;
+	params.level = sheet->level;
+	params.charset = "UTF-8";
+	params.url = sheet->url;
+	params.title = sheet->title;
+	params.allow_quirks = sheet->quirks_allowed;
+	params.inline_style = true;
+	params.resolve = sheet->resolve;
+	params.resolve_pw = sheet->resolve_pw;
+	params.import = sheet->import;
+	params.import_pw = sheet->import_pw;
+	params.color = sheet->color;
+	params.color_pw = sheet->color_pw;
+	params.font = sheet->font;
+	params.font_pw = sheet->font_pw;
+
+	error = css_stylesheet_create(&params, &block);
+	if (error != CSS_OK) {
+		pthread_rwlock_unlock(&sheet->compile_lock);
+		return error;
+	}
+
+	/* Strings referenced by the style must be in this sheet's vector */
+	block->segment_of = sheet;
+
+	/* Invalid content stops the parse, leaving the declarations that
+	 * precede it. Unlike an eager parse of the sheet, which fails at the
+	 * same point, the sheet's other rules are kept. */
+	error = css_stylesheet_append_data(block, r->source, r->source_len);
+	if (error == CSS_OK || error == CSS_NEEDDATA)
+		error = css_stylesheet_data_done(block);
+	if (error != CSS_OK && error != CSS_INVALID) {
+		css_stylesheet_destroy(block);
+		pthread_rwlock_unlock(&sheet->compile_lock);
+		return error;
+	}
+
+	compiled = (css_rule_selector *) block->rule_list;
+	if (compiled != NULL && compiled->style != NULL) {
+		r->style = compiled->style;
+		r->style->sheet = sheet;
+		compiled->style = NULL;
+
+		sheet->size += (r->style->used * sizeof(css_code_t));
+	}
+
+	if (block->quirks_used)
+		sheet->quirks_used = true;
+
+	css_stylesheet_destroy(block);
+
+	sheet->size -= r->source_len;
+
+	source = r->source;
+	r->source_len = 0;
+	__atomic_store_n(&r->source, NULL, __ATOMIC_RELEASE);
+	free(source);
+
+	pthread_rwlock_unlock(&sheet->compile_lock);
+
+	return CSS_OK;
+}
+
 /**
  * Set the charset of a CSS rule
  *
@@ -1474,10 +1919,13 @@ css_error css__stylesheet_add_rule(css_stylesheet *sheet, css_rule *rule,
 	 */
 	rule->index = sheet->rule_count;
 
-	/* Add any selectors to the hash */
-	error = _add_selectors(sheet, rule);
-	if (error != CSS_OK)
-		return error;
+	/* Add any selectors to the hash. A segment's are added when it 
+	 * is spliced into its sheet. */
+	if (sheet->segment_of == NULL) {
+		error = _add_selectors(sheet, rule);
+		if (error != CSS_OK)
+			return error;
+	}
 
 	/* Add to the sheet's size */
 	sheet->size += _rule_size(rule);
@@ -1539,9 +1987,11 @@ css_error css__stylesheet_remove_rule(css_stylesheet *sheet, css_rule *rule)
 	if (sheet == NULL || rule == NULL)
 		return CSS_BADPARM;
 
-	error = _remove_selectors(sheet, rule);
-	if (error != CSS_OK)
-		return error;
+	if (sheet->segment_of == NULL) {
+		error = _remove_selectors(sheet, rule);
+		if (error != CSS_OK)
+			return error;
+	}
 
 	/* Reduce sheet's size */
 	sheet->size -= _rule_size(rule);
@@ -1727,6 +2177,8 @@ size_t _rule_size(const css_rule *r)
 
 		if (rs->style != NULL)
 			bytes += (rs->style->used * sizeof(css_code_t));
+
+		bytes += rs->source_len;
 	} else if (r->type == CSS_RULE_CHARSET) {
 		bytes += sizeof(css_rule_charset);
 	} else if (r->type == CSS_RULE_IMPORT) {
@@ -1772,6 +2224,281 @@ size_t _rule_size(const css_rule *r)
 	return bytes;
 }
 
+/**
+ * Split a stylesheet's data into segments that may be parsed separately
+ *
+ * \param data   Stylesheet data
+ * \param len    Length, in bytes, of data
+ * \param count  Number of segments wanted
+ * \param ends   Array of at least \a count entries to receive the offset
+ *               of the end of each segment
+ * \return Number of segments found, or 1 if the data may not be split
+ *
+ * Segments end after a top-level rule, once they're roughly the wanted 
+ * share of the data. Where a split might change how the data parses 
+ * (unbalanced brackets, @namespace, at-rules with escaped names, or 
+ * @import and @charset after the first segment) the data is not split.
+ */
+size_t _find_segments(const uint8_t *data, size_t len, size_t count,
+		size_t *ends)
+{
+	css_prescan_rule *rules;
+	size_t n_rules, n = 0, target = len / count, i;
+	bool split = true;
+
+	if (css__prescan(data, len, &rules, &n_rules) != CSS_OK)
+		return 1;
+
+	for (i = 0; i < n_rules && split; i++) {
+		if (data[rules[i].start] == '@')
+			split = _may_split_at_rule(data + rules[i].start + 1,
+					rules[i].block - rules[i].start - 1,
+					n == 0);
+
+		if (rules[i].end >= target && n + 1 < count) {
+			ends[n++] = rules[i].end;
+			target = rules[i].end + 
+					(len - rules[i].end) / (count - n);
+		}
+	}
+
+	/* Nor may an incomplete rule at the end of the data */
+	for (i = (n_rules > 0) ? rules[n_rules - 1].end : 0; 
+			i < len && split; i++) {
+		if (data[i] == '@')
+			split = _may_split_at_rule(data + i + 1, len - i - 1, 
+					n == 0);
+	}
+
+	free(rules);
+
+	if (split == false)
+		return 1;
+
+	if (n == 0 || ends[n - 1] != len)
+		ends[n++] = len;
+
+	return n;
+}
+
+/**
+ * Determine whether an at-rule permits its sheet's data to be split
+ *
+ * \param name   Name of the at-rule, following the '@'
+ * \param len    Length, in bytes, of data from name to the rule's block
+ * \param first  Whether the rule is in the first segment
+ * \return True if splitting cannot change how the rule parses
+ */
+bool _may_split_at_rule(const uint8_t *name, size_t len, bool first)
+{
+	size_t name_len = 0;
+
+	while (name_len < len && startNMChar(name[name_len]) &&
+			name[name_len] != '\\')
+		name_len++;
+
+	/* Escaped names aren't worth decoding */
+	if (name_len < len && name[name_len] == '\\')
+		return false;
+
+	if (name_len == SLEN("namespace") && strncasecmp(
+			(const char *) name, "namespace", 
+			SLEN("namespace")) == 0)
+		return false;
+
+	/* These are only valid at the start of the sheet, which a later 
+	 * segment is not */
+	if (first == false && ((name_len == SLEN("import") && 
+			strncasecmp((const char *) name, "import", 
+				SLEN("import")) == 0) ||
+			(name_len == SLEN("charset") && 
+			strncasecmp((const char *) name, "charset", 
+				SLEN("charset")) == 0)))
+		return false;
+
+	return true;
+}
+
+/**
+ * Parse a segment of a stylesheet's data into a sheet of its own
+ *
+ * \param pw  Pointer to the segment to parse
+ * \return NULL
+ *
+ * The segment sheet shares the string vector of the sheet the data 
+ * belongs to, and its strings are interned in the segment's context.
+ * The result of parsing is recorded in the segment.
+ */
+void *_parse_segment(void *pw)
+{
+	parallel_segment *seg = (parallel_segment *) pw;
+	css_stylesheet *parent = seg->sheet;
+	css_stylesheet_params params;
+	css_stylesheet *segment;
+	lwc_context *prev;
+	css_error error;
+
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_2;
+	params.level = parent->level;
+	params.charset = "UTF-8";
+	params.url = parent->url;
+	params.title = parent->title;
+	params.allow_quirks = parent->quirks_allowed;
+	params.inline_style = false;
+	params.lazy_styles = parent->lazy_styles;
+	params.resolve = parent->resolve;
+	params.resolve_pw = parent->resolve_pw;
+	params.import = parent->import;
+	params.import_pw = parent->import_pw;
+	params.color = parent->color;
+	params.color_pw = parent->color_pw;
+	params.font = parent->font;
+	params.font_pw = parent->font_pw;
+
+	prev = lwc_context_select(seg->ctx);
+
+	error = css_stylesheet_create(&params, &segment);
+	if (error != CSS_OK) {
+		lwc_context_select(prev);
+		seg->error = error;
+		return NULL;
+	}
+
+	segment->segment_of = parent;
+
+	seg->segment = segment;
+	seg->base_size = segment->size;
+
+	error = css_stylesheet_append_data(segment, seg->data, seg->len);
+	if (error == CSS_OK || error == CSS_NEEDDATA)
+		error = css_stylesheet_data_done(segment);
+
+	lwc_context_select(prev);
+
+	seg->error = error;
+
+	return NULL;
+}
+
+/**
+ * Move the rules of a parsed segment to the end of a sheet
+ *
+ * \param sheet      The sheet to append the rules to
+ * \param segment    The segment sheet to take the rules from
+ * \param base_size  Size of the segment sheet before parsing
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * The rules are added as if they had been parsed by the sheet itself,
+ * so take the next rule indices and have their selectors hashed.
+ */
+css_error _splice_segment(css_stylesheet *sheet, css_stylesheet *segment,
+		size_t base_size)
+{
+	size_t size = sheet->size;
+	css_error error = CSS_OK;
+	css_rule *r;
+
+	while (error == CSS_OK && (r = segment->rule_list) != NULL) {
+		segment->rule_list = r->next;
+		if (segment->rule_list != NULL)
+			segment->rule_list->prev = NULL;
+		else
+			segment->last_rule = NULL;
+
+		r->parent = NULL;
+		r->next = NULL;
+		r->prev = NULL;
+
+		error = _splice_rule(sheet, r, NULL);
+	}
+
+	segment->rule_count = 0;
+
+	/* Account for the segment's rules and styles exactly once */
+	sheet->size = size + (segment->size - base_size);
+
+	if (segment->quirks_used)
+		sheet->quirks_used = true;
+
+	return error;
+}
+
+/**
+ * Add a rule taken from a segment sheet to a sheet
+ *
+ * \param sheet   The sheet to add the rule to
+ * \param rule    The detached rule
+ * \param parent  The @media rule to add to, or NULL for a top-level rule
+ * \return CSS_OK on success, appropriate error otherwise
+ *
+ * On failure, the rule, and any children not yet added, are destroyed.
+ */
+css_error _splice_rule(css_stylesheet *sheet, css_rule *rule,
+		css_rule *parent)
+{
+	css_rule *children = NULL, *c;
+	css_error error;
+
+	switch (rule->type) {
+	case CSS_RULE_SELECTOR:
+		if (((css_rule_selector *) rule)->style != NULL)
+			((css_rule_selector *) rule)->style->sheet = sheet;
+		break;
+	case CSS_RULE_PAGE:
+		if (((css_rule_page *) rule)->style != NULL)
+			((css_rule_page *) rule)->style->sheet = sheet;
+		break;
+	case CSS_RULE_MEDIA:
+	{
+		css_rule_media *media = (css_rule_media *) rule;
+
+		/* Children are added after their parent, as when parsing */
+		children = media->first_child;
+		media->first_child = media->last_child = NULL;
+	}
+		break;
+	default:
+		break;
+	}
+
+	error = css__stylesheet_add_rule(sheet, rule, parent);
+	if (error != CSS_OK) {
+		if (rule->type == CSS_RULE_MEDIA)
+			((css_rule_media *) rule)->first_child = children;
+		css__stylesheet_rule_destroy(sheet, rule);
+		return error;
+	}
+
+	while (children != NULL) {
+		c = children;
+		children = c->next;
+
+		c->parent = NULL;
+		c->next = NULL;
+		c->prev = NULL;
+		if (children != NULL)
+			children->prev = NULL;
+
+		error = _splice_rule(sheet, c, rule);
+		if (error != CSS_OK)
+			break;
+	}
+
+	/* Destroy any children we failed to add */
+	while (children != NULL) {
+		c = children;
+		children = c->next;
+
+		c->parent = NULL;
+		c->next = NULL;
+		c->prev = NULL;
+
+		css__stylesheet_rule_destroy(sheet, c);
+	}
+
+	return error;
+}
+
 css_error css_stylesheet_media_to_string (const css_media_query *media, lwc_string **result)
 {
 	// TODO: parse bytecode
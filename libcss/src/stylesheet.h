@@ -9,6 +9,7 @@
 #define css_stylesheet_h_
 
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdio.h>
 
 #include "../../libwapcaplet/include/libwapcaplet/libwapcaplet.h"
@@ -127,6 +128,9 @@ typedef struct css_rule_selector {
 
 	css_selector **selectors;
 	css_style *style;
+	uint8_t *source;	/**< Declaration block awaiting compilation,
+				 * or NULL */
+	size_t source_len;	/**< Length of source, in bytes */
 } css_rule_selector;
 
 typedef struct css_rule_media {
@@ -188,6 +192,8 @@ struct css_stylesheet {
 	bool quirks_used;			/**< Quirks actually used */
 
 	bool inline_style;			/**< Is an inline style */
+	bool lazy_styles;			/**< Compile rulesets' 
+						 * declarations on first use */
 
 	size_t size;				/**< Size, in bytes */
 
@@ -211,6 +217,14 @@ struct css_stylesheet {
 						 * length in entries */
 	uint32_t string_vector_c;               /**< The number of string 
 						 * vector entries used */ 
+
+	/** Sheet whose data this one is parsing a segment of, or NULL */
+	struct css_stylesheet *segment_of;
+	/** Lock on the string vector while segments are parsed, or NULL */
+	pthread_mutex_t *string_lock;
+	/** Held for writing while a lazy rule is compiled, and for reading
+	 * while a lazy rule's style is cascaded (lazy_styles only) */
+	pthread_rwlock_t compile_lock;
 };
 
 css_error css__stylesheet_style_create(css_stylesheet *sheet, 
@@ -264,6 +278,11 @@ css_error css__stylesheet_rule_add_selector(css_stylesheet *sheet,
 css_error css__stylesheet_rule_append_style(css_stylesheet *sheet,
 		css_rule *rule, css_style *style);
 
+css_error css__stylesheet_rule_set_source(css_stylesheet *sheet,
+		css_rule *rule, const uint8_t *data, size_t len);
+css_error css__stylesheet_rule_compile(css_stylesheet *sheet,
+		css_rule *rule);
+
 css_error css__stylesheet_rule_set_charset(css_stylesheet *sheet,
 		css_rule *rule, lwc_string *charset);
 
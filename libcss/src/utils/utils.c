@@ -5,6 +5,9 @@
  * Copyright 2007-9 John-Mark Bell <jmb@netsurf-browser.org>
  */
 
+#include <strings.h>
+
+#include "../bytecode/bytecode.h"
 #include "../utils/utils.h"
 
 css_fixed css__number_from_lwc_string(lwc_string *string,
@@ -130,3 +133,67 @@ css_fixed css__number_from_string(const uint8_t *data, size_t len,
 	return (intpart << 10) | fracpart;
 }
 
+/**
+ * Parse a unit keyword
+ *
+ * \param ptr   Pointer to keyword string
+ * \param len   Length, in bytes, of string
+ * \param unit  Pointer to location to receive computed unit
+ * \return CSS_OK      on success,
+ *         CSS_INVALID on encountering an unknown keyword
+ */
+css_error css__parse_unit_keyword(const char *ptr, size_t len, uint32_t *unit)
+{
+	if (len == 4) {
+		if (strncasecmp(ptr, "grad", 4) == 0)
+			*unit = UNIT_GRAD;
+		else if (strncasecmp(ptr, "dpcm", 4) == 0)
+			*unit = UNIT_DPCM;
+		else if (strncasecmp(ptr, "dppx", 4) == 0)
+			*unit = UNIT_DPPX;
+		else
+			return CSS_INVALID;
+	} else if (len == 3) {
+		if (strncasecmp(ptr, "kHz", 3) == 0)
+			*unit = UNIT_KHZ;
+		else if (strncasecmp(ptr, "deg", 3) == 0)
+			*unit = UNIT_DEG;
+		else if (strncasecmp(ptr, "rad", 3) == 0)
+			*unit = UNIT_RAD;
+		else if (strncasecmp(ptr, "dpi", 3) == 0)
+			*unit = UNIT_DPI;
+		else
+			return CSS_INVALID;
+	} else if (len == 2) {
+		if (strncasecmp(ptr, "Hz", 2) == 0)
+			*unit = UNIT_HZ;
+		else if (strncasecmp(ptr, "ms", 2) == 0)
+			*unit = UNIT_MS;
+		else if (strncasecmp(ptr, "px", 2) == 0)
+			*unit = UNIT_PX;
+		else if (strncasecmp(ptr, "ex", 2) == 0)
+			*unit = UNIT_EX;
+		else if (strncasecmp(ptr, "em", 2) == 0)
+			*unit = UNIT_EM;
+		else if (strncasecmp(ptr, "in", 2) == 0)
+			*unit = UNIT_IN;
+		else if (strncasecmp(ptr, "cm", 2) == 0)
+			*unit = UNIT_CM;
+		else if (strncasecmp(ptr, "mm", 2) == 0)
+			*unit = UNIT_MM;
+		else if (strncasecmp(ptr, "pt", 2) == 0)
+			*unit = UNIT_PT;
+		else if (strncasecmp(ptr, "pc", 2) == 0)
+			*unit = UNIT_PC;
+		else
+			return CSS_INVALID;
+	} else if (len == 1) {
+		if (strncasecmp(ptr, "s", 1) == 0)
+			*unit = UNIT_S;
+		else
+			return CSS_INVALID;
+	} else
+		return CSS_INVALID;
+
+	return CSS_OK;
+}
@@ -39,6 +39,9 @@ css_fixed css__number_from_lwc_string(lwc_string *string, bool int_only,
 css_fixed css__number_from_string(const uint8_t *data, size_t len,
 		bool int_only, size_t *consumed);
 
+css_error css__parse_unit_keyword(const char *ptr, size_t len, 
+		uint32_t *unit);
+
 static inline bool isDigit(uint8_t c)
 {
 	return '0' <= c && c <= '9';
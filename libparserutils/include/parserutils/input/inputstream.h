@@ -57,16 +57,31 @@ parserutils_error parserutils_inputstream_destroy(
 parserutils_error parserutils_inputstream_append(
 		parserutils_inputstream *stream,
 		const uint8_t *data, size_t len);
+/* Append data to an input stream without copying it */
+parserutils_error parserutils_inputstream_append_borrowed(
+		parserutils_inputstream *stream,
+		const uint8_t *data, size_t len);
+/* Copy any borrowed data the input stream has yet to consume */
+parserutils_error parserutils_inputstream_release(
+		parserutils_inputstream *stream);
 /* Insert data into stream at current location */
 parserutils_error parserutils_inputstream_insert(
 		parserutils_inputstream *stream,
 		const uint8_t *data, size_t len);
+/* Limit the size of an input stream's buffer */
+parserutils_error parserutils_inputstream_set_limit(
+		parserutils_inputstream *stream, size_t limit);
 
 /* Slow form of css_inputstream_peek. */
 parserutils_error parserutils_inputstream_peek_slow(
 		parserutils_inputstream *stream, 
 		size_t offset, const uint8_t **ptr, size_t *length);
 
+/* Slow form of parserutils_inputstream_peek_span. */
+parserutils_error parserutils_inputstream_peek_span_slow(
+		parserutils_inputstream *stream,
+		size_t offset, const uint8_t **ptr, size_t *length);
+
 /**
  * Look at the character in the stream that starts at 
  * offset bytes from the cursor
@@ -142,6 +157,46 @@ static inline parserutils_error parserutils_inputstream_peek(
 	return parserutils_inputstream_peek_slow(stream, offset, ptr, length);
 }
 
+/**
+ * Look at the run of decoded data in the stream that starts at
+ * offset bytes from the cursor
+ *
+ * \param stream  Stream to look in
+ * \param offset  Byte offset of start of run
+ * \param ptr     Pointer to location to receive pointer to run data
+ * \param length  Pointer to location to receive run length (in bytes)
+ * \return As for parserutils_inputstream_peek
+ *
+ * The run is the data that is contiguous in the stream's UTF-8 buffer,
+ * starting at offset. It contains at least one character and ends on a
+ * character boundary, so callers may scan it a byte at a time rather than
+ * peeking each character in turn. The same validity rules as for
+ * parserutils_inputstream_peek apply to the returned pointer.
+ */
+static inline parserutils_error parserutils_inputstream_peek_span(
+		parserutils_inputstream *stream, size_t offset, 
+		const uint8_t **ptr, size_t *length)
+{
+	const parserutils_buffer *utf8;
+	size_t off;
+
+	if (stream == NULL || ptr == NULL || length == NULL)
+		return PARSERUTILS_BADPARM;
+
+	utf8 = stream->utf8;
+	off = stream->cursor + offset;
+
+	/* Early exit if the buffer ends with an ASCII character */
+	if (off < utf8->length && (utf8->data[utf8->length - 1] & 0x80) == 0) {
+		(*length) = utf8->length - off;
+		(*ptr) = (utf8->data + off);
+		return PARSERUTILS_OK;
+	}
+
+	return parserutils_inputstream_peek_span_slow(stream, offset, 
+			ptr, length);
+}
+
 /**
  * Advance the stream's current position
  *
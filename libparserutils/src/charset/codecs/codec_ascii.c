@@ -6,6 +6,7 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -61,6 +62,11 @@ static inline parserutils_error charset_ascii_from_ucs4(charset_ascii_codec *c,
 		uint32_t ucs4, uint8_t **s, size_t *len);
 static inline parserutils_error charset_ascii_to_ucs4(charset_ascii_codec *c,
 		const uint8_t *s, size_t len, uint32_t *ucs4);
+static void ascii_mibenum_initialise(void);
+
+/** MIB enum of US-ASCII */
+static uint16_t ascii_mibenum;
+static pthread_once_t ascii_mibenum_once = PTHREAD_ONCE_INIT;
 
 /**
  * Determine whether this codec handles a specific charset
@@ -70,21 +76,26 @@ static inline parserutils_error charset_ascii_to_ucs4(charset_ascii_codec *c,
  */
 bool charset_ascii_codec_handles_charset(const char *charset)
 {
-	static uint16_t ascii;
 	uint16_t match = parserutils_charset_mibenum_from_name(charset,
 			strlen(charset));
 
-	if (ascii == 0) {
-		ascii = parserutils_charset_mibenum_from_name(
-				"US-ASCII", SLEN("US-ASCII"));
-	}
+	pthread_once(&ascii_mibenum_once, ascii_mibenum_initialise);
 
-	if (ascii != 0 && ascii == match)
+	if (ascii_mibenum != 0 && ascii_mibenum == match)
 		return true;
 
 	return false;
 }
 
+/**
+ * Look up the MIB enum of US-ASCII
+ */
+void ascii_mibenum_initialise(void)
+{
+	ascii_mibenum = parserutils_charset_mibenum_from_name(
+			"US-ASCII", SLEN("US-ASCII"));
+}
+
 /**
  * Create a US-ASCII codec
  *
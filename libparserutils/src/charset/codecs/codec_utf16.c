@@ -22,6 +22,11 @@
 typedef struct charset_utf16_codec {
 	parserutils_charset_codec base;	/**< Base class */
 
+	uint8_t lsb;			/**< Offset of the least significant
+					 * byte in each code unit */
+	bool swap;			/**< Whether code units are in the
+					 * opposite byte order to the host */
+
 #define INVAL_BUFSIZE (32)
 	uint8_t inval_buf[INVAL_BUFSIZE];	/**< Buffer for fixing up
 						 * incomplete input
@@ -57,6 +62,11 @@ static parserutils_error charset_utf16_codec_decode(
 		uint8_t **dest, size_t *destlen);
 static parserutils_error charset_utf16_codec_reset(
 		parserutils_charset_codec *codec);
+static inline void charset_utf16_codec_swap(const uint8_t *source,
+		size_t len, uint8_t *dest);
+static inline void charset_utf16_codec_read_ascii(charset_utf16_codec *c,
+		const uint8_t **source, size_t *sourcelen,
+		uint8_t **dest, size_t *destlen);
 static inline parserutils_error charset_utf16_codec_read_char(
 		charset_utf16_codec *c,
 		const uint8_t **source, size_t *sourcelen,
@@ -73,9 +83,15 @@ static inline parserutils_error charset_utf16_codec_output_decoded_char(
  */
 bool charset_utf16_codec_handles_charset(const char *charset)
 {
-	return parserutils_charset_mibenum_from_name(charset, strlen(charset))
-		==
-		parserutils_charset_mibenum_from_name("UTF-16", SLEN("UTF-16"));
+	uint16_t match = parserutils_charset_mibenum_from_name(charset, 
+			strlen(charset));
+
+	return match == parserutils_charset_mibenum_from_name("UTF-16",
+				SLEN("UTF-16")) ||
+		match == parserutils_charset_mibenum_from_name("UTF-16BE",
+				SLEN("UTF-16BE")) ||
+		match == parserutils_charset_mibenum_from_name("UTF-16LE",
+				SLEN("UTF-16LE"));
 }
 
 /**
@@ -91,13 +107,26 @@ parserutils_error charset_utf16_codec_create(const char *charset,
 		parserutils_charset_codec **codec)
 {
 	charset_utf16_codec *c;
-
-	UNUSED(charset);
+	uint16_t mibenum;
 
 	c = malloc(sizeof(charset_utf16_codec));
 	if (c == NULL)
 		return PARSERUTILS_NOMEM;
 
+	/* UTF-16 without a specified byte order is read in host order */
+	mibenum = parserutils_charset_mibenum_from_name(charset, 
+			strlen(charset));
+	if (mibenum == parserutils_charset_mibenum_from_name("UTF-16BE", 
+			SLEN("UTF-16BE")))
+		c->lsb = 1;
+	else if (mibenum == parserutils_charset_mibenum_from_name("UTF-16LE",
+			SLEN("UTF-16LE")))
+		c->lsb = 0;
+	else
+		c->lsb = endian_host_is_le() ? 0 : 1;
+
+	c->swap = (c->lsb == 0) != endian_host_is_le();
+
 	c->inval_buf[0] = '\0';
 	c->inval_len = 0;
 
@@ -179,6 +208,9 @@ parserutils_error charset_utf16_codec_encode(parserutils_charset_codec *codec,
 					pwrite[0], buf, &len);
 			assert(error == PARSERUTILS_OK);
 
+			if (c->swap)
+				charset_utf16_codec_swap(buf, len, buf);
+
 			if (*destlen < len) {
 				/* Insufficient output buffer space */
 				for (len = 0; len < c->write_len; len++)
@@ -213,6 +245,9 @@ parserutils_error charset_utf16_codec_encode(parserutils_charset_codec *codec,
 			if (error != PARSERUTILS_OK)
 				return error;
 
+			if (c->swap)
+				charset_utf16_codec_swap(buf, len, buf);
+
 			if (*destlen < len) {
 				/* Insufficient output space */
 				assert(towritelen < WRITE_BUFSIZE);
@@ -361,6 +396,11 @@ parserutils_error charset_utf16_codec_decode(parserutils_charset_codec *codec,
 
 	/* Finally, the "normal" case; process all outstanding characters */
 	while (*sourcelen > 0) {
+		charset_utf16_codec_read_ascii(c, 
+				source, sourcelen, dest, destlen);
+		if (*sourcelen == 0)
+			break;
+
 		error = charset_utf16_codec_read_char(c,
 				source, sourcelen, dest, destlen);
 		if (error != PARSERUTILS_OK) {
@@ -393,6 +433,59 @@ parserutils_error charset_utf16_codec_reset(parserutils_charset_codec *codec)
 	return PARSERUTILS_OK;
 }
 
+/**
+ * Byte swap a sequence of UTF-16 code units
+ *
+ * \param source  Pointer to code units
+ * \param len     Length, in bytes, of code units (any odd byte is ignored)
+ * \param dest    Pointer to output buffer, which may be source
+ */
+void charset_utf16_codec_swap(const uint8_t *source, size_t len,
+		uint8_t *dest)
+{
+	size_t i;
+
+	for (i = 0; i + 1 < len; i += 2) {
+		uint8_t t = source[i];
+
+		dest[i] = source[i + 1];
+		dest[i + 1] = t;
+	}
+}
+
+/**
+ * Read a run of ASCII characters from UTF-16 to UCS-4 (big endian)
+ *
+ * \param c          The codec
+ * \param source     Pointer to pointer to source buffer (updated on exit)
+ * \param sourcelen  Pointer to length of source buffer (updated on exit)
+ * \param dest       Pointer to pointer to output buffer (updated on exit)
+ * \param destlen    Pointer to length of output buffer (updated on exit)
+ *
+ * Reading stops at the first other character, or when the output is full.
+ */
+void charset_utf16_codec_read_ascii(charset_utf16_codec *c,
+		const uint8_t **source, size_t *sourcelen,
+		uint8_t **dest, size_t *destlen)
+{
+	const uint8_t *s = *source;
+	uint8_t *d = *dest;
+	size_t n = min(*sourcelen / 2, *destlen / 4);
+
+	while (n > 0 && s[1 - c->lsb] == 0 && s[c->lsb] < 0x80) {
+		d[0] = d[1] = d[2] = 0;
+		d[3] = s[c->lsb];
+
+		s += 2;
+		d += 4;
+		n--;
+	}
+
+	*sourcelen -= s - *source;
+	*destlen -= d - *dest;
+	*source = s;
+	*dest = d;
+}
 
 /**
  * Read a character from the UTF-16 to UCS-4 (big endian)
@@ -431,8 +524,18 @@ parserutils_error charset_utf16_codec_read_char(charset_utf16_codec *c,
 	parserutils_error error;
 
 	/* Convert a single character */
-	error = parserutils_charset_utf16_to_ucs4(*source, *sourcelen,
-			&ucs4, &sucs4);
+	if (c->swap) {
+		uint8_t buf[4];
+		size_t len = min(*sourcelen, sizeof(buf));
+
+		charset_utf16_codec_swap(*source, len, buf);
+
+		error = parserutils_charset_utf16_to_ucs4(buf, len,
+				&ucs4, &sucs4);
+	} else {
+		error = parserutils_charset_utf16_to_ucs4(*source, *sourcelen,
+				&ucs4, &sucs4);
+	}
 	if (error == PARSERUTILS_OK) {
 		/* Read a character */
 		error = charset_utf16_codec_output_decoded_char(c,
@@ -475,29 +578,9 @@ parserutils_error charset_utf16_codec_read_char(charset_utf16_codec *c,
 			return PARSERUTILS_INVALID;
 		}
 
-		/* Find next valid UTF-16 sequence.
-		 * We're processing client-provided data, so let's
-		 * be paranoid about its validity. */
-		error = parserutils_charset_utf16_next_paranoid(
-				*source, *sourcelen, 0, &nextchar);
-		if (error != PARSERUTILS_OK) {
-			if (error == PARSERUTILS_NEEDDATA) {
-				/* Need more data to be sure */
-				if (*sourcelen >= INVAL_BUFSIZE)
-					return  PARSERUTILS_INVALID;
-
-				memmove(c->inval_buf, *source, *sourcelen);
-				c->inval_buf[*sourcelen] = '\0';
-				c->inval_len = *sourcelen;
-
-				*source += *sourcelen;
-				*sourcelen = 0;
-
-				nextchar = 0;
-			} else {
-				return error;
-			}
-		}
+		/* The only illegal sequences are unpaired surrogates, so
+		 * the next sequence starts with the next code unit. */
+		nextchar = 2;
 
 		/* output U+FFFD and continue processing. */
 		error = charset_utf16_codec_output_decoded_char(c,
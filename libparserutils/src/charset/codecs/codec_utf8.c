@@ -57,6 +57,8 @@ static parserutils_error charset_utf8_codec_decode(
 		uint8_t **dest, size_t *destlen);
 static parserutils_error charset_utf8_codec_reset(
 		parserutils_charset_codec *codec);
+static inline void charset_utf8_codec_widen_ascii(const uint8_t *source,
+		size_t len, uint8_t *dest);
 static inline parserutils_error charset_utf8_codec_read_char(
 		charset_utf8_codec *c,
 		const uint8_t **source, size_t *sourcelen,
@@ -196,6 +198,17 @@ parserutils_error charset_utf8_codec_encode(parserutils_charset_codec *codec,
 	/* Now process the characters for this call */
 	while (*sourcelen > 0) {
 		ucs4 = endian_big_to_host(*((uint32_t *) (void *) *source));
+
+		/* ASCII is its own encoding */
+		if (ucs4 < 0x80 && *destlen > 0) {
+			*(*dest)++ = ucs4;
+			*destlen -= 1;
+
+			*source += 4;
+			*sourcelen -= 4;
+			continue;
+		}
+
 		towrite = &ucs4;
 		towritelen = 1;
 
@@ -349,6 +362,21 @@ parserutils_error charset_utf8_codec_decode(parserutils_charset_codec *codec,
 
 	/* Finally, the "normal" case; process all outstanding characters */
 	while (*sourcelen > 0) {
+		size_t ascii, space = min(*sourcelen, *destlen / 4);
+
+		/* Runs of ASCII need no validation, so are output in bulk,
+		 * as far as there's space for them */
+		UTF8_ASCII_LENGTH(*source, space, ascii);
+		if (ascii > 0) {
+			charset_utf8_codec_widen_ascii(*source, ascii, *dest);
+
+			*source += ascii;
+			*sourcelen -= ascii;
+			*dest += ascii * 4;
+			*destlen -= ascii * 4;
+			continue;
+		}
+
 		error = charset_utf8_codec_read_char(c,
 				source, sourcelen, dest, destlen);
 		if (error != PARSERUTILS_OK) {
@@ -381,6 +409,42 @@ parserutils_error charset_utf8_codec_reset(parserutils_charset_codec *codec)
 	return PARSERUTILS_OK;
 }
 
+/**
+ * Write a run of ASCII characters as UCS-4 (big endian)
+ *
+ * \param source  Pointer to ASCII characters
+ * \param len     Number of characters
+ * \param dest    Pointer to output buffer, which must hold len * 4 bytes
+ */
+void charset_utf8_codec_widen_ascii(const uint8_t *source, size_t len,
+		uint8_t *dest)
+{
+#ifdef UTF8_ASCII_SSE2
+	const __m128i zero = _mm_setzero_si128();
+
+	/* Interleaving each byte with zeros twice over leaves it in the 
+	 * least significant byte of a big endian word */
+	for (; len >= 16; len -= 16, source += 16, dest += 64) {
+		__m128i v = _mm_loadu_si128((const __m128i *) source);
+		__m128i lo = _mm_unpacklo_epi8(zero, v);
+		__m128i hi = _mm_unpackhi_epi8(zero, v);
+
+		_mm_storeu_si128((__m128i *) dest, 
+				_mm_unpacklo_epi16(zero, lo));
+		_mm_storeu_si128((__m128i *) (dest + 16), 
+				_mm_unpackhi_epi16(zero, lo));
+		_mm_storeu_si128((__m128i *) (dest + 32), 
+				_mm_unpacklo_epi16(zero, hi));
+		_mm_storeu_si128((__m128i *) (dest + 48), 
+				_mm_unpackhi_epi16(zero, hi));
+	}
+#endif
+
+	for (; len > 0; len--, source++, dest += 4) {
+		dest[0] = dest[1] = dest[2] = 0;
+		dest[3] = source[0];
+	}
+}
 
 /**
  * Read a character from the UTF-8 to UCS-4 (big endian)
@@ -419,7 +483,11 @@ parserutils_error charset_utf8_codec_read_char(charset_utf8_codec *c,
 	parserutils_error error;
 
 	/* Convert a single character */
-	{
+	if ((*source)[0] < 0x80) {
+		ucs4 = (*source)[0];
+		sucs4 = 1;
+		error = PARSERUTILS_OK;
+	} else {
 		const uint8_t *src = *source;
 		size_t srclen = *sourcelen;
 		uint32_t *uptr = &ucs4;
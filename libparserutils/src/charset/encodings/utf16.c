@@ -79,7 +79,7 @@ parserutils_error parserutils_charset_utf16_from_ucs4(uint32_t ucs4, uint8_t *s,
 		*ss = (uint16_t) ucs4;
 		l = 2;
 	} else if (ucs4 < 0x110000) {
-		ss[0] = 0xD800 | (((ucs4 >> 16) & 0x1f) - 1) | (ucs4 >> 10);
+		ss[0] = 0xD800 | ((ucs4 - 0x10000) >> 10);
 		ss[1] = 0xDC00 | (ucs4 & 0x3ff);
 		l = 4;
 	} else {
@@ -173,3 +173,51 @@ parserutils_error parserutils_charset_utf8_next_paranoid(const uint8_t *s,
 	return error;
 }
 
+
+/**
+ * Find the length of the valid UTF-8 at the start of a string
+ *
+ * \param s      The string
+ * \param len    Length, in bytes, of the string
+ * \param valid  Pointer to location to receive length of valid prefix
+ * \return PARSERUTILS_OK on success, appropriate error otherwise
+ *
+ * A sequence is valid if parserutils_charset_utf8_to_ucs4 accepts it, so
+ * the valid prefix is exactly the data that decoding and re-encoding as
+ * UTF-8 would leave unchanged. The prefix never ends part way through a
+ * character.
+ */
+parserutils_error parserutils_charset_utf8_validate(const uint8_t *s,
+		size_t len, size_t *valid)
+{
+	size_t off = 0;
+
+	if (s == NULL || valid == NULL)
+		return PARSERUTILS_BADPARM;
+
+	while (off < len) {
+		parserutils_error error;
+		const uint8_t *src = s + off;
+		size_t srclen = len - off, clen;
+		uint32_t ucs4;
+		uint32_t *uptr = &ucs4;
+		size_t *cptr = &clen;
+
+		/* Skip runs of ASCII in bulk */
+		UTF8_ASCII_LENGTH(src, srclen, clen);
+		if (clen > 0) {
+			off += clen;
+			continue;
+		}
+
+		UTF8_TO_UCS4(src, srclen, uptr, cptr, error);
+		if (error != PARSERUTILS_OK)
+			break;
+
+		off += clen;
+	}
+
+	*valid = off;
+
+	return PARSERUTILS_OK;
+}
@@ -16,9 +16,63 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#define UTF8_ASCII_SSE2
+#endif
+
 /** Number of continuation bytes for a given start byte */
 extern const uint8_t numContinuations[256];
 
+/* Advance alen over whole blocks of ASCII in s: 16 bytes at a time using
+ * SSE2 where it is available, or a 64bit word at a time otherwise. */
+#ifdef UTF8_ASCII_SSE2
+#define UTF8_ASCII_BLOCK(s, len, alen)					\
+do {									\
+	while ((len) - alen >= 16) {					\
+		int mask = _mm_movemask_epi8(_mm_loadu_si128(		\
+				(const __m128i *) ((s) + alen)));	\
+									\
+		if (mask != 0) {					\
+			alen += __builtin_ctz(mask);			\
+			break;						\
+		}							\
+									\
+		alen += 16;						\
+	}								\
+} while(0)
+#else
+#define UTF8_ASCII_BLOCK(s, len, alen)					\
+do {									\
+	while ((len) - alen >= sizeof(uint64_t)) {			\
+		uint64_t w;						\
+									\
+		memcpy(&w, (s) + alen, sizeof(w));			\
+		if ((w & UINT64_C(0x8080808080808080)) != 0)		\
+			break;						\
+									\
+		alen += sizeof(w);					\
+	}								\
+} while(0)
+#endif
+
+/**
+ * Find the length of the run of ASCII at the start of a string
+ *
+ * \param s     The string to process
+ * \param len   Length, in bytes, of string
+ * \param alen  Location to receive byte length of ASCII run
+ */
+#define UTF8_ASCII_LENGTH(s, len, alen)					\
+do {									\
+	alen = 0;							\
+									\
+	UTF8_ASCII_BLOCK(s, len, alen);					\
+									\
+	while (alen < (len) && (s)[alen] < 0x80)			\
+		alen++;							\
+} while(0)
+
 /**
  * Convert a UTF-8 multibyte sequence into a single UCS-4 character
  *
@@ -19,15 +19,24 @@
 #include "../../include/parserutils/charset/mibenum.h"
 #include "../../include/parserutils/charset/codec.h"
 
+#include "../charset/encodings/utf8impl.h"
 #include "../input/filter.h"
 #include "../utils/utils.h"
 
+/** Output for a byte of input in a single-byte charset */
+typedef struct filter_sbcs_char {
+	uint8_t len;			/**< Byte length of output */
+	uint8_t data[3];		/**< Output */
+} filter_sbcs_char;
+
 /** Input filter */
 struct parserutils_filter {
 #ifndef WITHOUT_ICONV_FILTER
-	iconv_t cd;			/**< Iconv conversion descriptor */
+	iconv_t cd;			/**< Iconv conversion descriptor, 
+					 * used only for charsets which no
+					 * codec handles */
 	uint16_t int_enc;		/**< The internal encoding */
-#else
+#endif
 	parserutils_charset_codec *read_codec;	/**< Read codec */
 	parserutils_charset_codec *write_codec;	/**< Write codec */
 
@@ -36,7 +45,11 @@ struct parserutils_filter {
 	bool leftover;			/**< Data remains from last call */
 	uint8_t *pivot_left;		/**< Remaining pivot to write */
 	size_t pivot_len;		/**< Length of pivot remaining */
-#endif
+
+	bool sbcs;			/**< Whether the input charset is a 
+					 * single-byte charset, converted
+					 * using sbcs_table */
+	filter_sbcs_char sbcs_table[256];	/**< Output for each byte */
 
 	struct {
 		uint16_t encoding;	/**< Input encoding */
@@ -46,6 +59,10 @@ struct parserutils_filter {
 static parserutils_error filter_set_defaults(parserutils_filter *input);
 static parserutils_error filter_set_encoding(parserutils_filter *input,
 		const char *enc);
+static void filter_detect_sbcs(parserutils_filter *input);
+static parserutils_error filter_sbcs_process_chunk(parserutils_filter *input,
+		const uint8_t **data, size_t *len,
+		uint8_t **output, size_t *outlen);
 
 /**
  * Create an input filter
@@ -78,29 +95,23 @@ parserutils_error parserutils__filter_create(const char *int_enc,
 		free(f);
 		return PARSERUTILS_BADENCODING;
 	}
-#else
+#endif
 	f->leftover = false;
 	f->pivot_left = NULL;
 	f->pivot_len = 0;
-#endif
 
-	error = filter_set_defaults(f);
+	error = parserutils_charset_codec_create(int_enc, &f->write_codec);
 	if (error != PARSERUTILS_OK) {
 		free(f);
 		return error;
 	}
 
-#ifdef WITHOUT_ICONV_FILTER
-	error = parserutils_charset_codec_create(int_enc, &f->write_codec);
+	error = filter_set_defaults(f);
 	if (error != PARSERUTILS_OK) {
-		if (f->read_codec != NULL) {
-			parserutils_charset_codec_destroy(f->read_codec);
-			f->read_codec = NULL;
-		}
+		parserutils_charset_codec_destroy(f->write_codec);
 		free(f);
 		return error;
 	}
-#endif
 
 	*filter = f;
 
@@ -123,7 +134,8 @@ parserutils_error parserutils__filter_destroy(parserutils_filter *input)
 		iconv_close(input->cd);
 		input->cd = (iconv_t) -1;
 	}
-#else
+#endif
+
 	if (input->read_codec != NULL) {
 		parserutils_charset_codec_destroy(input->read_codec);
 		input->read_codec = NULL;
@@ -133,7 +145,6 @@ parserutils_error parserutils__filter_destroy(parserutils_filter *input)
 		parserutils_charset_codec_destroy(input->write_codec);
 		input->write_codec = NULL;
 	}
-#endif
 
 	free(input);
 
@@ -182,38 +193,20 @@ parserutils_error parserutils__filter_process_chunk(parserutils_filter *input,
 		const uint8_t **data, size_t *len,
 		uint8_t **output, size_t *outlen)
 {
+	parserutils_error read_error = PARSERUTILS_OK;
+
 	if (input == NULL || data == NULL || *data == NULL || len == NULL ||
 			output == NULL || *output == NULL || outlen == NULL)
 		return PARSERUTILS_BADPARM;
 
 #ifndef WITHOUT_ICONV_FILTER
-	if (iconv(input->cd, (void *) data, len, 
-			(char **) output, outlen) == (size_t) -1) {
-		switch (errno) {
-		case E2BIG:
-			return PARSERUTILS_NOMEM;
-		case EILSEQ:
-			if (*outlen < 3)
+	if (input->cd != (iconv_t) -1) {
+		if (iconv(input->cd, (void *) data, len, 
+				(char **) output, outlen) == (size_t) -1) {
+			switch (errno) {
+			case E2BIG:
 				return PARSERUTILS_NOMEM;
-
-			(*output)[0] = 0xef;
-			(*output)[1] = 0xbf;
-			(*output)[2] = 0xbd;
-
-			*output += 3;
-			*outlen -= 3;
-
-			(*data)++;
-			(*len)--;
-
-			while (*len > 0) {
-				size_t ret;
-				
-				ret = iconv(input->cd, (void *) data, len, 
-						(char **) output, outlen);
-				if (ret != (size_t) -1 || errno != EILSEQ)
-					break;
-
+			case EILSEQ:
 				if (*outlen < 3)
 					return PARSERUTILS_NOMEM;
 
@@ -226,15 +219,42 @@ parserutils_error parserutils__filter_process_chunk(parserutils_filter *input,
 
 				(*data)++;
 				(*len)--;
-			}
 
-			return errno == E2BIG ? PARSERUTILS_NOMEM 
-					      : PARSERUTILS_OK;
+				while (*len > 0) {
+					size_t ret;
+				
+					ret = iconv(input->cd, (void *) data, len, 
+							(char **) output, outlen);
+					if (ret != (size_t) -1 || errno != EILSEQ)
+						break;
+
+					if (*outlen < 3)
+						return PARSERUTILS_NOMEM;
+
+					(*output)[0] = 0xef;
+					(*output)[1] = 0xbf;
+					(*output)[2] = 0xbd;
+
+					*output += 3;
+					*outlen -= 3;
+
+					(*data)++;
+					(*len)--;
+				}
+
+				return errno == E2BIG ? PARSERUTILS_NOMEM 
+						      : PARSERUTILS_OK;
+			}
 		}
+
+		return PARSERUTILS_OK;
 	}
+#endif
+
+	if (input->sbcs)
+		return filter_sbcs_process_chunk(input, data, len,
+				output, outlen);
 
-	return PARSERUTILS_OK;
-#else
 	if (input->leftover) {
 		parserutils_error write_error;
 
@@ -257,8 +277,10 @@ parserutils_error parserutils__filter_process_chunk(parserutils_filter *input,
 		input->leftover = false;
 	}
 
-	while (*len > 0) {
-		parserutils_error read_error, write_error;
+	/* A character the read codec holds back for want of pivot space 
+	 * must still be flushed once the input is consumed */
+	while (*len > 0 || read_error == PARSERUTILS_NOMEM) {
+		parserutils_error write_error;
 		size_t pivot_len = sizeof(input->pivot_buf);
 		uint8_t *pivot = (uint8_t *) input->pivot_buf;
 
@@ -291,7 +313,6 @@ parserutils_error parserutils__filter_process_chunk(parserutils_filter *input,
 	}
 
 	return PARSERUTILS_OK;
-#endif
 }
 
 /**
@@ -308,23 +329,26 @@ parserutils_error parserutils__filter_reset(parserutils_filter *input)
 		return PARSERUTILS_BADPARM;
 
 #ifndef WITHOUT_ICONV_FILTER
-	iconv(input->cd, NULL, 0, NULL, 0);
-#else
+	if (input->cd != (iconv_t) -1)
+		iconv(input->cd, NULL, 0, NULL, 0);
+#endif
+
 	/* Clear pivot buffer leftovers */
 	input->pivot_left = NULL;
 	input->pivot_len = 0;
 	input->leftover = false;
 
 	/* Reset read codec */
-	error = parserutils_charset_codec_reset(input->read_codec);
-	if (error != PARSERUTILS_OK)
-		return error;
+	if (input->read_codec != NULL) {
+		error = parserutils_charset_codec_reset(input->read_codec);
+		if (error != PARSERUTILS_OK)
+			return error;
+	}
 
 	/* Reset write codec */
 	error = parserutils_charset_codec_reset(input->write_codec);
 	if (error != PARSERUTILS_OK)
 		return error;
-#endif
 
 	return error;
 }
@@ -342,10 +366,8 @@ parserutils_error filter_set_defaults(parserutils_filter *input)
 	if (input == NULL)
 		return PARSERUTILS_BADPARM;
 
-#ifdef WITHOUT_ICONV_FILTER
 	input->read_codec = NULL;
-	input->write_codec = NULL;
-#endif
+	input->sbcs = false;
 
 	input->settings.encoding = 0;
 	error = filter_set_encoding(input, "UTF-8");
@@ -365,8 +387,12 @@ parserutils_error filter_set_defaults(parserutils_filter *input)
 parserutils_error filter_set_encoding(parserutils_filter *input,
 		const char *enc)
 {
+	parserutils_charset_codec *codec = NULL;
 	parserutils_error error = PARSERUTILS_OK;
 	uint16_t mibenum;
+#ifndef WITHOUT_ICONV_FILTER
+	iconv_t cd = (iconv_t) -1;
+#endif
 
 	if (input == NULL || enc == NULL)
 		return PARSERUTILS_BADPARM;
@@ -379,32 +405,156 @@ parserutils_error filter_set_encoding(parserutils_filter *input,
 	if (input->settings.encoding == mibenum)
 		return PARSERUTILS_OK;
 
+	error = parserutils_charset_codec_create(enc, &codec);
 #ifndef WITHOUT_ICONV_FILTER
-	if (input->cd != (iconv_t) -1) {
-		iconv_close(input->cd);
-		input->cd = (iconv_t) -1;
-	}
+	/* Fall back to iconv for charsets which no codec handles */
+	if (error == PARSERUTILS_BADENCODING) {
+		cd = iconv_open(
+			parserutils_charset_mibenum_to_name(input->int_enc),
+			parserutils_charset_mibenum_to_name(mibenum));
+		if (cd == (iconv_t) -1) {
+			return (errno == EINVAL) ? PARSERUTILS_BADENCODING
+						 : PARSERUTILS_NOMEM;
+		}
 
-	input->cd = iconv_open(
-		parserutils_charset_mibenum_to_name(input->int_enc),
-		parserutils_charset_mibenum_to_name(mibenum));
-	if (input->cd == (iconv_t) -1) {
-		return (errno == EINVAL) ? PARSERUTILS_BADENCODING
-					 : PARSERUTILS_NOMEM;
+		error = PARSERUTILS_OK;
 	}
-#else
-	if (input->read_codec != NULL) {
-		parserutils_charset_codec_destroy(input->read_codec);
-		input->read_codec = NULL;
-	}
-
-	error = parserutils_charset_codec_create(enc, &input->read_codec);
+#endif
 	if (error != PARSERUTILS_OK)
 		return error;
+
+#ifndef WITHOUT_ICONV_FILTER
+	if (input->cd != (iconv_t) -1)
+		iconv_close(input->cd);
+
+	input->cd = cd;
 #endif
 
+	if (input->read_codec != NULL)
+		parserutils_charset_codec_destroy(input->read_codec);
+
+	input->read_codec = codec;
+
+	filter_detect_sbcs(input);
+
 	input->settings.encoding = mibenum;
 
 	return error;
+}
+
+/**
+ * Determine whether an input filter's charset is a single-byte charset
+ *
+ * \param input  Input filter to examine
+ *
+ * Each byte value is converted in turn. If every one is a character by
+ * itself, and ASCII is output unchanged, then the output for each is kept
+ * so that input can be converted by table lookup, without the codecs.
+ */
+void filter_detect_sbcs(parserutils_filter *input)
+{
+	int b;
+
+	input->sbcs = false;
+
+	if (input->read_codec == NULL)
+		return;
+
+	/* Multibyte charsets are soonest ruled out by the top byte values */
+	for (b = 255; b >= 0; b--) {
+		filter_sbcs_char *c = &input->sbcs_table[b];
+		uint8_t byte = b;
+		const uint8_t *in = &byte;
+		size_t inlen = 1;
+		uint32_t ucs4;
+		uint8_t *pivot = (uint8_t *) &ucs4;
+		size_t pivotlen = sizeof(ucs4);
+		uint8_t *out = c->data;
+		size_t outlen = sizeof(c->data);
+		parserutils_error error;
+
+		parserutils_charset_codec_reset(input->read_codec);
+
+		error = parserutils_charset_codec_decode(input->read_codec,
+				&in, &inlen, &pivot, &pivotlen);
+		if (error != PARSERUTILS_OK || inlen != 0 || pivotlen != 0)
+			break;
+
+		in = (const uint8_t *) &ucs4;
+		inlen = sizeof(ucs4);
+
+		error = parserutils_charset_codec_encode(input->write_codec,
+				&in, &inlen, &out, &outlen);
+		if (error != PARSERUTILS_OK)
+			break;
+
+		c->len = sizeof(c->data) - outlen;
+
+		if (b < 0x80 && (c->len != 1 || c->data[0] != b))
+			break;
+	}
+
+	/* Discard any state left by the conversions */
+	parserutils_charset_codec_reset(input->read_codec);
+	parserutils_charset_codec_reset(input->write_codec);
+
+	input->sbcs = (b < 0);
+}
+
+/**
+ * Convert a chunk of data in a single-byte charset
+ *
+ * \param input   Pointer to filter instance
+ * \param data    Pointer to pointer to input buffer
+ * \param len     Pointer to length of input buffer
+ * \param output  Pointer to pointer to output buffer
+ * \param outlen  Pointer to length of output buffer
+ * \return PARSERUTILS_OK on success, 
+ *         PARSERUTILS_NOMEM if the output buffer is full
+ */
+parserutils_error filter_sbcs_process_chunk(parserutils_filter *input,
+		const uint8_t **data, size_t *len,
+		uint8_t **output, size_t *outlen)
+{
+	const uint8_t *in = *data;
+	uint8_t *out = *output;
+	size_t inlen = *len, space = *outlen;
+	parserutils_error error = PARSERUTILS_OK;
+
+	while (inlen > 0) {
+		const filter_sbcs_char *c;
+		size_t ascii, n = min(inlen, space);
+
+		/* ASCII is output unchanged, so runs of it are copied */
+		UTF8_ASCII_LENGTH(in, n, ascii);
+		if (ascii > 0) {
+			memcpy(out, in, ascii);
+
+			in += ascii;
+			inlen -= ascii;
+			out += ascii;
+			space -= ascii;
+			continue;
+		}
 
+		c = &input->sbcs_table[*in];
+		if (space < c->len) {
+			error = PARSERUTILS_NOMEM;
+			break;
+		}
+
+		memcpy(out, c->data, c->len);
+
+		in++;
+		inlen--;
+		out += c->len;
+		space -= c->len;
+	}
+
+	*data = in;
+	*len = inlen;
+	*output = out;
+	*outlen = space;
+
+	return error;
 }
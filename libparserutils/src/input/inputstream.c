@@ -6,6 +6,7 @@
  */
 
 #include <assert.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -23,6 +24,22 @@ typedef struct parserutils_inputstream_private {
 	parserutils_inputstream public;	/**< Public part. Must be first */
 
 	parserutils_buffer *raw;	/**< Buffer containing raw data */
+	size_t raw_read;		/**< Length of data at the start of the
+					 * raw buffer which has been decoded */
+
+	parserutils_buffer *owned;	/**< UTF-8 buffer owned by the stream.
+					 * public.utf8 is either this or
+					 * borrowed */
+	parserutils_buffer borrowed;	/**< View of borrowed UTF-8 data */
+	size_t limit;			/**< Maximum size of the owned buffer,
+					 * or 0 for no limit */
+
+	const uint8_t *borrow;		/**< Borrowed data not yet viewed */
+	size_t borrow_len;		/**< Length of the above, in bytes */
+
+	bool copying;			/**< Whether data has been copied into
+					 * the raw buffer, after which all
+					 * further data must be */
 
 	bool done_first_chunk;		/**< Whether the first chunk has 
 					 * been processed */
@@ -37,8 +54,37 @@ typedef struct parserutils_inputstream_private {
 
 static inline parserutils_error parserutils_inputstream_refill_buffer(
 		parserutils_inputstream_private *stream);
+static inline parserutils_error parserutils_inputstream_detect_charset(
+		parserutils_inputstream_private *stream,
+		const uint8_t *data, size_t len, size_t *bom);
 static inline parserutils_error parserutils_inputstream_strip_bom(
-		uint16_t *mibenum, parserutils_buffer *buffer);
+		uint16_t *mibenum, const uint8_t *data, size_t len, 
+		size_t *bom);
+static inline void parserutils_inputstream_discard_raw(
+		parserutils_inputstream_private *stream, size_t len);
+static parserutils_error parserutils_inputstream_make_space(
+		parserutils_inputstream_private *stream);
+static parserutils_error parserutils_inputstream_view(
+		parserutils_inputstream_private *stream);
+static parserutils_error parserutils_inputstream_unview(
+		parserutils_inputstream_private *stream);
+static parserutils_error parserutils_inputstream_copy_borrowed(
+		parserutils_inputstream_private *stream);
+static void bom_mibenums_initialise(void);
+
+/**
+ * Character sets whose data may start with a BOM
+ */
+static struct {
+	uint16_t utf8;
+	uint16_t utf16;
+	uint16_t utf16be;
+	uint16_t utf16le;
+	uint16_t utf32;
+	uint16_t utf32be;
+	uint16_t utf32le;
+} bom_mibenums;
+static pthread_once_t bom_mibenums_once = PTHREAD_ONCE_INIT;
 
 /**
  * Create an input stream
@@ -76,20 +122,30 @@ parserutils_error parserutils_inputstream_create(const char *enc,
 		return error;
 	}
 
-	error = parserutils_buffer_create(&s->public.utf8);
+	error = parserutils_buffer_create(&s->owned);
 	if (error != PARSERUTILS_OK) {
 		parserutils_buffer_destroy(s->raw);
 		free(s);
 		return error;
 	}
 
+	s->public.utf8 = s->owned;
 	s->public.cursor = 0;
 	s->public.had_eof = false;
+	s->raw_read = 0;
+	s->limit = 0;
 	s->done_first_chunk = false;
 
+	s->borrowed.data = NULL;
+	s->borrowed.length = 0;
+	s->borrowed.allocated = 0;
+	s->borrow = NULL;
+	s->borrow_len = 0;
+	s->copying = false;
+
 	error = parserutils__filter_create("UTF-8", &s->input);
 	if (error != PARSERUTILS_OK) {
-		parserutils_buffer_destroy(s->public.utf8);
+		parserutils_buffer_destroy(s->owned);
 		parserutils_buffer_destroy(s->raw);
 		free(s);
 		return error;
@@ -103,7 +159,7 @@ parserutils_error parserutils_inputstream_create(const char *enc,
 
 		if (s->mibenum == 0) {
 			parserutils__filter_destroy(s->input);
-			parserutils_buffer_destroy(s->public.utf8);
+			parserutils_buffer_destroy(s->owned);
 			parserutils_buffer_destroy(s->raw);
 			free(s);
 			return PARSERUTILS_BADENCODING;
@@ -116,7 +172,7 @@ parserutils_error parserutils_inputstream_create(const char *enc,
 				&params);
 		if (error != PARSERUTILS_OK) {
 			parserutils__filter_destroy(s->input);
-			parserutils_buffer_destroy(s->public.utf8);
+			parserutils_buffer_destroy(s->owned);
 			parserutils_buffer_destroy(s->raw);
 			free(s);
 			return error;
@@ -151,7 +207,7 @@ parserutils_error parserutils_inputstream_destroy(
 		return PARSERUTILS_BADPARM;
 
 	parserutils__filter_destroy(s->input);
-	parserutils_buffer_destroy(s->public.utf8);
+	parserutils_buffer_destroy(s->owned);
 	parserutils_buffer_destroy(s->raw);
 	free(s);
 
@@ -181,9 +237,124 @@ parserutils_error parserutils_inputstream_append(
 		return PARSERUTILS_OK;
 	}
 
+	if (len > 0)
+		s->copying = true;
+
 	return parserutils_buffer_append(s->raw, data, len);
 }
 
+/**
+ * Append data to an input stream without copying it
+ *
+ * \param stream  Input stream to append data to
+ * \param data    Data to append (in document charset), or NULL to flag EOF
+ * \param len     Length, in bytes, of data
+ * \return PARSERUTILS_OK on success, appropriate error otherwise
+ *
+ * If the document charset is UTF-8, the stream reads the valid UTF-8 at the
+ * start of data in place, rather than copying it into its own buffers. Any
+ * remaining data is appended as for parserutils_inputstream_append. The
+ * same happens to all of data if the charset isn't UTF-8, or if data has
+ * been copied into the stream before.
+ *
+ * The client must leave data unmodified and in place until it has all
+ * been consumed, or until it calls parserutils_inputstream_release().
+ */
+parserutils_error parserutils_inputstream_append_borrowed(
+		parserutils_inputstream *stream, 
+		const uint8_t *data, size_t len)
+{
+	parserutils_inputstream_private *s = 
+			(parserutils_inputstream_private *) stream;
+	parserutils_error error;
+	size_t valid;
+
+	if (stream == NULL)
+		return PARSERUTILS_BADPARM;
+
+	if (data == NULL) {
+		s->public.had_eof = true;
+		return PARSERUTILS_OK;
+	}
+
+	/* Data may only be borrowed if there's nothing in the raw buffer or
+	 * the filter that would have to precede it. Before any data has been
+	 * copied, this means the charset must be detected here. */
+	if (s->copying == false && s->done_first_chunk == false) {
+		size_t bom;
+
+		error = parserutils_inputstream_detect_charset(s, 
+				data, len, &bom);
+		if (error != PARSERUTILS_OK && error != PARSERUTILS_NEEDDATA)
+			return error;
+
+		if (error == PARSERUTILS_OK) {
+			data += bom;
+			len -= bom;
+		}
+	}
+
+	if (s->copying || s->done_first_chunk == false || s->mibenum != 
+			parserutils_charset_mibenum_from_name("UTF-8", 
+				SLEN("UTF-8")))
+		return parserutils_inputstream_append(stream, data, len);
+
+	/* Borrowed data must follow any that's already pending */
+	error = parserutils_inputstream_release(stream);
+	if (error != PARSERUTILS_OK)
+		return error;
+
+	error = parserutils_charset_utf8_validate(data, len, &valid);
+	if (error != PARSERUTILS_OK)
+		return error;
+
+	s->borrow = data;
+	s->borrow_len = valid;
+
+	/* Leave invalid or incomplete data to the codec */
+	if (valid < len)
+		return parserutils_inputstream_append(stream, 
+				data + valid, len - valid);
+
+	return PARSERUTILS_OK;
+}
+
+/**
+ * Stop an input stream reading borrowed data in place
+ *
+ * \param stream  Input stream to release borrowed data from
+ * \return PARSERUTILS_OK on success, appropriate error otherwise
+ *
+ * Any borrowed data that the stream has yet to consume is copied into the
+ * stream's own buffer, after which the client may discard it.
+ */
+parserutils_error parserutils_inputstream_release(
+		parserutils_inputstream *stream)
+{
+	parserutils_inputstream_private *s = 
+			(parserutils_inputstream_private *) stream;
+	parserutils_error error;
+
+	if (stream == NULL)
+		return PARSERUTILS_BADPARM;
+
+	error = parserutils_inputstream_unview(s);
+	if (error != PARSERUTILS_OK)
+		return error;
+
+	if (s->borrow_len > 0) {
+		error = parserutils_buffer_append(s->owned, 
+				s->borrow, s->borrow_len);
+		if (error != PARSERUTILS_OK)
+			return error;
+
+		s->borrow = NULL;
+		s->borrow_len = 0;
+	}
+
+	return PARSERUTILS_OK;
+}
+
 /**
  * Insert data into stream at current location
  *
@@ -198,14 +369,45 @@ parserutils_error parserutils_inputstream_insert(
 {
 	parserutils_inputstream_private *s = 
 			(parserutils_inputstream_private *) stream;
+	parserutils_error error;
 
 	if (stream == NULL || data == NULL)
 		return PARSERUTILS_BADPARM;
 
+	error = parserutils_inputstream_unview(s);
+	if (error != PARSERUTILS_OK)
+		return error;
+
 	return parserutils_buffer_insert(s->public.utf8, s->public.cursor, 
 			data, len);
 }
 
+/**
+ * Limit the size of an input stream's buffer of decoded data
+ *
+ * \param stream  Input stream to limit
+ * \param limit   Maximum size of buffer, in bytes, or 0 for no limit
+ * \return PARSERUTILS_OK on success, appropriate error otherwise
+ *
+ * The stream retains the decoded data from the cursor onwards, so the limit
+ * bounds how far the client may peek ahead of the cursor. Beyond that,
+ * peeking fails with PARSERUTILS_NOMEM. The buffer is never shrunk, so a
+ * limit below its current size only prevents it from growing further.
+ */
+parserutils_error parserutils_inputstream_set_limit(
+		parserutils_inputstream *stream, size_t limit)
+{
+	parserutils_inputstream_private *s = 
+			(parserutils_inputstream_private *) stream;
+
+	if (stream == NULL)
+		return PARSERUTILS_BADPARM;
+
+	s->limit = limit;
+
+	return PARSERUTILS_OK;
+}
+
 #define IS_ASCII(x) (((x) & 0x80) == 0)
 
 /**
@@ -242,7 +444,7 @@ parserutils_error parserutils_inputstream_peek_slow(
 		return PARSERUTILS_BADPARM;
 
 	/* There's insufficient data in the buffer, so read some more */
-	if (s->raw->length == 0) {
+	if (s->raw->length == 0 && s->borrow_len == 0) {
 		/* No more data to be had */
 		return s->public.had_eof ? PARSERUTILS_EOF
 					 : PARSERUTILS_NEEDDATA;
@@ -282,6 +484,57 @@ parserutils_error parserutils_inputstream_peek_slow(
 
 #undef IS_ASCII
 
+/**
+ * Look at the run of decoded data in the stream that starts at
+ * offset bytes from the cursor
+ *
+ * \param stream  Stream to look in
+ * \param offset  Byte offset of start of run
+ * \param ptr     Pointer to location to receive pointer to run data
+ * \param length  Pointer to location to receive run length (in bytes)
+ * \return As for parserutils_inputstream_peek
+ *
+ * This is the out-of-line form of parserutils_inputstream_peek_span, used
+ * when the buffer may need refilling or ends with a non-ASCII character.
+ */
+parserutils_error parserutils_inputstream_peek_span_slow(
+		parserutils_inputstream *stream,
+		size_t offset, const uint8_t **ptr, size_t *length)
+{
+	parserutils_error error;
+	const uint8_t *data;
+	size_t clen, span;
+	uint32_t last;
+
+	/* Ensure there's at least one whole character to look at */
+	error = parserutils_inputstream_peek(stream, offset, &data, &clen);
+	if (error != PARSERUTILS_OK)
+		return error;
+
+	span = stream->utf8->length - stream->cursor - offset;
+
+	/* Exclude any incomplete character at the end of the buffer */
+	if (span > clen) {
+		last = span;
+		error = parserutils_charset_utf8_prev(data, last, &last);
+		if (error != PARSERUTILS_OK)
+			return error;
+
+		error = parserutils_charset_utf8_char_byte_length(
+				data + last, &clen);
+		if (error != PARSERUTILS_OK)
+			return error;
+
+		if (last + clen > span)
+			span = last;
+	}
+
+	(*length) = span;
+	(*ptr) = data;
+
+	return PARSERUTILS_OK;
+}
+
 /**
  * Read the source charset of the input stream
  *
@@ -370,98 +623,45 @@ parserutils_error parserutils_inputstream_refill_buffer(
 	size_t raw_length, utf8_space;
 	parserutils_error error;
 
-	/* If this is the first chunk of data, we must detect the charset and
-	 * strip the BOM, if one exists */
-	if (stream->done_first_chunk == false) {
-		parserutils_filter_optparams params;
+	/* Read any borrowed data in place, if the stream has consumed all
+	 * else. Otherwise, it has to be copied after the unconsumed data. */
+	if (stream->borrow_len > 0) {
+		if (stream->public.cursor == stream->public.utf8->length)
+			return parserutils_inputstream_view(stream);
 
-		/* If there is a charset detection routine, give it an 
-		 * opportunity to override any charset specified when the
-		 * inputstream was created */
-		if (stream->csdetect != NULL) {
-			error = stream->csdetect(stream->raw->data, 
-				stream->raw->length,
-				&stream->mibenum, &stream->encsrc);
-			if (error != PARSERUTILS_OK) {
-				if (error != PARSERUTILS_NEEDDATA ||
-						stream->public.had_eof == false)
-					return error;
-
-				/* We don't have enough data to detect the 
-				 * input encoding, but we're not going to get 
-				 * any more as we've been notified of EOF. 
-				 * Therefore, leave the encoding alone
-				 * so that any charset specified when the
-				 * inputstream was created will be preserved.
-				 * If there was no charset specified, then
-				 * we'll default to UTF-8, below */
-			}
-		}
-
-		/* Default to UTF-8 if there is still no encoding information 
-		 * We'll do this if there was no encoding specified up-front
-		 * and:
-		 *    1) there was no charset detection routine
-		 * or 2) there was insufficient data for the charset 
-		 *       detection routine to detect an encoding
-		 */
-		if (stream->mibenum == 0) {
-			stream->mibenum = 
-				parserutils_charset_mibenum_from_name("UTF-8", 
-					SLEN("UTF-8"));
-			stream->encsrc = 0;
-		}
-
-		assert(stream->mibenum != 0);
+		return parserutils_inputstream_copy_borrowed(stream);
+	}
 
-		/* Strip any BOM, and update encoding as appropriate */
-		error = parserutils_inputstream_strip_bom(&stream->mibenum, 
-				stream->raw);
-		if (error != PARSERUTILS_OK)
-			return error;
+	/* Raw data is decoded into the stream's own buffer */
+	error = parserutils_inputstream_unview(stream);
+	if (error != PARSERUTILS_OK)
+		return error;
 
-		/* Ensure filter is using the correct encoding */
-		params.encoding.name = 
-			parserutils_charset_mibenum_to_name(stream->mibenum);
+	/* If this is the first chunk of data, we must detect the charset and
+	 * strip the BOM, if one exists */
+	if (stream->done_first_chunk == false) {
+		size_t bom;
 
-		error = parserutils__filter_setopt(stream->input,
-				PARSERUTILS_FILTER_SET_ENCODING, 
-				&params);
+		error = parserutils_inputstream_detect_charset(stream,
+				stream->raw->data + stream->raw_read,
+				stream->raw->length - stream->raw_read, &bom);
 		if (error != PARSERUTILS_OK)
 			return error;
 
-		stream->done_first_chunk = true;
+		parserutils_inputstream_discard_raw(stream, bom);
 	}
 
-	/* Work out how to perform the buffer fill */
-	if (stream->public.cursor == stream->public.utf8->length) {
-		/* Cursor's at the end, so simply reuse the entire buffer */
-		utf8 = stream->public.utf8->data;
-		utf8_space = stream->public.utf8->allocated;
-	} else {
-		/* Cursor's not at the end, so shift data after cursor to the
-		 * bottom of the buffer. If the buffer's still over half full, 
-		 * extend it. */
-		memmove(stream->public.utf8->data,
-			stream->public.utf8->data + stream->public.cursor,
-			stream->public.utf8->length - stream->public.cursor);
-
-		stream->public.utf8->length -= stream->public.cursor;
-
-		if (stream->public.utf8->length > 
-				stream->public.utf8->allocated / 2) {
-			error = parserutils_buffer_grow(stream->public.utf8);
-			if (error != PARSERUTILS_OK)
-				return error;
-		}
+	/* Make room after the unconsumed data for the buffer fill */
+	error = parserutils_inputstream_make_space(stream);
+	if (error != PARSERUTILS_OK)
+		return error;
 
-		utf8 = stream->public.utf8->data + stream->public.utf8->length;
-		utf8_space = stream->public.utf8->allocated - 
-				stream->public.utf8->length;
-	}
+	utf8 = stream->public.utf8->data + stream->public.utf8->length;
+	utf8_space = stream->public.utf8->allocated - 
+			stream->public.utf8->length;
 
-	raw = stream->raw->data;
-	raw_length = stream->raw->length;
+	raw = stream->raw->data + stream->raw_read;
+	raw_length = stream->raw->length - stream->raw_read;
 
 	/* Try to fill utf8 buffer from the raw data */
 	error = parserutils__filter_process_chunk(stream->input, 
@@ -472,131 +672,394 @@ parserutils_error parserutils_inputstream_refill_buffer(
 		return error;
 
 	/* Remove the raw data we've processed from the raw buffer */
-	error = parserutils_buffer_discard(stream->raw, 0, 
-			stream->raw->length - raw_length);
-	if (error != PARSERUTILS_OK)
-		return error;
+	parserutils_inputstream_discard_raw(stream, 
+			stream->raw->length - stream->raw_read - raw_length);
 
 	/* Fix up the utf8 buffer information */
 	stream->public.utf8->length = 
 			stream->public.utf8->allocated - utf8_space;
 
-	/* Finally, fix up the cursor */
-	stream->public.cursor = 0;
+	return PARSERUTILS_OK;
+}
+
+/**
+ * Discard decoded data from the start of the raw buffer
+ *
+ * \param stream  The inputstream to operate on
+ * \param len     Length, in bytes, of data to discard
+ *
+ * The data is only removed from the buffer once there's at least as much
+ * discarded data as remaining data to move down over it. This keeps the
+ * cost of decoding a large buffer a little at a time linear in its size.
+ */
+void parserutils_inputstream_discard_raw(
+		parserutils_inputstream_private *stream, size_t len)
+{
+	parserutils_buffer *raw = stream->raw;
+
+	stream->raw_read += len;
+
+	if (stream->raw_read == raw->length) {
+		raw->length = 0;
+		stream->raw_read = 0;
+	} else if (stream->raw_read >= raw->length - stream->raw_read) {
+		memmove(raw->data, raw->data + stream->raw_read,
+				raw->length - stream->raw_read);
+		raw->length -= stream->raw_read;
+		stream->raw_read = 0;
+	}
+}
+
+/**
+ * Make space at the end of the stream's own buffer
+ *
+ * \param stream  The inputstream to operate on
+ * \return PARSERUTILS_OK on success,
+ *         PARSERUTILS_NOMEM if the buffer is full and may not be extended,
+ *                           or on memory exhaustion
+ *
+ * The unconsumed data after the cursor is moved to the bottom of the buffer
+ * when there's at least as much consumed data before it. Otherwise it's
+ * left in place, so the cost of moving it is bounded by the data consumed.
+ * If the buffer's still over half full, it's extended.
+ */
+parserutils_error parserutils_inputstream_make_space(
+		parserutils_inputstream_private *stream)
+{
+	parserutils_buffer *utf8 = stream->public.utf8;
+	size_t cursor = stream->public.cursor;
+	size_t unconsumed = utf8->length - cursor;
+
+	if (cursor > 0 && (cursor >= unconsumed || 
+			(utf8->length > utf8->allocated / 2 && 
+			stream->limit != 0 && 
+			utf8->allocated * 2 > stream->limit))) {
+		/* Either cheap, or the only way to find space */
+		memmove(utf8->data, utf8->data + cursor, unconsumed);
+		utf8->length = unconsumed;
+		stream->public.cursor = 0;
+	}
+
+	if (utf8->length > utf8->allocated / 2 && (stream->limit == 0 || 
+			utf8->allocated * 2 <= stream->limit))
+		return parserutils_buffer_grow(utf8);
+
+	/* Ensure there's space for the longest UTF-8 sequence */
+	if (utf8->allocated - utf8->length < 4)
+		return PARSERUTILS_NOMEM;
 
 	return PARSERUTILS_OK;
 }
 
 /**
- * Strip a BOM from a buffer in the given encoding
+ * Detect the charset of the first chunk of data, and configure the filter
  *
- * \param mibenum  Pointer to the character set of the buffer, updated on exit
- * \param buffer   The buffer to process
+ * \param stream  The inputstream to configure
+ * \param data    The first chunk of data, in the document charset
+ * \param len     Length, in bytes, of data
+ * \param bom     Pointer to location to receive length of any BOM in data
+ * \return PARSERUTILS_OK on success, appropriate error otherwise
  */
-parserutils_error parserutils_inputstream_strip_bom(uint16_t *mibenum, 
-		parserutils_buffer *buffer)
+parserutils_error parserutils_inputstream_detect_charset(
+		parserutils_inputstream_private *stream,
+		const uint8_t *data, size_t len, size_t *bom)
 {
-	static uint16_t utf8;
-	static uint16_t utf16;
-	static uint16_t utf16be;
-	static uint16_t utf16le;
-	static uint16_t utf32;
-	static uint16_t utf32be;
-	static uint16_t utf32le;
-
-	if (utf8 == 0) {
-		utf8 = parserutils_charset_mibenum_from_name("UTF-8", 
+	parserutils_filter_optparams params;
+	parserutils_error error;
+
+	/* If there is a charset detection routine, give it an 
+	 * opportunity to override any charset specified when the
+	 * inputstream was created */
+	if (stream->csdetect != NULL) {
+		error = stream->csdetect(data, len, 
+				&stream->mibenum, &stream->encsrc);
+		if (error != PARSERUTILS_OK) {
+			if (error != PARSERUTILS_NEEDDATA ||
+					stream->public.had_eof == false)
+				return error;
+
+			/* We don't have enough data to detect the 
+			 * input encoding, but we're not going to get 
+			 * any more as we've been notified of EOF. 
+			 * Therefore, leave the encoding alone
+			 * so that any charset specified when the
+			 * inputstream was created will be preserved.
+			 * If there was no charset specified, then
+			 * we'll default to UTF-8, below */
+		}
+	}
+
+	/* Default to UTF-8 if there is still no encoding information 
+	 * We'll do this if there was no encoding specified up-front
+	 * and:
+	 *    1) there was no charset detection routine
+	 * or 2) there was insufficient data for the charset 
+	 *       detection routine to detect an encoding
+	 */
+	if (stream->mibenum == 0) {
+		stream->mibenum = 
+			parserutils_charset_mibenum_from_name("UTF-8", 
 				SLEN("UTF-8"));
-		utf16 = parserutils_charset_mibenum_from_name("UTF-16", 
-				SLEN("UTF-16"));
-		utf16be = parserutils_charset_mibenum_from_name("UTF-16BE",
-				SLEN("UTF-16BE"));
-		utf16le = parserutils_charset_mibenum_from_name("UTF-16LE",
-				SLEN("UTF-16LE"));
-		utf32 = parserutils_charset_mibenum_from_name("UTF-32", 
-				SLEN("UTF-32"));
-		utf32be = parserutils_charset_mibenum_from_name("UTF-32BE",
-				SLEN("UTF-32BE"));
-		utf32le = parserutils_charset_mibenum_from_name("UTF-32LE",
-				SLEN("UTF-32LE"));
+		stream->encsrc = 0;
+	}
+
+	assert(stream->mibenum != 0);
+
+	/* Find any BOM, and update encoding as appropriate */
+	error = parserutils_inputstream_strip_bom(&stream->mibenum, 
+			data, len, bom);
+	if (error != PARSERUTILS_OK)
+		return error;
+
+	/* Ensure filter is using the correct encoding */
+	params.encoding.name = 
+		parserutils_charset_mibenum_to_name(stream->mibenum);
+
+	error = parserutils__filter_setopt(stream->input,
+			PARSERUTILS_FILTER_SET_ENCODING, 
+			&params);
+	if (error != PARSERUTILS_OK)
+		return error;
+
+	stream->done_first_chunk = true;
+
+	return PARSERUTILS_OK;
+}
+
+/**
+ * Start reading borrowed data in place
+ *
+ * \param stream  The inputstream to update
+ * \return PARSERUTILS_OK
+ *
+ * \pre All data in the stream's own buffer has been consumed
+ */
+parserutils_error parserutils_inputstream_view(
+		parserutils_inputstream_private *stream)
+{
+	stream->borrowed.data = (uint8_t *) stream->borrow;
+	stream->borrowed.length = stream->borrow_len;
+	stream->borrowed.allocated = stream->borrow_len;
+
+	stream->public.utf8 = &stream->borrowed;
+	stream->public.cursor = 0;
+
+	stream->borrow = NULL;
+	stream->borrow_len = 0;
+
+	return PARSERUTILS_OK;
+}
+
+/**
+ * Stop reading borrowed data in place
+ *
+ * \param stream  The inputstream to update
+ * \return PARSERUTILS_OK on success, appropriate error otherwise
+ *
+ * Any unconsumed data in the view is copied into the stream's own buffer.
+ */
+parserutils_error parserutils_inputstream_unview(
+		parserutils_inputstream_private *stream)
+{
+	parserutils_error error;
+
+	if (stream->public.utf8 != &stream->borrowed)
+		return PARSERUTILS_OK;
+
+	stream->owned->length = 0;
+
+	error = parserutils_buffer_append(stream->owned,
+			stream->borrowed.data + stream->public.cursor,
+			stream->borrowed.length - stream->public.cursor);
+	if (error != PARSERUTILS_OK)
+		return error;
+
+	stream->public.utf8 = stream->owned;
+	stream->public.cursor = 0;
+
+	stream->borrowed.data = NULL;
+	stream->borrowed.length = 0;
+	stream->borrowed.allocated = 0;
+
+	return PARSERUTILS_OK;
+}
+
+/**
+ * Copy some borrowed data after the unconsumed data in the stream's buffer
+ *
+ * \param stream  The inputstream to refill
+ * \return PARSERUTILS_OK on success, appropriate error otherwise
+ *
+ * Only as much is copied as is needed to read past the unconsumed data, so
+ * that the rest of the borrowed data may then be read in place.
+ */
+parserutils_error parserutils_inputstream_copy_borrowed(
+		parserutils_inputstream_private *stream)
+{
+	parserutils_buffer *utf8;
+	size_t len;
+	parserutils_error error;
+
+	error = parserutils_inputstream_unview(stream);
+	if (error != PARSERUTILS_OK)
+		return error;
+
+	error = parserutils_inputstream_make_space(stream);
+	if (error != PARSERUTILS_OK)
+		return error;
+
+	utf8 = stream->public.utf8;
+
+	/* Copy at least as much again as is unconsumed, so that the next 
+	 * refill can read in place, but not so much that the buffer must 
+	 * grow */
+	len = utf8->length - stream->public.cursor;
+	if (len < 256)
+		len = 256;
+	if (len > utf8->allocated - utf8->length)
+		len = utf8->allocated - utf8->length;
+
+	if (len < stream->borrow_len) {
+		/* Don't split a character. There's space for at least one,
+		 * so this always leaves something to copy. */
+		while ((stream->borrow[len] & 0xC0) == 0x80)
+			len--;
+	} else {
+		len = stream->borrow_len;
 	}
 
+	memcpy(utf8->data + utf8->length, stream->borrow, len);
+	utf8->length += len;
+
+	stream->borrow += len;
+	stream->borrow_len -= len;
+
+	return PARSERUTILS_OK;
+}
+
+/**
+ * Look up the character sets whose data may start with a BOM
+ */
+void bom_mibenums_initialise(void)
+{
+	bom_mibenums.utf8 = parserutils_charset_mibenum_from_name("UTF-8", 
+			SLEN("UTF-8"));
+	bom_mibenums.utf16 = parserutils_charset_mibenum_from_name("UTF-16", 
+			SLEN("UTF-16"));
+	bom_mibenums.utf16be = parserutils_charset_mibenum_from_name(
+			"UTF-16BE", SLEN("UTF-16BE"));
+	bom_mibenums.utf16le = parserutils_charset_mibenum_from_name(
+			"UTF-16LE", SLEN("UTF-16LE"));
+	bom_mibenums.utf32 = parserutils_charset_mibenum_from_name("UTF-32", 
+			SLEN("UTF-32"));
+	bom_mibenums.utf32be = parserutils_charset_mibenum_from_name(
+			"UTF-32BE", SLEN("UTF-32BE"));
+	bom_mibenums.utf32le = parserutils_charset_mibenum_from_name(
+			"UTF-32LE", SLEN("UTF-32LE"));
+}
+
+/**
+ * Find any BOM at the start of data in the given encoding
+ *
+ * \param mibenum  Pointer to the character set of the data, updated on exit
+ * \param data     The data to process
+ * \param len      Length, in bytes, of data
+ * \param bom      Pointer to location to receive length of BOM, or 0 if none
+ */
+parserutils_error parserutils_inputstream_strip_bom(uint16_t *mibenum, 
+		const uint8_t *data, size_t len, size_t *bom)
+{
+	uint16_t utf8, utf16, utf16be, utf16le, utf32, utf32be, utf32le;
+
+	/* Streams may detect their charset on several threads at once */
+	pthread_once(&bom_mibenums_once, bom_mibenums_initialise);
+
+	utf8 = bom_mibenums.utf8;
+	utf16 = bom_mibenums.utf16;
+	utf16be = bom_mibenums.utf16be;
+	utf16le = bom_mibenums.utf16le;
+	utf32 = bom_mibenums.utf32;
+	utf32be = bom_mibenums.utf32be;
+	utf32le = bom_mibenums.utf32le;
+
 #define UTF32_BOM_LEN (4)
 #define UTF16_BOM_LEN (2)
 #define UTF8_BOM_LEN  (3)
 
+	*bom = 0;
+
 	if (*mibenum == utf8) {
-		if (buffer->length >= UTF8_BOM_LEN && 
-				buffer->data[0] == 0xEF &&
-				buffer->data[1] == 0xBB && 
-				buffer->data[2] == 0xBF) {
-			return parserutils_buffer_discard(
-					buffer, 0, UTF8_BOM_LEN);
+		if (len >= UTF8_BOM_LEN && 
+				data[0] == 0xEF &&
+				data[1] == 0xBB && 
+				data[2] == 0xBF) {
+			*bom = UTF8_BOM_LEN;
+			return PARSERUTILS_OK;
 		}
 	} else if (*mibenum == utf16be) {
-		if (buffer->length >= UTF16_BOM_LEN &&
-				buffer->data[0] == 0xFE &&
-				buffer->data[1] == 0xFF) {
-			return parserutils_buffer_discard(
-					buffer, 0, UTF16_BOM_LEN);
+		if (len >= UTF16_BOM_LEN &&
+				data[0] == 0xFE &&
+				data[1] == 0xFF) {
+			*bom = UTF16_BOM_LEN;
+			return PARSERUTILS_OK;
 		}
 	} else if (*mibenum == utf16le) {
-		if (buffer->length >= UTF16_BOM_LEN &&
-				buffer->data[0] == 0xFF &&
-				buffer->data[1] == 0xFE) {
-			return parserutils_buffer_discard(
-					buffer, 0, UTF16_BOM_LEN);
+		if (len >= UTF16_BOM_LEN &&
+				data[0] == 0xFF &&
+				data[1] == 0xFE) {
+			*bom = UTF16_BOM_LEN;
+			return PARSERUTILS_OK;
 		}
 	} else if (*mibenum == utf16) {
 		*mibenum = utf16be;
 
-		if (buffer->length >= UTF16_BOM_LEN) {
-			if (buffer->data[0] == 0xFE && 
-					buffer->data[1] == 0xFF) {
-				return parserutils_buffer_discard(
-						buffer, 0, UTF16_BOM_LEN);
-			} else if (buffer->data[0] == 0xFF && 
-					buffer->data[1] == 0xFE) {
+		if (len >= UTF16_BOM_LEN) {
+			if (data[0] == 0xFE && 
+					data[1] == 0xFF) {
+				*bom = UTF16_BOM_LEN;
+				return PARSERUTILS_OK;
+			} else if (data[0] == 0xFF && 
+					data[1] == 0xFE) {
 				*mibenum = utf16le;
-				return parserutils_buffer_discard(
-						buffer, 0, UTF16_BOM_LEN);
+				*bom = UTF16_BOM_LEN;
+				return PARSERUTILS_OK;
 			}
 		}
 	} else if (*mibenum == utf32be) {
-		if (buffer->length >= UTF32_BOM_LEN &&
-				buffer->data[0] == 0x00 &&
-				buffer->data[1] == 0x00 &&
-				buffer->data[2] == 0xFE &&
-				buffer->data[3] == 0xFF) {
-			return parserutils_buffer_discard(
-					buffer, 0, UTF32_BOM_LEN);
+		if (len >= UTF32_BOM_LEN &&
+				data[0] == 0x00 &&
+				data[1] == 0x00 &&
+				data[2] == 0xFE &&
+				data[3] == 0xFF) {
+			*bom = UTF32_BOM_LEN;
+			return PARSERUTILS_OK;
 		}
 	} else if (*mibenum == utf32le) {
-		if (buffer->length >= UTF32_BOM_LEN &&
-				buffer->data[0] == 0xFF &&
-				buffer->data[1] == 0xFE &&
-				buffer->data[2] == 0x00 &&
-				buffer->data[3] == 0x00) {
-			return parserutils_buffer_discard(
-					buffer, 0, UTF32_BOM_LEN);
+		if (len >= UTF32_BOM_LEN &&
+				data[0] == 0xFF &&
+				data[1] == 0xFE &&
+				data[2] == 0x00 &&
+				data[3] == 0x00) {
+			*bom = UTF32_BOM_LEN;
+			return PARSERUTILS_OK;
 		}
 	} else if (*mibenum == utf32) {
 		*mibenum = utf32be;
 
-		if (buffer->length >= UTF32_BOM_LEN) {
-			if (buffer->data[0] == 0x00 && 
-					buffer->data[1] == 0x00 &&
-					buffer->data[2] == 0xFE &&
-					buffer->data[3] == 0xFF) {
-				return parserutils_buffer_discard(
-						buffer, 0, UTF32_BOM_LEN);
-			} else if (buffer->data[0] == 0xFF && 
-					buffer->data[1] == 0xFE &&
-					buffer->data[2] == 0x00 &&
-					buffer->data[3] == 0x00) {
+		if (len >= UTF32_BOM_LEN) {
+			if (data[0] == 0x00 && 
+					data[1] == 0x00 &&
+					data[2] == 0xFE &&
+					data[3] == 0xFF) {
+				*bom = UTF32_BOM_LEN;
+				return PARSERUTILS_OK;
+			} else if (data[0] == 0xFF && 
+					data[1] == 0xFE &&
+					data[2] == 0x00 &&
+					data[3] == 0x00) {
 				*mibenum = utf32le;
-				return parserutils_buffer_discard(
-						buffer, 0, UTF32_BOM_LEN);
+				*bom = UTF32_BOM_LEN;
+				return PARSERUTILS_OK;
 			}
 		}
 	}
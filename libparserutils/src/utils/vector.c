@@ -16,7 +16,7 @@
 struct parserutils_vector
 {
 	size_t item_size;		/**< Size of an item in the vector */
-	size_t chunk_size;		/**< Size of a vector chunk */
+	size_t chunk_size;		/**< Initial number of slots */
 	size_t items_allocated;		/**< Number of slots allocated */
 	int32_t current_item;		/**< Index of current item */
 	void *items;			/**< Items in vector */
@@ -26,7 +26,7 @@ struct parserutils_vector
  * Create a vector
  *
  * \param item_size   Length, in bytes, of an item in the vector
- * \param chunk_size  Number of vector slots in a chunk
+ * \param chunk_size  Number of vector slots to allocate initially
  * \param vector      Pointer to location to receive vector instance
  * \return PARSERUTILS_OK on success,
  *         PARSERUTILS_BADPARM on bad parameters,
@@ -99,14 +99,17 @@ parserutils_error parserutils_vector_append(parserutils_vector *vector,
 	slot = vector->current_item + 1;
 
 	if ((size_t) slot >= vector->items_allocated) {
-		void *temp = realloc(vector->items,
-				(vector->items_allocated + vector->chunk_size) *
-				vector->item_size);
+		/* Double the allocation, so that a long run of appends 
+		 * costs amortised constant copying per item. A cleared 
+		 * vector keeps its slots, so once it has grown to fit 
+		 * the longest run appending no longer allocates. */
+		size_t items = vector->items_allocated * 2;
+		void *temp = realloc(vector->items, items * vector->item_size);
 		if (temp == NULL)
 			return PARSERUTILS_NOMEM;
 
 		vector->items = temp;
-		vector->items_allocated += vector->chunk_size;
+		vector->items_allocated = items;
 	}
 
 	memcpy((uint8_t *) vector->items + (slot * vector->item_size), 
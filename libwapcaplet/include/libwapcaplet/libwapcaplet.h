@@ -17,6 +17,7 @@ extern "C"
 #include <sys/types.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 #include <assert.h>
 
 /**
@@ -29,6 +30,15 @@ typedef uint32_t lwc_refcounter;
  */
 typedef uint32_t lwc_hash;
 
+/**
+ * A set of interned strings.
+ *
+ * Strings are interned into the context selected by the calling thread
+ * (see ::lwc_context_select), or into a process-wide default context if
+ * none has been selected.
+ */
+typedef struct lwc_context_s lwc_context;
+
 /**
  * An interned string.
  *
@@ -42,8 +52,12 @@ typedef struct lwc_string_s {
         struct lwc_string_s *	next;
         size_t		len;
         lwc_hash	hash;
+        lwc_hash	lcase_hash;	/* Hash of the lower cased string */
         lwc_refcounter	refcnt;
+        bool		lcase;		/* No ASCII upper case letters */
+        bool		immortal;	/* Never freed nor refcounted */
         struct lwc_string_s *	insensitive;
+        lwc_context *	ctx;
 } lwc_string;
 	
 /**
@@ -64,13 +78,51 @@ typedef enum lwc_error_e {
     lwc_error_bad_param = 3     /**< Bad param. */
 } lwc_error;
 
+/**
+ * Create an empty intern context.
+ *
+ * @param ret  Pointer to ::lwc_context pointer to fill out.
+ * @return     Result of operation, if not OK then the value pointed
+ *	       to by \a ret will not be valid.
+ */
+extern lwc_error lwc_context_create(lwc_context **ret);
+
+/**
+ * Destroy an intern context and every string in it.
+ *
+ * The strings are freed regardless of their reference counts, so this
+ * is the way to drop everything a context was used for at once rather
+ * than unref'ing each string in turn.
+ *
+ * @param ctx  The context to destroy.
+ * @return     lwc_error_ok on success, lwc_error_bad_param if \a ctx is
+ *	       NULL or the default context.
+ *
+ * @note No string from \a ctx may be used afterwards, not even to
+ *	 unref it, and \a ctx must not be selected by any thread.
+ */
+extern lwc_error lwc_context_destroy(lwc_context *ctx);
+
+/**
+ * Select the context into which the calling thread interns strings.
+ *
+ * @param ctx  The context to use, or NULL for the default context.
+ * @return     The previously selected context (NULL for the default),
+ *	       so that callers can restore it when done.
+ *
+ * @note The selection only affects where new strings are created.
+ *	 Existing strings, and their caseless copies, always live in the
+ *	 context they were first interned into.
+ */
+extern lwc_context *lwc_context_select(lwc_context *ctx);
+
 /**
  * Intern a string.
  *
  * Take a copy of the string data referred to by \a s and \a slen and
- * intern it.  The resulting ::lwc_string can be used for simple and
- * caseless comparisons by ::lwc_string_isequal and
- * ::lwc_string_caseless_isequal respectively.
+ * intern it in the calling thread's current context.  The resulting
+ * ::lwc_string can be used for simple and caseless comparisons by
+ * ::lwc_string_isequal and ::lwc_string_caseless_isequal respectively.
  *
  * @param s    Pointer to the start of the string to intern.
  * @param slen Length of the string in characters. (Not including any 
@@ -90,6 +142,42 @@ typedef enum lwc_error_e {
 extern lwc_error lwc_intern_string(const char *s, size_t slen,
                                    lwc_string **ret);
 
+/**
+ * Longest string which fits in an ::lwc_static_string.
+ */
+#define LWC_STATIC_STRING_MAX (31)
+
+/**
+ * Caller-provided storage for an immortal string.
+ */
+typedef struct lwc_static_string_s {
+	lwc_string	str;
+	char		data[LWC_STATIC_STRING_MAX + 1];
+} lwc_static_string;
+
+/**
+ * Intern an immortal string in caller-provided storage.
+ *
+ * The string is added to the default context and is never freed.
+ * Referencing and releasing it leave its reference count untouched, so
+ * it can be shared between threads without contention.  Its caseless
+ * copy is created up front.
+ *
+ * @param storage Storage for the string, which must outlive every user
+ *		  of libwapcaplet; normally a static variable.
+ * @param s	  Pointer to the start of the string to intern.
+ * @param slen	  Length of the string, at most ::LWC_STATIC_STRING_MAX.
+ * @param ret	  Pointer to ::lwc_string pointer to fill out.
+ * @return	  Result of operation, if not OK then the value pointed
+ *		  to by \a ret will not be valid.
+ *
+ * @note If the string was already interned, the existing string is
+ *	 returned, made permanent, and \a storage is left unused.
+ */
+extern lwc_error lwc_intern_static_string(lwc_static_string *storage,
+                                          const char *s, size_t slen,
+                                          lwc_string **ret);
+
 /**
  * Intern a substring.
  *
@@ -116,6 +204,13 @@ extern lwc_error lwc_intern_substring(lwc_string *str,
  */
 extern lwc_error lwc_string_tolower(lwc_string *str, lwc_string **ret);
 
+/**
+ * Read the caseless copy of an interned string, which another thread
+ * may be setting concurrently.  For internal use by the macros here.
+ */
+#define lwc__insensitive(str) \
+	__atomic_load_n(&(str)->insensitive, __ATOMIC_ACQUIRE)
+
 /**
  * Increment the reference count on an lwc_string.
  *
@@ -132,8 +227,9 @@ extern lwc_error lwc_string_tolower(lwc_string *str, lwc_string **ret);
  *
  * @note Use this if copying the string and intending both sides to retain
  * ownership.
+ * @note Immortal strings are returned without touching their count.
  */
-#define lwc_string_ref(str) ({lwc_string *__lwc_s = (str); assert(__lwc_s != NULL); __lwc_s->refcnt++; __lwc_s;})
+#define lwc_string_ref(str) ({lwc_string *__lwc_s = (str); assert(__lwc_s != NULL); if (!__lwc_s->immortal) __atomic_fetch_add(&__lwc_s->refcnt, 1, __ATOMIC_RELAXED); __lwc_s;})
 
 /**
  * Release a reference on an lwc_string.
@@ -145,20 +241,37 @@ extern lwc_error lwc_string_tolower(lwc_string *str, lwc_string **ret);
  * @note If the reference count reaches zero then the string will be
  *       freed. (Ref count of 1 where string is its own insensitve match
  *       will also result in the string being freed.)
+ *
+ * @note References which may be the last are handed to
+ *       ::lwc_string_destroy so the final decrement happens under the
+ *       intern table's lock.
+ * @note Releasing an immortal string does nothing.
  */
 #define lwc_string_unref(str) {						\
 		lwc_string *__lwc_s = (str);				\
+		lwc_refcounter __lwc_r;					\
 		assert(__lwc_s != NULL);				\
-		__lwc_s->refcnt--;						\
-		if ((__lwc_s->refcnt == 0) ||					\
-		    ((__lwc_s->refcnt == 1) && (__lwc_s->insensitive == __lwc_s)))	\
-			lwc_string_destroy(__lwc_s);				\
+		__lwc_r = __atomic_load_n(&__lwc_s->refcnt, __ATOMIC_RELAXED); \
+		while (!__lwc_s->immortal) {				\
+			if ((__lwc_r <= 1) ||				\
+			    ((__lwc_r == 2) && (lwc__insensitive(__lwc_s) == __lwc_s))) { \
+				lwc_string_destroy(__lwc_s);		\
+				break;					\
+			}						\
+			if (__atomic_compare_exchange_n(&__lwc_s->refcnt, \
+					&__lwc_r, __lwc_r - 1, true,	\
+					__ATOMIC_RELEASE, __ATOMIC_RELAXED)) \
+				break;					\
+		}							\
 	}
 	
 /**
- * Destroy an unreffed lwc_string.
+ * Release what may be the last reference on an lwc_string.
  *
- * This destroys an lwc_string whose reference count indicates that it should be.
+ * This drops one reference from \a str and destroys it if its reference
+ * count then indicates that it should be.  The check is made under the
+ * intern table's lock, so a concurrent intern of the same string either
+ * revives it first or gets a new string.
  *
  * @param str The string to unref.
  */
@@ -167,18 +280,40 @@ extern void lwc_string_destroy(lwc_string *str);
 /**
  * Check if two interned strings are equal.
  *
+ * Strings from the same context are equal only if they are the same
+ * string.  Each context interns its own copy of a string, so strings
+ * from different contexts have their data compared instead.
+ *
  * @param str1 The first string in the comparison.
  * @param str2 The second string in the comparison.
  * @param ret  A pointer to a boolean to be filled out with the result.
  * @return     Result of operation, if not ok then value pointed to
  *	       by \a ret will not be valid.
  */
-#define lwc_string_isequal(str1, str2, ret) \
-	((*(ret) = ((str1) == (str2))), lwc_error_ok)
+#define lwc_string_isequal(str1, str2, ret) ({                          \
+            lwc_string *__lwc_str1 = (str1);                            \
+            lwc_string *__lwc_str2 = (str2);                            \
+                                                                        \
+            *(ret) = (__lwc_str1 == __lwc_str2 ||                       \
+                      (__lwc_str1 != NULL && __lwc_str2 != NULL &&      \
+                       __lwc_str1->ctx != __lwc_str2->ctx &&            \
+                       __lwc_str1->hash == __lwc_str2->hash &&          \
+                       __lwc_str1->len == __lwc_str2->len &&            \
+                       memcmp(lwc_string_data(__lwc_str1),              \
+                              lwc_string_data(__lwc_str2),              \
+                              __lwc_str1->len) == 0));                  \
+            lwc_error_ok;                                               \
+        })
 
 /**
  * Check if two interned strings are case-insensitively equal.
  *
+ * The answer is usually found from the strings' lengths, lower case
+ * hashes and caseless copies; failing that their data is compared.
+ * Neither string's caseless copy is interned as a side effect.
+ * Caseless copies are per context, so strings from different contexts
+ * always have their data compared.
+ *
  * @param _str1 The first string in the comparison.
  * @param _str2 The second string in the comparison.
  * @param _ret  A pointer to a boolean to be filled out with the result.
@@ -186,21 +321,40 @@ extern void lwc_string_destroy(lwc_string *str);
  *	    not be valid.
  */
 #define lwc_string_caseless_isequal(_str1,_str2,_ret) ({                \
-            lwc_error __lwc_err = lwc_error_ok;                         \
             lwc_string *__lwc_str1 = (_str1);                           \
             lwc_string *__lwc_str2 = (_str2);                           \
             bool *__lwc_ret = (_ret);                                   \
+            lwc_string *__lwc_ins1, *__lwc_ins2;                        \
                                                                         \
-            if (__lwc_str1->insensitive == NULL) {                      \
-                __lwc_err = lwc__intern_caseless_string(__lwc_str1);    \
-            }                                                           \
-            if (__lwc_err == lwc_error_ok && __lwc_str2->insensitive == NULL) { \
-                __lwc_err = lwc__intern_caseless_string(__lwc_str2);    \
+            if (__lwc_str1 == __lwc_str2) {                             \
+                *__lwc_ret = true;                                      \
+            } else if (__lwc_str1->lcase_hash != __lwc_str2->lcase_hash || \
+                       __lwc_str1->len != __lwc_str2->len) {            \
+                *__lwc_ret = false;                                     \
+            } else if (__lwc_str1->ctx != __lwc_str2->ctx) {            \
+                *__lwc_ret = lwc__string_caseless_match(__lwc_str1,     \
+                                                        __lwc_str2);    \
+            } else if (__lwc_str1->lcase && __lwc_str2->lcase) {        \
+                *__lwc_ret = false;                                     \
+            } else if ((__lwc_ins1 = lwc__insensitive(__lwc_str1)) != NULL && \
+                       (__lwc_ins2 = lwc__insensitive(__lwc_str2)) != NULL) { \
+                *__lwc_ret = (__lwc_ins1 == __lwc_ins2);                \
+            } else {                                                    \
+                *__lwc_ret = lwc__string_caseless_match(__lwc_str1,     \
+                                                        __lwc_str2);    \
             }                                                           \
-            if (__lwc_err == lwc_error_ok)                              \
-                *__lwc_ret = (__lwc_str1->insensitive == __lwc_str2->insensitive); \
-            __lwc_err;                                                  \
+            lwc_error_ok;                                               \
         })
+
+/**
+ * Compare the data of two interned strings of equal length, ignoring
+ * ASCII case.
+ *
+ * @note This is for "internal" use by the caseless comparison
+ *       macro and not for users.
+ */
+extern bool
+lwc__string_caseless_match(const lwc_string *str1, const lwc_string *str2);
 	
 /**
  * Intern a caseless copy of the passed string.
@@ -212,6 +366,8 @@ extern void lwc_string_destroy(lwc_string *str);
  *
  * @note This is for "internal" use by the caseless comparison
  *       macro and not for users.
+ * @note It is not an error if \a str already has its caseless copy;
+ *       another thread may have created it concurrently.
  */	
 extern lwc_error
 lwc__intern_caseless_string(lwc_string *str);
@@ -253,13 +409,82 @@ lwc__intern_caseless_string(lwc_string *str);
 #define lwc_string_hash_value(str) ({assert(str != NULL); (str)->hash;})
 
 /**
- * Iterate the context and return every string in it.
+ * Iterate the current context and return every string in it.
  *
  * @param cb The callback to give the string to.
  * @param pw The private word for the callback.
+ *
+ * @note Parts of the intern table are locked while \a cb runs, so it
+ *       must not intern or release strings.
  */
 extern void lwc_iterate_strings(lwc_iteration_callback_fn cb, void *pw);
 
+/**
+ * Number of size classes used to allocate strings.
+ */
+#define LWC_SLAB_CLASSES (13)
+
+/**
+ * Occupancy of the slabs strings are allocated from.
+ */
+typedef struct lwc_slab_usage_s {
+	struct {
+		size_t	object_size;	/**< Bytes per object in the class */
+		size_t	slabs;		/**< Slabs allocated to the class */
+		size_t	used;		/**< Objects in use */
+		size_t	capacity;	/**< Objects the slabs can hold */
+	} classes[LWC_SLAB_CLASSES];
+	size_t	slab_size;		/**< Bytes per slab */
+	size_t	large_strings;		/**< Strings too big for any class */
+	size_t	large_bytes;		/**< Bytes allocated to those */
+} lwc_slab_usage;
+
+/**
+ * Report how full the current context's string slabs are.
+ *
+ * @param usage Pointer to the ::lwc_slab_usage to fill out.
+ * @return      Result of operation, if not OK then the value pointed
+ *		to by \a usage will not be valid.
+ */
+extern lwc_error lwc_get_slab_usage(lwc_slab_usage *usage);
+
+/**
+ * Number of chain lengths distinguished by ::lwc_stats.
+ */
+#define LWC_STATS_CHAIN_LENGTHS (8)
+
+/**
+ * Statistics about an intern context.
+ */
+typedef struct lwc_stats_s {
+	size_t		strings;	/**< Live strings */
+	size_t		bytes;		/**< Bytes they take, headers
+					 * included */
+	size_t		buckets;	/**< Hash chains */
+	size_t		chains[LWC_STATS_CHAIN_LENGTHS];
+					/**< Number of chains of each
+					 * length; the last entry also
+					 * counts all longer chains */
+	uint64_t	hits;		/**< Interns finding an existing
+					 * string */
+	uint64_t	misses;		/**< Interns creating a new one */
+	size_t		caseless_twins;	/**< Strings whose caseless copy
+					 * is a separate string */
+} lwc_stats;
+
+/**
+ * Gather statistics about the current context.
+ *
+ * @param stats Pointer to the ::lwc_stats to fill out.
+ * @return      Result of operation, if not OK then the value pointed
+ *		to by \a stats will not be valid.
+ *
+ * @note This walks every hash chain, locking parts of the table in
+ *	 turn, so it is meant for occasional monitoring rather than for
+ *	 hot paths.
+ */
+extern lwc_error lwc_get_stats(lwc_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -7,8 +7,10 @@
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "../include/libwapcaplet/libwapcaplet.h"
 
@@ -16,126 +18,760 @@
 #define UNUSED(x) ((x) = (x))
 #endif
 
+/**** Word-at-a-time helpers ****/
+
+#define LWC_ONES	UINT64_C(0x0101010101010101)
+#define LWC_HIGHBITS	(LWC_ONES * 0x80)
+
+static inline uint64_t
+lwc__load64(const char *p)
+{
+	uint64_t w;
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+static inline uint32_t
+lwc__load32(const char *p)
+{
+	uint32_t w;
+	memcpy(&w, p, sizeof(w));
+	return w;
+}
+
+/**
+ * Load the last 1-7 bytes of a string as a word.  The bytes picked
+ * depend only on the contents and the length, which is mixed into the
+ * hash separately.
+ */
+static inline uint64_t
+lwc__load_tail(const char *p, size_t n)
+{
+	if (n >= 4)
+		return lwc__load32(p) |
+				((uint64_t) lwc__load32(p + n - 4) << 32);
+
+	return (uint64_t) (unsigned char) p[0] |
+			((uint64_t) (unsigned char) p[n / 2] << 8) |
+			((uint64_t) (unsigned char) p[n - 1] << 16);
+}
+
+/**
+ * Find the ASCII upper case bytes of a word; each has its top bit set
+ * in the result.
+ */
+static inline uint64_t
+lwc__upper_bytes(uint64_t w)
+{
+	uint64_t low7 = w & ~LWC_HIGHBITS;
+	uint64_t ge_a = low7 + LWC_ONES * (0x80 - 'A');
+	uint64_t gt_z = low7 + LWC_ONES * (0x7f - 'Z');
+
+	return (ge_a ^ gt_z) & ~w & LWC_HIGHBITS;
+}
+
+/**
+ * Lower case the ASCII letters of a word, leaving all other bytes.
+ */
+static inline uint64_t
+lwc__lower_word(uint64_t w)
+{
+	return w | (lwc__upper_bytes(w) >> 2);
+}
+
+/**** Hashing ****/
+
+static inline uint64_t
+lwc__hash_mix(uint64_t h, uint64_t w)
+{
+	h ^= w;
+	h *= UINT64_C(0x9e3779b97f4a7c15);
+	return h ^ (h >> 29);
+}
+
 static inline lwc_hash
-lwc__calculate_hash(const char *str, size_t len)
+lwc__hash_final(uint64_t h, size_t len)
+{
+	h ^= len;
+	h ^= h >> 33;
+	h *= UINT64_C(0xff51afd7ed558ccd);
+	h ^= h >> 33;
+	h *= UINT64_C(0xc4ceb9fe1a85ec53);
+	h ^= h >> 33;
+	return (lwc_hash) h;
+}
+
+/**
+ * Hash a string eight bytes at a time, producing both its own hash and
+ * that of its ASCII lower cased form.
+ *
+ * The two hashes share their state until the first word containing an
+ * upper case letter, so strings which are already lower case (most of
+ * CSS) pay for one chain of multiplies.
+ *
+ * \return true if the string contains no ASCII upper case letters.
+ */
+static inline bool
+lwc__calculate_hashes(const char *str, size_t len,
+		lwc_hash *hash, lwc_hash *lcase_hash)
 {
-	lwc_hash z = 0x811c9dc5;
+	uint64_t h = 0x811c9dc5, lh = h;
+	bool folded = false;
+	size_t n = len;
+	uint64_t w;
 
-	while (len > 0) {
-		z *= 0x01000193;
-		z ^= *str++;
-		len--;
+	for (; n >= 8; str += 8, n -= 8) {
+		w = lwc__load64(str);
+		if (folded == false && lwc__upper_bytes(w) != 0) {
+			folded = true;
+			lh = h;
+		}
+		h = lwc__hash_mix(h, w);
+		if (folded)
+			lh = lwc__hash_mix(lh, lwc__lower_word(w));
 	}
 
-	return z;
+	if (n > 0) {
+		w = lwc__load_tail(str, n);
+		if (folded == false && lwc__upper_bytes(w) != 0) {
+			folded = true;
+			lh = h;
+		}
+		h = lwc__hash_mix(h, w);
+		if (folded)
+			lh = lwc__hash_mix(lh, lwc__lower_word(w));
+	}
+
+	*hash = lwc__hash_final(h, len);
+	*lcase_hash = folded ? lwc__hash_final(lh, len) : *hash;
+
+	return folded == false;
 }
 
 #define STR_OF(str) ((char *)(str + 1))
 #define CSTR_OF(str) ((const char *)(str + 1))
 
-#define NR_BUCKETS_DEFAULT	(4091)
+/* The table is split into shards, each with its own lock, so that
+ * threads interning unrelated strings rarely contend.  The shard is
+ * picked from the top bits of the hash; the bucket within it from the
+ * hash modulo the shard's (prime) bucket count. */
+#define LWC_SHARD_BITS		(4)
+#define NR_SHARDS		(1 << LWC_SHARD_BITS)
+#define LWC_SHARD_OF(h)		((h) >> (32 - LWC_SHARD_BITS))
+
+#define NR_BUCKETS_DEFAULT	(257)
+
+/* Number of old buckets migrated by each intern or destroy call while
+ * a shard is being resized. */
+#define LWC_REHASH_STEP		(16)
+
+/* A shard grows once it holds more strings than buckets and shrinks
+ * (never below NR_BUCKETS_DEFAULT) once it is less than 1/8 full. */
+#define LWC_GROW_LOAD(shard)	((shard)->bucketcount)
+#define LWC_SHRINK_LOAD(shard)	((shard)->bucketcount / 8)
+
+/* Bucket counts a shard may take; primes, roughly doubling. */
+static const lwc_hash lwc__bucket_sizes[] = {
+	NR_BUCKETS_DEFAULT, 521, 1049, 2099, 4201, 8419, 16843, 33703,
+	67409, 134837, 269683, 539389, 1078787, 2157587, 4315183, 8630387,
+	17260781
+};
+
+#define NR_BUCKET_SIZES \
+	(sizeof(lwc__bucket_sizes) / sizeof(lwc__bucket_sizes[0]))
+
+/* Strings up to LWC_SLAB_MAX_OBJECT bytes, header and NUL included, are
+ * carved out of LWC_SLAB_SIZE byte slabs of equally sized objects, one
+ * set of size classes per shard.  Slabs are aligned to their size so
+ * the slab holding an object can be found from its address.
+ *
+ * The smallest class is the smallest that holds an empty string.  The
+ * lwc_string header is 56 bytes on LP64 hosts, so classes start at 64
+ * bytes there and identifiers of under 32 bytes take 64, 80 or 96; a
+ * smaller class could never be used. */
+#define LWC_SLAB_SIZE		(4096)
+#define LWC_SLAB_GRANULE	(16)
+#define LWC_SLAB_MIN_OBJECT \
+	((LWC_STRING_SIZE(0) + LWC_SLAB_GRANULE - 1) & ~(LWC_SLAB_GRANULE - 1))
+#define LWC_SLAB_MAX_OBJECT \
+	(LWC_SLAB_MIN_OBJECT + (LWC_SLAB_CLASSES - 1) * LWC_SLAB_GRANULE)
+
+#define LWC_SLAB_CLASS_OF(size) \
+	((size) <= LWC_SLAB_MIN_OBJECT ? 0 : \
+	 ((size) - LWC_SLAB_MIN_OBJECT + LWC_SLAB_GRANULE - 1) / \
+			LWC_SLAB_GRANULE)
+#define LWC_SLAB_CLASS_SIZE(cls) \
+	(LWC_SLAB_MIN_OBJECT + (cls) * LWC_SLAB_GRANULE)
+
+/* Total allocation for a string of a given length. */
+#define LWC_STRING_SIZE(len) (sizeof(lwc_string) + (len) + 1)
 
-typedef struct lwc_context_s {
+typedef struct lwc_slab_s {
+	struct lwc_slab_s **	prevptr;
+	struct lwc_slab_s *	next;
+	void *			freelist;	/**< Free objects, linked
+						 * through their first word */
+	unsigned int		used;		/**< Objects handed out */
+} lwc_slab;
+
+/* Objects start at the first multiple of the granule after the header. */
+#define LWC_SLAB_HEADER \
+	((sizeof(lwc_slab) + LWC_SLAB_GRANULE - 1) & ~(LWC_SLAB_GRANULE - 1))
+#define LWC_SLAB_CAPACITY(cls) \
+	((LWC_SLAB_SIZE - LWC_SLAB_HEADER) / LWC_SLAB_CLASS_SIZE(cls))
+#define LWC_SLAB_OF(ptr) \
+	((lwc_slab *) ((uintptr_t) (ptr) & ~(uintptr_t) (LWC_SLAB_SIZE - 1)))
+
+typedef struct lwc_slab_class_s {
+	lwc_slab *		partial;	/**< Slabs with free objects */
+	lwc_slab *		full;		/**< Slabs without */
+	size_t			slabs;		/**< Slabs on both lists */
+	size_t			used;		/**< Objects handed out */
+} lwc_slab_class;
+
+/* Strings too large for a slab are malloc'd behind one of these, which
+ * keeps them on a list so that a context can be freed without walking
+ * its hash chains. */
+typedef struct lwc_large_s {
+	struct lwc_large_s **	prevptr;
+	struct lwc_large_s *	next;
+} lwc_large;
+
+typedef struct lwc_shard_s {
+	pthread_mutex_t		lock;		/**< Protects everything below
+						 * and the chain links of the
+						 * strings in this shard */
 	lwc_string **		buckets;
 	lwc_hash		bucketcount;
-} lwc_context;
+	unsigned int		sizeidx;	/**< Index of bucketcount in
+						 * lwc__bucket_sizes */
+	size_t			stringcount;	/**< Strings in both tables */
+
+	/* While resizing, strings are moved from the old table into
+	 * buckets a few old buckets at a time.  Old buckets below
+	 * rehashidx are already empty. */
+	lwc_string **		oldbuckets;
+	lwc_hash		oldbucketcount;
+	lwc_hash		rehashidx;
+
+	lwc_slab_class		slabs[LWC_SLAB_CLASSES];
+	lwc_large *		large;		/**< Strings not in slabs */
+	size_t			largecount;
+	size_t			largebytes;
 
-static lwc_context *ctx = NULL;
+	uint64_t		hits;		/**< Interns finding a string */
+	uint64_t		misses;		/**< Interns creating one */
+} lwc_shard;
+
+struct lwc_context_s {
+	lwc_shard		shards[NR_SHARDS];
+};
+
+/* The context used by threads which have not selected one. */
+static lwc_context *default_ctx = NULL;
+static lwc_error default_ctx_error = lwc_error_ok;
+static pthread_once_t default_ctx_once = PTHREAD_ONCE_INIT;
+
+/* The context selected by this thread, or NULL for the default. */
+static __thread lwc_context *current_ctx = NULL;
 
 #define LWC_ALLOC(s) malloc(s)
 #define LWC_FREE(p) free(p)
 
-typedef lwc_hash (*lwc_hasher)(const char *, size_t);
-typedef int (*lwc_strncmp)(const char *, const char *, size_t);
-typedef void (*lwc_memcpy)(char *, const char *, size_t);
+static inline void *
+LWC_ALLOC_SLAB(void)
+{
+	void *slab;
+
+	if (posix_memalign(&slab, LWC_SLAB_SIZE, LWC_SLAB_SIZE) != 0)
+		return NULL;
+
+	return slab;
+}
+
+typedef int (*lwc_memcmp)(const void *, const void *, size_t);
+typedef void *(*lwc_memcpy)(void *, const void *, size_t);
+
+/**
+ * Allocate storage for a string of \a size bytes from a shard.
+ *
+ * Must be called with the shard lock held.
+ */
+static void *
+lwc__string_alloc(lwc_shard *shard, size_t size)
+{
+	lwc_slab_class *cls;
+	lwc_slab *slab;
+	void *obj;
+
+	if (size > LWC_SLAB_MAX_OBJECT) {
+		lwc_large *large = LWC_ALLOC(sizeof(lwc_large) + size);
+
+		if (large == NULL)
+			return NULL;
+
+		large->prevptr = &shard->large;
+		large->next = shard->large;
+		if (large->next != NULL)
+			large->next->prevptr = &large->next;
+		shard->large = large;
+		shard->largecount++;
+		shard->largebytes += size;
+
+		return large + 1;
+	}
+
+	cls = &shard->slabs[LWC_SLAB_CLASS_OF(size)];
+	slab = cls->partial;
+
+	if (slab == NULL) {
+		size_t objsize = LWC_SLAB_CLASS_SIZE(LWC_SLAB_CLASS_OF(size));
+		size_t n = LWC_SLAB_CAPACITY(LWC_SLAB_CLASS_OF(size));
+		char *base;
+
+		slab = LWC_ALLOC_SLAB();
+		if (slab == NULL)
+			return NULL;
+
+		slab->freelist = NULL;
+		slab->used = 0;
+
+		/* Thread the objects so they are handed out in address
+		 * order. */
+		base = (char *) slab + LWC_SLAB_HEADER;
+		while (n-- > 0) {
+			*(void **) (base + n * objsize) = slab->freelist;
+			slab->freelist = base + n * objsize;
+		}
+
+		slab->prevptr = &cls->partial;
+		slab->next = NULL;
+		cls->partial = slab;
+		cls->slabs++;
+	}
+
+	obj = slab->freelist;
+	slab->freelist = *(void **) obj;
+	slab->used++;
+	cls->used++;
+
+	if (slab->freelist == NULL) {
+		/* Now full; move it across. */
+		*(slab->prevptr) = slab->next;
+		if (slab->next != NULL)
+			slab->next->prevptr = slab->prevptr;
+
+		slab->prevptr = &cls->full;
+		slab->next = cls->full;
+		if (slab->next != NULL)
+			slab->next->prevptr = &slab->next;
+		cls->full = slab;
+	}
+
+	return obj;
+}
+
+/**
+ * Return \a size bytes of string storage at \a obj to a shard.
+ *
+ * Must be called with the shard lock held.
+ */
+static void
+lwc__string_free(lwc_shard *shard, void *obj, size_t size)
+{
+	lwc_slab_class *cls;
+	lwc_slab *slab;
+	bool wasfull;
+
+	if (size > LWC_SLAB_MAX_OBJECT) {
+		lwc_large *large = (lwc_large *) obj - 1;
+
+		*(large->prevptr) = large->next;
+		if (large->next != NULL)
+			large->next->prevptr = large->prevptr;
+		shard->largecount--;
+		shard->largebytes -= size;
+
+		LWC_FREE(large);
+		return;
+	}
+
+	cls = &shard->slabs[LWC_SLAB_CLASS_OF(size)];
+	slab = LWC_SLAB_OF(obj);
+	wasfull = (slab->freelist == NULL);
+
+	*(void **) obj = slab->freelist;
+	slab->freelist = obj;
+	slab->used--;
+	cls->used--;
+
+	if (slab->used == 0 || wasfull) {
+		*(slab->prevptr) = slab->next;
+		if (slab->next != NULL)
+			slab->next->prevptr = slab->prevptr;
+
+		/* Release empty slabs, unless this is the only one left
+		 * that can take new strings. */
+		if (slab->used == 0 && cls->partial != NULL) {
+			cls->slabs--;
+			LWC_FREE(slab);
+			return;
+		}
+
+		slab->prevptr = &cls->partial;
+		slab->next = cls->partial;
+		if (slab->next != NULL)
+			slab->next->prevptr = &slab->next;
+		cls->partial = slab;
+	}
+}
+
+/**
+ * Release every string allocated from a shard.
+ */
+static void
+lwc__shard_free_strings(lwc_shard *shard)
+{
+	lwc_slab *slab, *nextslab;
+	lwc_large *large, *nextlarge;
+	int i;
+
+	for (i = 0; i < LWC_SLAB_CLASSES; i++) {
+		for (slab = shard->slabs[i].partial; slab != NULL;
+				slab = nextslab) {
+			nextslab = slab->next;
+			LWC_FREE(slab);
+		}
+		for (slab = shard->slabs[i].full; slab != NULL;
+				slab = nextslab) {
+			nextslab = slab->next;
+			LWC_FREE(slab);
+		}
+	}
+
+	for (large = shard->large; large != NULL; large = nextlarge) {
+		nextlarge = large->next;
+		LWC_FREE(large);
+	}
+}
 
 static lwc_error
-lwc__initialise(void)
+lwc__context_create(lwc_context **ret)
 {
-	if (ctx != NULL)
-		return lwc_error_ok;
+	lwc_context *c;
+	int i;
 
-	ctx = LWC_ALLOC(sizeof(lwc_context));
+	c = LWC_ALLOC(sizeof(lwc_context));
 
-	if (ctx == NULL)
+	if (c == NULL)
 		return lwc_error_oom;
 
-	memset(ctx, 0, sizeof(lwc_context));
+	memset(c, 0, sizeof(lwc_context));
 
-	ctx->bucketcount = NR_BUCKETS_DEFAULT;
-	ctx->buckets = LWC_ALLOC(sizeof(lwc_string *) * ctx->bucketcount);
+	for (i = 0; i < NR_SHARDS; i++) {
+		lwc_shard *shard = &c->shards[i];
 
-	if (ctx->buckets == NULL) {
-		LWC_FREE(ctx);
-		ctx = NULL;
-		return lwc_error_oom;
+		shard->bucketcount = NR_BUCKETS_DEFAULT;
+		shard->buckets = LWC_ALLOC(sizeof(lwc_string *) *
+				shard->bucketcount);
+
+		if (shard->buckets == NULL) {
+			while (i-- > 0) {
+				pthread_mutex_destroy(&c->shards[i].lock);
+				LWC_FREE(c->shards[i].buckets);
+			}
+			LWC_FREE(c);
+			return lwc_error_oom;
+		}
+
+		memset(shard->buckets, 0,
+				sizeof(lwc_string *) * shard->bucketcount);
+
+		pthread_mutex_init(&shard->lock, NULL);
 	}
 
-	memset(ctx->buckets, 0, sizeof(lwc_string *) * ctx->bucketcount);
+	*ret = c;
 
 	return lwc_error_ok;
 }
 
+static void
+lwc__initialise_once(void)
+{
+	default_ctx_error = lwc__context_create(&default_ctx);
+}
+
+/**
+ * Find the context new strings should be interned into by this thread.
+ */
 static lwc_error
-lwc__intern(const char *s, size_t slen,
-	   lwc_string **ret,
-	   lwc_hasher hasher,
-	   lwc_strncmp compare,
-	   lwc_memcpy copy)
+lwc__current_context(lwc_context **ret)
+{
+	if (current_ctx != NULL) {
+		*ret = current_ctx;
+		return lwc_error_ok;
+	}
+
+	pthread_once(&default_ctx_once, lwc__initialise_once);
+
+	*ret = default_ctx;
+
+	return default_ctx_error;
+}
+
+lwc_error
+lwc_context_create(lwc_context **ret)
+{
+	if (ret == NULL)
+		return lwc_error_bad_param;
+
+	return lwc__context_create(ret);
+}
+
+lwc_error
+lwc_context_destroy(lwc_context *c)
+{
+	int i;
+
+	if (c == NULL || c == default_ctx)
+		return lwc_error_bad_param;
+
+	for (i = 0; i < NR_SHARDS; i++) {
+		lwc_shard *shard = &c->shards[i];
+
+		lwc__shard_free_strings(shard);
+
+		LWC_FREE(shard->buckets);
+		LWC_FREE(shard->oldbuckets);
+		pthread_mutex_destroy(&shard->lock);
+	}
+
+	LWC_FREE(c);
+
+	return lwc_error_ok;
+}
+
+lwc_context *
+lwc_context_select(lwc_context *c)
+{
+	lwc_context *prev = current_ctx;
+
+	current_ctx = c;
+
+	return prev;
+}
+
+/**
+ * Move up to \a nbuckets chains from the old table into the new one,
+ * releasing the old table once it is empty.
+ *
+ * Must be called with the shard lock held.
+ */
+static void
+lwc__rehash_step(lwc_shard *shard, unsigned int nbuckets)
+{
+	lwc_string *str, *next;
+	lwc_hash bucket;
+
+	while (nbuckets-- > 0 && shard->rehashidx < shard->oldbucketcount) {
+		str = shard->oldbuckets[shard->rehashidx];
+		shard->oldbuckets[shard->rehashidx] = NULL;
+
+		while (str != NULL) {
+			next = str->next;
+
+			bucket = str->hash % shard->bucketcount;
+			str->prevptr = &(shard->buckets[bucket]);
+			str->next = shard->buckets[bucket];
+			if (str->next != NULL)
+				str->next->prevptr = &(str->next);
+			shard->buckets[bucket] = str;
+
+			str = next;
+		}
+
+		shard->rehashidx++;
+	}
+
+	if (shard->rehashidx == shard->oldbucketcount) {
+		LWC_FREE(shard->oldbuckets);
+		shard->oldbuckets = NULL;
+		shard->oldbucketcount = 0;
+		shard->rehashidx = 0;
+	}
+}
+
+/**
+ * Start moving a shard's strings into a table of
+ * lwc__bucket_sizes[sizeidx] buckets.  Failure to allocate simply
+ * leaves the shard as it is.
+ *
+ * Must be called with the shard lock held.
+ */
+static void
+lwc__resize(lwc_shard *shard, unsigned int sizeidx)
+{
+	lwc_hash count = lwc__bucket_sizes[sizeidx];
+	lwc_string **buckets;
+
+	buckets = LWC_ALLOC(sizeof(lwc_string *) * count);
+	if (buckets == NULL)
+		return;
+
+	memset(buckets, 0, sizeof(lwc_string *) * count);
+
+	shard->oldbuckets = shard->buckets;
+	shard->oldbucketcount = shard->bucketcount;
+	shard->rehashidx = 0;
+
+	shard->buckets = buckets;
+	shard->bucketcount = count;
+	shard->sizeidx = sizeidx;
+}
+
+/**
+ * Advance any resize in progress, or start one if the load factor has
+ * left its bounds.
+ *
+ * Must be called with the shard lock held.
+ */
+static inline void
+lwc__maintain(lwc_shard *shard)
+{
+	if (shard->oldbuckets != NULL) {
+		lwc__rehash_step(shard, LWC_REHASH_STEP);
+	} else if (shard->stringcount > LWC_GROW_LOAD(shard)) {
+		if (shard->sizeidx + 1 < NR_BUCKET_SIZES)
+			lwc__resize(shard, shard->sizeidx + 1);
+	} else if (shard->stringcount < LWC_SHRINK_LOAD(shard)) {
+		if (shard->sizeidx > 0)
+			lwc__resize(shard, shard->sizeidx - 1);
+	}
+}
+
+/**
+ * Look a string up in a shard, without taking a reference to it.
+ *
+ * Must be called with the shard lock held.
+ */
+static lwc_string *
+lwc__find(lwc_shard *shard,
+	  const char *s, size_t slen, lwc_hash h,
+	  lwc_memcmp compare)
 {
-	lwc_hash h;
 	lwc_hash bucket;
 	lwc_string *str;
-	lwc_error eret;
 
-	assert((s != NULL) || (slen == 0));
-	assert(ret);
+	if (shard->oldbuckets != NULL) {
+		bucket = h % shard->oldbucketcount;
+		if (bucket >= shard->rehashidx) {
+			str = shard->oldbuckets[bucket];
 
-	if (ctx == NULL) {
-		eret = lwc__initialise();
-		if (eret != lwc_error_ok)
-			return eret;
-		if (ctx == NULL)
-			return lwc_error_oom;
+			while (str != NULL) {
+				if ((str->hash == h) && (str->len == slen) &&
+				    compare(CSTR_OF(str), s, slen) == 0)
+					return str;
+				str = str->next;
+			}
+		}
 	}
 
-	h = hasher(s, slen);
-	bucket = h % ctx->bucketcount;
-	str = ctx->buckets[bucket];
+	bucket = h % shard->bucketcount;
+	str = shard->buckets[bucket];
 
 	while (str != NULL) {
 		if ((str->hash == h) && (str->len == slen)) {
-			if (compare(CSTR_OF(str), s, slen) == 0) {
-				str->refcnt++;
-				*ret = str;
-				return lwc_error_ok;
-			}
+			if (compare(CSTR_OF(str), s, slen) == 0)
+				return str;
 		}
 		str = str->next;
 	}
 
-	/* Add one for the additional NUL. */
-	*ret = str = LWC_ALLOC(sizeof(lwc_string) + slen + 1);
+	return NULL;
+}
 
-	if (str == NULL)
-		return lwc_error_oom;
+/**
+ * Add a new string to the head of its chain in a shard.
+ *
+ * Must be called with the shard lock held.
+ */
+static void
+lwc__insert(lwc_shard *shard, lwc_string *str)
+{
+	lwc_hash bucket = str->hash % shard->bucketcount;
 
-	str->prevptr = &(ctx->buckets[bucket]);
-	str->next = ctx->buckets[bucket];
+	str->prevptr = &(shard->buckets[bucket]);
+	str->next = shard->buckets[bucket];
 	if (str->next != NULL)
 		str->next->prevptr = &(str->next);
-	ctx->buckets[bucket] = str;
+	shard->buckets[bucket] = str;
+	shard->stringcount++;
+}
+
+/**
+ * Find or create a string in a context.
+ *
+ * \a h and \a lh are the hash and lower case hash of the string being
+ * interned, that is of \a s as transformed by \a copy, and \a lcase
+ * whether that string is free of upper case letters.
+ */
+static lwc_error
+lwc__intern(lwc_context *ctx,
+	   const char *s, size_t slen,
+	   lwc_hash h, lwc_hash lh, bool lcase,
+	   lwc_string **ret,
+	   lwc_memcmp compare,
+	   lwc_memcpy copy)
+{
+	lwc_shard *shard;
+	lwc_string *str;
+
+	assert((s != NULL) || (slen == 0));
+	assert(ret);
+
+	shard = &ctx->shards[LWC_SHARD_OF(h)];
+
+	pthread_mutex_lock(&shard->lock);
+
+	lwc__maintain(shard);
+
+	str = lwc__find(shard, s, slen, h, compare);
+	if (str != NULL) {
+		if (str->immortal == false)
+			__atomic_fetch_add(&str->refcnt, 1, __ATOMIC_RELAXED);
+		shard->hits++;
+		pthread_mutex_unlock(&shard->lock);
+		*ret = str;
+		return lwc_error_ok;
+	}
+
+	/* Add one for the additional NUL. */
+	*ret = str = lwc__string_alloc(shard, LWC_STRING_SIZE(slen));
+
+	if (str == NULL) {
+		pthread_mutex_unlock(&shard->lock);
+		return lwc_error_oom;
+	}
 
 	str->len = slen;
 	str->hash = h;
+	str->lcase_hash = lh;
 	str->refcnt = 1;
+	str->lcase = lcase;
+	str->immortal = false;
 	str->insensitive = NULL;
+	str->ctx = ctx;
 
 	copy(STR_OF(str), s, slen);
 
 	/* Guarantee NUL termination */
 	STR_OF(str)[slen] = '\0';
 
+	lwc__insert(shard, str);
+	shard->misses++;
+
+	pthread_mutex_unlock(&shard->lock);
+
 	return lwc_error_ok;
 }
 
@@ -143,11 +779,88 @@ lwc_error
 lwc_intern_string(const char *s, size_t slen,
 		  lwc_string **ret)
 {
+	lwc_context *ctx;
+	lwc_error eret;
+	lwc_hash h, lh;
+	bool lcase;
+
 	if (s == NULL || ret == NULL)
 		return lwc_error_bad_param;
-	return lwc__intern(s, slen, ret,
-			   lwc__calculate_hash,
-			   strncmp, (lwc_memcpy)memcpy);
+
+	eret = lwc__current_context(&ctx);
+	if (eret != lwc_error_ok)
+		return eret;
+
+	lcase = lwc__calculate_hashes(s, slen, &h, &lh);
+
+	return lwc__intern(ctx, s, slen, h, lh, lcase, ret, memcmp, memcpy);
+}
+
+lwc_error
+lwc_intern_static_string(lwc_static_string *storage,
+			 const char *s, size_t slen,
+			 lwc_string **ret)
+{
+	lwc_context *ctx;
+	lwc_shard *shard;
+	lwc_string *str;
+	lwc_error eret;
+	lwc_hash h, lh;
+	bool lcase;
+
+	if (storage == NULL || s == NULL || ret == NULL)
+		return lwc_error_bad_param;
+
+	if (slen >= sizeof(storage->data))
+		return lwc_error_range;
+
+	pthread_once(&default_ctx_once, lwc__initialise_once);
+	if (default_ctx_error != lwc_error_ok)
+		return default_ctx_error;
+	ctx = default_ctx;
+
+	lcase = lwc__calculate_hashes(s, slen, &h, &lh);
+	shard = &ctx->shards[LWC_SHARD_OF(h)];
+
+	pthread_mutex_lock(&shard->lock);
+
+	str = lwc__find(shard, s, slen, h, memcmp);
+	if (str != NULL) {
+		/* Already interned dynamically; keep that string alive
+		 * for good rather than have two copies. */
+		if (str->immortal == false)
+			__atomic_fetch_add(&str->refcnt, 1, __ATOMIC_RELAXED);
+	} else {
+		str = &storage->str;
+
+		str->len = slen;
+		str->hash = h;
+		str->lcase_hash = lh;
+		str->refcnt = 1;
+		str->lcase = lcase;
+		str->immortal = true;
+		str->insensitive = lcase ? str : NULL;
+		str->ctx = ctx;
+
+		memcpy(storage->data, s, slen);
+		storage->data[slen] = '\0';
+
+		lwc__insert(shard, str);
+	}
+
+	pthread_mutex_unlock(&shard->lock);
+
+	/* Make the caseless copy now, so that it is never created
+	 * lazily from a hot path. */
+	if (str->insensitive == NULL) {
+		eret = lwc__intern_caseless_string(str);
+		if (eret != lwc_error_ok)
+			return eret;
+	}
+
+	*ret = str;
+
+	return lwc_error_ok;
 }
 
 lwc_error
@@ -176,6 +889,13 @@ lwc_string_tolower(lwc_string *str, lwc_string **ret)
 	//assert(str);
 	//assert(ret);
 
+	/* A string with no upper case letters is its own lower case
+	 * form. */
+	if (str->lcase) {
+		*ret = lwc_string_ref(str);
+		return lwc_error_ok;
+	}
+
 	/* Internally make use of knowledge that insensitive strings
 	 * are lower case. */
 	if (str->insensitive == NULL) {
@@ -192,22 +912,49 @@ lwc_string_tolower(lwc_string *str, lwc_string **ret)
 void
 lwc_string_destroy(lwc_string *str)
 {
-	if (str == NULL)
+	lwc_shard *shard;
+	lwc_string *insensitive;
+	lwc_refcounter refcnt;
+	size_t size;
+
+	if (str == NULL || str->immortal)
+		return;
+
+	shard = &str->ctx->shards[LWC_SHARD_OF(str->hash)];
+
+	/* Lookups take their reference under the shard lock, so once the
+	 * count is found to be final here nobody else can revive it. */
+	pthread_mutex_lock(&shard->lock);
+
+	refcnt = __atomic_sub_fetch(&str->refcnt, 1, __ATOMIC_ACQ_REL);
+	if (refcnt != 0 && (refcnt != 1 || str->insensitive != str)) {
+		pthread_mutex_unlock(&shard->lock);
 		return;
+	}
 
 	*(str->prevptr) = str->next;
 
 	if (str->next != NULL)
 		str->next->prevptr = str->prevptr;
 
-	if (str->insensitive != NULL && str->refcnt == 0)
-		lwc_string_unref(str->insensitive);
+	shard->stringcount--;
+	lwc__maintain(shard);
+
+	insensitive = (refcnt == 0) ? str->insensitive : NULL;
+	size = LWC_STRING_SIZE(str->len);
 
 #ifndef NDEBUG
 	memset(str, 0xA5, sizeof(*str) + str->len);
 #endif
 
-	LWC_FREE(str);
+	lwc__string_free(shard, str, size);
+
+	pthread_mutex_unlock(&shard->lock);
+
+	/* Only after dropping the lock, as the caseless copy may well be
+	 * in the same shard. */
+	if (insensitive != NULL)
+		lwc_string_unref(insensitive);
 }
 
 /**** Shonky caseless bits ****/
@@ -220,52 +967,106 @@ lwc__dolower(const char c)
 	return c;
 }
 
-static inline lwc_hash
-lwc__calculate_lcase_hash(const char *str, size_t len)
+/**
+ * Compare lower case \a s1 with \a s2 as if \a s2 were lower cased.
+ */
+static int
+lwc__lcase_memcmp(const void *s1, const void *s2, size_t n)
 {
-	lwc_hash z = 0x811c9dc5;
+	const char *p1 = s1, *p2 = s2;
 
-	while (len > 0) {
-		z *= 0x01000193;
-		z ^= lwc__dolower(*str++);
-		len--;
+	for (; n >= 8; p1 += 8, p2 += 8, n -= 8) {
+		if (lwc__load64(p1) != lwc__lower_word(lwc__load64(p2)))
+			return 1;
 	}
 
-	return z;
-}
-
-static int
-lwc__lcase_strncmp(const char *s1, const char *s2, size_t n)
-{
 	while (n--) {
-		if (*s1++ != lwc__dolower(*s2++))
+		if (*p1++ != lwc__dolower(*p2++))
 			/** @todo Test this somehow? */
 			return 1;
 	}
 	return 0;
 }
 
-static void
-lwc__lcase_memcpy(char *target, const char *source, size_t n)
+static void *
+lwc__lcase_memcpy(void *target, const void *source, size_t n)
 {
+	char *t = target;
+	const char *s = source;
+	uint64_t w;
+
+	for (; n >= 8; t += 8, s += 8, n -= 8) {
+		w = lwc__lower_word(lwc__load64(s));
+		memcpy(t, &w, sizeof(w));
+	}
+
 	while (n--) {
-		*target++ = lwc__dolower(*source++);
+		*t++ = lwc__dolower(*s++);
 	}
+
+	return target;
 }
 
 lwc_error
 lwc__intern_caseless_string(lwc_string *str)
 {
+	lwc_string *insensitive, *expected = NULL;
+	lwc_error error;
+
 	//assert(str);
-	//assert(str->insensitive == NULL);
-	if (str == NULL || str->insensitive != NULL)
+	if (str == NULL)
 		return lwc_error_bad_param;
 
-	return lwc__intern(CSTR_OF(str),
-			   str->len, &(str->insensitive),
-			   lwc__calculate_lcase_hash,
-			   lwc__lcase_strncmp,
-			   lwc__lcase_memcpy);
+	/* Another thread may have got here first; that is fine. */
+	if (__atomic_load_n(&str->insensitive, __ATOMIC_ACQUIRE) != NULL)
+		return lwc_error_ok;
+
+	if (str->lcase) {
+		/* Already lower case, so it is its own caseless copy; no
+		 * need to look it up. */
+		insensitive = lwc_string_ref(str);
+	} else {
+		/* The caseless copy lives alongside the string, whichever
+		 * context is current. */
+		error = lwc__intern(str->ctx, CSTR_OF(str), str->len,
+				    str->lcase_hash, str->lcase_hash, true,
+				    &insensitive,
+				    lwc__lcase_memcmp,
+				    lwc__lcase_memcpy);
+		if (error != lwc_error_ok)
+			return error;
+	}
+
+	if (__atomic_compare_exchange_n(&str->insensitive, &expected,
+			insensitive, false,
+			__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) == false) {
+		/* Lost the race; drop the reference we just took. */
+		lwc_string_unref(insensitive);
+	}
+
+	return lwc_error_ok;
+}
+
+bool
+lwc__string_caseless_match(const lwc_string *str1, const lwc_string *str2)
+{
+	const char *p1 = CSTR_OF(str1), *p2 = CSTR_OF(str2);
+	size_t n = str1->len;
+
+	assert(str1->len == str2->len);
+
+	for (; n >= 8; p1 += 8, p2 += 8, n -= 8) {
+		if (lwc__lower_word(lwc__load64(p1)) !=
+				lwc__lower_word(lwc__load64(p2)))
+			return false;
+	}
+
+	while (n--) {
+		if (lwc__dolower(*p1++) != lwc__dolower(*p2++))
+			return false;
+	}
+
+	return true;
 }
 
 /**** Iteration ****/
@@ -274,13 +1075,134 @@ void
 lwc_iterate_strings(lwc_iteration_callback_fn cb, void *pw)
 {
 	lwc_hash n;
+	lwc_context *ctx;
 	lwc_string *str;
+	int i;
 
-	if (ctx == NULL)
+	if (lwc__current_context(&ctx) != lwc_error_ok)
 		return;
 
-	for (n = 0; n < ctx->bucketcount; ++n) {
-		for (str = ctx->buckets[n]; str != NULL; str = str->next)
-			cb(str, pw);
+	for (i = 0; i < NR_SHARDS; i++) {
+		lwc_shard *shard = &ctx->shards[i];
+
+		pthread_mutex_lock(&shard->lock);
+
+		for (n = 0; n < shard->bucketcount; ++n) {
+			for (str = shard->buckets[n]; str != NULL;
+					str = str->next)
+				cb(str, pw);
+		}
+
+		for (n = shard->rehashidx; n < shard->oldbucketcount; ++n) {
+			for (str = shard->oldbuckets[n]; str != NULL;
+					str = str->next)
+				cb(str, pw);
+		}
+
+		pthread_mutex_unlock(&shard->lock);
+	}
+}
+
+/**** Slab usage ****/
+
+lwc_error
+lwc_get_slab_usage(lwc_slab_usage *usage)
+{
+	lwc_context *ctx;
+	lwc_error eret;
+	int i, cls;
+
+	if (usage == NULL)
+		return lwc_error_bad_param;
+
+	eret = lwc__current_context(&ctx);
+	if (eret != lwc_error_ok)
+		return eret;
+
+	memset(usage, 0, sizeof(*usage));
+	usage->slab_size = LWC_SLAB_SIZE;
+
+	for (cls = 0; cls < LWC_SLAB_CLASSES; cls++)
+		usage->classes[cls].object_size = LWC_SLAB_CLASS_SIZE(cls);
+
+	for (i = 0; i < NR_SHARDS; i++) {
+		lwc_shard *shard = &ctx->shards[i];
+
+		pthread_mutex_lock(&shard->lock);
+
+		for (cls = 0; cls < LWC_SLAB_CLASSES; cls++) {
+			usage->classes[cls].slabs += shard->slabs[cls].slabs;
+			usage->classes[cls].used += shard->slabs[cls].used;
+			usage->classes[cls].capacity +=
+					shard->slabs[cls].slabs *
+					LWC_SLAB_CAPACITY(cls);
+		}
+
+		usage->large_strings += shard->largecount;
+		usage->large_bytes += shard->largebytes;
+
+		pthread_mutex_unlock(&shard->lock);
+	}
+
+	return lwc_error_ok;
+}
+
+/**** Statistics ****/
+
+/**
+ * Add one hash chain to the statistics.
+ */
+static void
+lwc__stats_chain(lwc_stats *stats, lwc_string *str)
+{
+	size_t length = 0;
+
+	for (; str != NULL; str = str->next) {
+		length++;
+		stats->bytes += LWC_STRING_SIZE(str->len);
+		if (str->insensitive != NULL && str->insensitive != str)
+			stats->caseless_twins++;
 	}
+
+	stats->strings += length;
+	stats->buckets++;
+	stats->chains[length < LWC_STATS_CHAIN_LENGTHS ?
+			length : LWC_STATS_CHAIN_LENGTHS - 1]++;
+}
+
+lwc_error
+lwc_get_stats(lwc_stats *stats)
+{
+	lwc_context *ctx;
+	lwc_error eret;
+	lwc_hash n;
+	int i;
+
+	if (stats == NULL)
+		return lwc_error_bad_param;
+
+	eret = lwc__current_context(&ctx);
+	if (eret != lwc_error_ok)
+		return eret;
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (i = 0; i < NR_SHARDS; i++) {
+		lwc_shard *shard = &ctx->shards[i];
+
+		pthread_mutex_lock(&shard->lock);
+
+		for (n = 0; n < shard->bucketcount; ++n)
+			lwc__stats_chain(stats, shard->buckets[n]);
+
+		for (n = shard->rehashidx; n < shard->oldbucketcount; ++n)
+			lwc__stats_chain(stats, shard->oldbuckets[n]);
+
+		stats->hits += shard->hits;
+		stats->misses += shard->misses;
+
+		pthread_mutex_unlock(&shard->lock);
+	}
+
+	return lwc_error_ok;
 }
@@ -212,6 +212,7 @@ static css_select_handler select_handler = {
 int main(int argc, char **argv)
 {
     char *data = NULL;
+    char *file_name = NULL;
 
     if (argc >= 2)
     {
@@ -219,25 +220,9 @@ int main(int argc, char **argv)
         {
             if (strncmp(argv[i], "file=", 5) == 0)
             {
-                char *file_name = argv[i] + 5;
+                file_name = argv[i] + 5;
                 printf("File: %s\n", file_name);
 
-                FILE *fp;
-                fp = fopen( file_name , "rt" );
-                if (!fp) perror(file_name), exit(1);
-
-                fseek( fp , 0L , SEEK_END);
-                long lSize = ftell( fp ) - 1;
-                rewind( fp );
-                data = calloc( 1, lSize+1 );
-                assert(data != NULL);
-                memset(data, 0, lSize+1);
-                if (!data) fclose(fp), fputs("memory alloc fails",stderr), exit(1);
-                if (1 != fread( data , lSize, 1 , fp))
-                    fclose(fp), free(data), fputs("entire read fails",stderr), exit(1);
-
-                fclose(fp);
-
                 break;
             }
             else if (strncmp(argv[i], "data=", 5) == 0)
@@ -253,14 +238,14 @@ int main(int argc, char **argv)
         return 0;
     }
 
-    if (data == NULL)
+    if (data == NULL && file_name == NULL)
     {
         printf("Bad input data!\n");
         return 0;
     }
 
-    size_t data_size = strlen(data);
-    printf("INPUT DATA [len: %zu]: %s\n", data_size, data);
+    if (data != NULL)
+        printf("INPUT DATA [len: %zu]: %s\n", strlen(data), data);
 
     css_stylesheet_params params;
     params.params_version = CSS_STYLESHEET_PARAMS_VERSION_1;
@@ -291,11 +276,21 @@ int main(int argc, char **argv)
     printf("created stylesheet, size %zu\n", size);
 
     /* parse some CSS source */
-    code = css_stylesheet_append_data(sheet, (const uint8_t *) data,
-            data_size);
-    free(data);
-    if (code != CSS_OK && code != CSS_NEEDDATA)
-        die("css_stylesheet_append_data", code);
+    if (file_name != NULL)
+    {
+        /* the file is mapped and parsed in place */
+        code = css_stylesheet_append_file(sheet, file_name);
+        if (code != CSS_OK && code != CSS_NEEDDATA)
+            die("css_stylesheet_append_file", code);
+    }
+    else
+    {
+        code = css_stylesheet_append_data(sheet, (const uint8_t *) data,
+                strlen(data));
+        free(data);
+        if (code != CSS_OK && code != CSS_NEEDDATA)
+            die("css_stylesheet_append_data", code);
+    }
     printf("[DEBUG] data successfully appended\n");
     code = css_stylesheet_data_done(sheet);
     if (code != CSS_OK)
@@ -0,0 +1,245 @@
+/*
+ * Test that stylesheets parse the same under a non-default libwapcaplet
+ * intern context as under the default one.
+ *
+ * Usage: test_contexts
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcss/libcss.h>
+
+#include "../libcss/src/stylesheet.h"
+
+/* Enough rules for a parallel parse to use several threads */
+#define RULES (20000)
+
+static const char *css =
+	"a{color:red;width:10px;z-index:3}b{display:block}";
+
+static css_error resolve_url(void *pw, const char *base, lwc_string *rel,
+		lwc_string **abs)
+{
+	(void) pw;
+	(void) base;
+
+	*abs = lwc_string_ref(rel);
+
+	return CSS_OK;
+}
+
+/**
+ * Parse the test stylesheet in the calling thread's current context
+ *
+ * \param ctx  Name of the context, for messages
+ * \return Number of failures
+ */
+static int parse_in_current_context(const char *ctx)
+{
+	css_stylesheet_params params;
+	css_stylesheet *sheet;
+	css_rule *rule;
+	css_error error;
+	int rules = 0, failures = 0;
+
+	memset(&params, 0, sizeof(params));
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_1;
+	params.level = CSS_LEVEL_DEFAULT;
+	params.charset = "UTF-8";
+	params.url = "foo";
+	params.title = "foo";
+	params.resolve = resolve_url;
+
+	error = css_stylesheet_create(&params, &sheet);
+	if (error != CSS_OK) {
+		printf("%s: css_stylesheet_create: %s\n", ctx,
+				css_error_to_string(error));
+		return 1;
+	}
+
+	error = css_stylesheet_append_data(sheet,
+			(const uint8_t *) css, strlen(css));
+	if (error == CSS_OK || error == CSS_NEEDDATA)
+		error = css_stylesheet_data_done(sheet);
+	if (error != CSS_OK) {
+		printf("%s: parse: %s\n", ctx, css_error_to_string(error));
+		css_stylesheet_destroy(sheet);
+		return 1;
+	}
+
+	for (rule = sheet->rule_list; rule != NULL; rule = rule->next) {
+		css_rule_selector *s = (css_rule_selector *) rule;
+
+		if (rule->type != CSS_RULE_SELECTOR)
+			continue;
+
+		rules++;
+
+		if (s->style == NULL || s->style->used == 0) {
+			printf("%s: rule %d has no declarations\n", ctx, rules);
+			failures++;
+		}
+	}
+
+	if (rules != 2) {
+		printf("%s: expected 2 rules, got %d\n", ctx, rules);
+		failures++;
+	}
+
+	css_stylesheet_destroy(sheet);
+
+	return failures;
+}
+
+/**
+ * Compare a string from the default context with its copy in another
+ *
+ * \param tenant  The other context
+ * \return Number of failures
+ */
+static int compare_across_contexts(lwc_context *tenant)
+{
+	lwc_string *a, *b, *upper;
+	bool match;
+	int failures = 0;
+
+	if (lwc_intern_string("woff", 4, &a) != lwc_error_ok)
+		return 1;
+
+	lwc_context_select(tenant);
+	if (lwc_intern_string("woff", 4, &b) != lwc_error_ok ||
+			lwc_intern_string("WOFF", 4, &upper) != lwc_error_ok) {
+		lwc_context_select(NULL);
+		return 1;
+	}
+	lwc_context_select(NULL);
+
+	if (lwc_string_isequal(a, b, &match) != lwc_error_ok || !match) {
+		printf("isequal: copies in two contexts differ\n");
+		failures++;
+	}
+
+	if (lwc_string_isequal(a, upper, &match) != lwc_error_ok || match) {
+		printf("isequal: woff and WOFF match\n");
+		failures++;
+	}
+
+	if (lwc_string_caseless_isequal(a, upper, &match) != lwc_error_ok ||
+			!match) {
+		printf("caseless_isequal: woff and WOFF differ\n");
+		failures++;
+	}
+
+	lwc_string_unref(a);
+	lwc_string_unref(b);
+	lwc_string_unref(upper);
+
+	return failures;
+}
+
+/**
+ * Parse a large stylesheet on several threads under another context
+ *
+ * \param tenant  The context to parse under
+ * \return Number of failures
+ *
+ * Every string in the sheet is new, so any interned by the parsing
+ * threads into the default context show up in its statistics.
+ */
+static int parse_parallel_in_context(lwc_context *tenant)
+{
+	css_stylesheet_params params;
+	css_stylesheet *sheet;
+	lwc_stats before, after;
+	css_error error;
+	char *data;
+	size_t len = 0;
+	int i, failures = 0;
+
+	data = malloc(RULES * 32);
+	if (data == NULL)
+		return 1;
+
+	for (i = 0; i < RULES; i++)
+		len += sprintf(data + len, ".tenant%d{color:red}", i);
+
+	memset(&params, 0, sizeof(params));
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_1;
+	params.level = CSS_LEVEL_DEFAULT;
+	params.charset = "UTF-8";
+	params.url = "foo";
+	params.title = "foo";
+	params.resolve = resolve_url;
+
+	if (lwc_get_stats(&before) != lwc_error_ok) {
+		free(data);
+		return 1;
+	}
+
+	lwc_context_select(tenant);
+
+	error = css_stylesheet_create(&params, &sheet);
+	if (error == CSS_OK) {
+		error = css_stylesheet_append_data_parallel(sheet,
+				(const uint8_t *) data, len, 4);
+		if (error == CSS_OK || error == CSS_NEEDDATA)
+			error = css_stylesheet_data_done(sheet);
+		if (error != CSS_OK) {
+			printf("parallel: parse: %s\n",
+					css_error_to_string(error));
+			failures++;
+		}
+		css_stylesheet_destroy(sheet);
+	} else {
+		printf("parallel: css_stylesheet_create: %s\n",
+				css_error_to_string(error));
+		failures++;
+	}
+
+	lwc_context_select(NULL);
+
+	if (lwc_get_stats(&after) != lwc_error_ok) {
+		free(data);
+		return 1;
+	}
+
+	if (after.misses != before.misses) {
+		printf("parallel: %llu strings interned in default context\n",
+				(unsigned long long)
+					(after.misses - before.misses));
+		failures++;
+	}
+
+	free(data);
+
+	return failures;
+}
+
+int main(void)
+{
+	lwc_context *tenant;
+	int failures = 0;
+
+	failures += parse_in_current_context("default");
+
+	if (lwc_context_create(&tenant) != lwc_error_ok) {
+		printf("lwc_context_create failed\n");
+		return EXIT_FAILURE;
+	}
+
+	failures += compare_across_contexts(tenant);
+
+	lwc_context_select(tenant);
+	failures += parse_in_current_context("tenant");
+	lwc_context_select(NULL);
+
+	failures += parse_parallel_in_context(tenant);
+
+	lwc_context_destroy(tenant);
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
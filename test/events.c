@@ -0,0 +1,236 @@
+/*
+ * Test the event parser: the order of events, the text of tokens and
+ * skipping rules or aborting the parse from the handler.
+ *
+ * Usage: test_events
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcss/libcss.h>
+#include <libcss/events.h>
+
+/* Record of the events seen, one line per event */
+typedef struct event_log {
+	char text[4096];
+	size_t len;
+	const char *skip;	/**< Skip rules whose prelude starts so */
+	css_error result;	/**< Result for the rules to skip */
+} event_log;
+
+static const char *event_names[] = {
+	"START_STYLESHEET", "END_STYLESHEET", "START_RULESET", "END_RULESET",
+	"START_ATRULE", "END_ATRULE", "START_BLOCK", "END_BLOCK",
+	"BLOCK_CONTENT", "DECLARATION"
+};
+
+static const char *token_names[] = {
+	"IDENT", "ATKEYWORD", "HASH", "FUNCTION", "STRING", "URI",
+	"INVALID_STRING", "UNICODE_RANGE", "CHAR", "NUMBER", "PERCENTAGE",
+	"DIMENSION", "CDO", "CDC", "S", "COMMENT", "INCLUDES", "DASHMATCH",
+	"PREFIXMATCH", "SUFFIXMATCH", "SUBSTRINGMATCH", "EOF"
+};
+
+static void log_append(event_log *log, const char *text, size_t len)
+{
+	if (len > sizeof(log->text) - log->len - 1)
+		len = sizeof(log->text) - log->len - 1;
+
+	memcpy(log->text + log->len, text, len);
+	log->len += len;
+	log->text[log->len] = '\0';
+}
+
+static css_error handler(void *pw, css_event_type type,
+		const css_event_token *tokens, size_t n_tokens)
+{
+	event_log *log = pw;
+	size_t i;
+
+	log_append(log, event_names[type], strlen(event_names[type]));
+
+	for (i = 0; i < n_tokens; i++) {
+		if (tokens[i].type == CSS_EVENT_TOKEN_S)
+			continue;
+
+		log_append(log, " ", 1);
+		log_append(log, token_names[tokens[i].type],
+				strlen(token_names[tokens[i].type]));
+
+		if (tokens[i].data != NULL) {
+			log_append(log, ":", 1);
+			log_append(log, (const char *) tokens[i].data,
+					tokens[i].len);
+		}
+	}
+
+	log_append(log, "\n", 1);
+
+	if ((type == CSS_EVENT_START_RULESET ||
+			type == CSS_EVENT_START_ATRULE) && log->skip != NULL) {
+		/* An empty string matches a rule without a prelude */
+		if (n_tokens == 0 && log->skip[0] == '\0')
+			return log->result;
+
+		if (n_tokens > 0 && tokens[0].data != NULL &&
+				tokens[0].len == strlen(log->skip) &&
+				memcmp(tokens[0].data, log->skip,
+					tokens[0].len) == 0)
+			return log->result;
+	}
+
+	return CSS_OK;
+}
+
+/**
+ * Parse some data with the event parser and check the events seen
+ *
+ * \param name          Name of the test, for messages
+ * \param data          Stylesheet to parse
+ * \param inline_style  Whether \a data is an inline style
+ * \param skip          Start of the prelude of rules to skip, or NULL
+ * \param result        Handler's result for the rules to skip
+ * \param parse_result  Expected result of the parse
+ * \param expected      Expected event log
+ * \return Number of failures
+ */
+static int check(const char *name, const char *data, bool inline_style,
+		const char *skip, css_error result, css_error parse_result,
+		const char *expected)
+{
+	css_event_parser_params params;
+	css_event_parser *parser;
+	event_log log;
+	css_error error;
+
+	log.len = 0;
+	log.text[0] = '\0';
+	log.skip = skip;
+	log.result = result;
+
+	memset(&params, 0, sizeof(params));
+	params.params_version = CSS_EVENT_PARSER_PARAMS_VERSION_1;
+	params.charset = "UTF-8";
+	params.inline_style = inline_style;
+	params.handler = handler;
+	params.handler_pw = &log;
+
+	error = css_event_parser_create(&params, &parser);
+	if (error != CSS_OK) {
+		printf("%s: css_event_parser_create: %s\n", name,
+				css_error_to_string(error));
+		return 1;
+	}
+
+	error = css_event_parser_append_data(parser,
+			(const uint8_t *) data, strlen(data));
+	if (error == CSS_OK || error == CSS_NEEDDATA)
+		error = css_event_parser_data_done(parser);
+
+	css_event_parser_destroy(parser);
+
+	if (error != parse_result) {
+		printf("%s: parse: %s\n", name, css_error_to_string(error));
+		return 1;
+	}
+
+	if (strcmp(log.text, expected) != 0) {
+		printf("%s: expected:\n%s" "got:\n%s", name, expected,
+				log.text);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	int failures = 0;
+
+	failures += check("order",
+		"a{color:red}@media print{b{c:d}}",
+		false, NULL, CSS_INVALID, CSS_OK,
+		"START_STYLESHEET\n"
+		"START_RULESET IDENT:a\n"
+		"DECLARATION IDENT:color CHAR:: IDENT:red\n"
+		"END_RULESET\n"
+		"START_ATRULE ATKEYWORD:media IDENT:print\n"
+		"START_BLOCK\n"
+		"BLOCK_CONTENT IDENT:b\n"
+		"START_BLOCK\n"
+		"BLOCK_CONTENT IDENT:c CHAR:: IDENT:d\n"
+		"END_BLOCK\n"
+		"BLOCK_CONTENT\n"
+		"END_BLOCK\n"
+		"END_ATRULE\n"
+		"END_STYLESHEET\n");
+
+	failures += check("tokens",
+		"#x{background:url(a.png) #fff;width:10px}",
+		false, NULL, CSS_INVALID, CSS_OK,
+		"START_STYLESHEET\n"
+		"START_RULESET HASH:x\n"
+		"DECLARATION IDENT:background CHAR:: URI:a.png HASH:fff\n"
+		"DECLARATION IDENT:width CHAR:: DIMENSION:10px\n"
+		"END_RULESET\n"
+		"END_STYLESHEET\n");
+
+	/* A skipped ruleset reports no declarations and does not end */
+	failures += check("skip",
+		"a{color:red}b{color:blue}",
+		false, "a", CSS_INVALID, CSS_OK,
+		"START_STYLESHEET\n"
+		"START_RULESET IDENT:a\n"
+		"START_RULESET IDENT:b\n"
+		"DECLARATION IDENT:color CHAR:: IDENT:blue\n"
+		"END_RULESET\n"
+		"END_STYLESHEET\n");
+
+	/* Any other result stops the parse at the event that returned it */
+	failures += check("abort ruleset",
+		"a{color:red}b{color:blue}c{color:green}",
+		false, "b", CSS_NOMEM, CSS_NOMEM,
+		"START_STYLESHEET\n"
+		"START_RULESET IDENT:a\n"
+		"DECLARATION IDENT:color CHAR:: IDENT:red\n"
+		"END_RULESET\n"
+		"START_RULESET IDENT:b\n");
+
+	failures += check("abort ruleset without selector",
+		"a{color:red}{color:blue}c{color:green}",
+		false, "", CSS_NOMEM, CSS_NOMEM,
+		"START_STYLESHEET\n"
+		"START_RULESET IDENT:a\n"
+		"DECLARATION IDENT:color CHAR:: IDENT:red\n"
+		"END_RULESET\n"
+		"START_RULESET\n");
+
+	failures += check("abort at-rule",
+		"@media print{b{c:d}}a{color:red}",
+		false, "media", CSS_BADPARM, CSS_BADPARM,
+		"START_STYLESHEET\n"
+		"START_ATRULE ATKEYWORD:media IDENT:print\n");
+
+	failures += check("inline",
+		"color:red;width:10px",
+		true, NULL, CSS_INVALID, CSS_OK,
+		"START_STYLESHEET\n"
+		"START_RULESET\n"
+		"DECLARATION IDENT:color CHAR:: IDENT:red\n"
+		"DECLARATION IDENT:width CHAR:: DIMENSION:10px\n"
+		"END_RULESET\n"
+		"END_STYLESHEET\n");
+
+	/* An inline style's ruleset can't be skipped, so that aborts too */
+	failures += check("abort inline",
+		"color:red;width:10px",
+		true, "", CSS_INVALID, CSS_INVALID,
+		"START_STYLESHEET\n"
+		"START_RULESET\n");
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
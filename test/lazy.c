@@ -0,0 +1,211 @@
+/*
+ * Test stylesheets whose rulesets are compiled on first use: how they
+ * treat invalid declarations, and compiling their rules on several
+ * threads at once.
+ *
+ * Usage: test_lazy
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcss/libcss.h>
+
+#include "../libcss/src/stylesheet.h"
+
+/* Rules in the sheet compiled concurrently */
+#define RULES (2000)
+
+/* Threads compiling them */
+#define THREADS (4)
+
+static css_error resolve_url(void *pw, const char *base, lwc_string *rel,
+		lwc_string **abs)
+{
+	(void) pw;
+	(void) base;
+
+	*abs = lwc_string_ref(rel);
+
+	return CSS_OK;
+}
+
+/**
+ * Parse a stylesheet
+ *
+ * \param data   Stylesheet to parse
+ * \param lazy   Whether to compile rulesets on first use
+ * \param sheet  Pointer to location to receive sheet
+ * \return Result of parsing
+ */
+static css_error parse(const char *data, bool lazy, css_stylesheet **sheet)
+{
+	css_stylesheet_params params;
+	css_error error;
+
+	memset(&params, 0, sizeof(params));
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_2;
+	params.level = CSS_LEVEL_DEFAULT;
+	params.charset = "UTF-8";
+	params.url = "foo";
+	params.title = "foo";
+	params.resolve = resolve_url;
+	params.lazy_styles = lazy;
+
+	error = css_stylesheet_create(&params, sheet);
+	if (error != CSS_OK)
+		return error;
+
+	error = css_stylesheet_append_data(*sheet,
+			(const uint8_t *) data, strlen(data));
+	if (error == CSS_OK || error == CSS_NEEDDATA)
+		error = css_stylesheet_data_done(*sheet);
+
+	return error;
+}
+
+/**
+ * Check how eager and lazy sheets treat an invalid declaration
+ *
+ * \return Number of failures
+ */
+static int invalid_declaration(void)
+{
+	const char *data = "a{width:x}b{color:red}";
+	css_stylesheet *sheet;
+	css_rule *rule;
+	css_error error;
+	int rules = 0, styles = 0, failures = 0;
+
+	/* Parsing eagerly fails at the invalid declaration */
+	error = parse(data, false, &sheet);
+	if (error != CSS_INVALID) {
+		printf("eager: expected CSS_INVALID, got %s\n",
+				css_error_to_string(error));
+		failures++;
+	}
+	css_stylesheet_destroy(sheet);
+
+	/* Parsing lazily keeps both rules, and only the second has a style
+	 * once they're compiled */
+	error = parse(data, true, &sheet);
+	if (error != CSS_OK) {
+		printf("lazy: parse: %s\n", css_error_to_string(error));
+		css_stylesheet_destroy(sheet);
+		return failures + 1;
+	}
+
+	for (rule = sheet->rule_list; rule != NULL; rule = rule->next) {
+		rules++;
+
+		error = css__stylesheet_rule_compile(sheet, rule);
+		if (error != CSS_OK) {
+			printf("lazy: compile: %s\n",
+					css_error_to_string(error));
+			failures++;
+		}
+
+		if (((css_rule_selector *) rule)->style != NULL)
+			styles++;
+	}
+
+	if (rules != 2 || styles != 1) {
+		printf("lazy: expected 2 rules and 1 style, got %d and %d\n",
+				rules, styles);
+		failures++;
+	}
+
+	css_stylesheet_destroy(sheet);
+
+	return failures;
+}
+
+static void *compile_rules(void *pw)
+{
+	css_stylesheet *sheet = pw;
+	css_rule *rule;
+
+	for (rule = sheet->rule_list; rule != NULL; rule = rule->next) {
+		if (css__stylesheet_rule_compile(sheet, rule) != CSS_OK)
+			return pw;
+	}
+
+	return NULL;
+}
+
+/**
+ * Compile a lazy sheet's rules on several threads at once
+ *
+ * \return Number of failures
+ */
+static int concurrent_compile(void)
+{
+	pthread_t threads[THREADS];
+	css_stylesheet *sheet;
+	css_rule *rule;
+	css_error error;
+	char *data;
+	size_t len = 0;
+	int i, styles = 0, failures = 0;
+
+	data = malloc(RULES * 48);
+	if (data == NULL)
+		return 1;
+
+	for (i = 0; i < RULES; i++)
+		len += sprintf(data + len,
+				".c%d{font-family:f%d;color:red}", i, i);
+
+	error = parse(data, true, &sheet);
+	free(data);
+	if (error != CSS_OK) {
+		printf("concurrent: parse: %s\n", css_error_to_string(error));
+		css_stylesheet_destroy(sheet);
+		return 1;
+	}
+
+	for (i = 0; i < THREADS; i++)
+		pthread_create(&threads[i], NULL, compile_rules, sheet);
+
+	for (i = 0; i < THREADS; i++) {
+		void *result;
+
+		pthread_join(threads[i], &result);
+		if (result != NULL) {
+			printf("concurrent: compile failed\n");
+			failures++;
+		}
+	}
+
+	for (rule = sheet->rule_list; rule != NULL; rule = rule->next) {
+		css_rule_selector *s = (css_rule_selector *) rule;
+
+		if (s->source == NULL && s->style != NULL &&
+				s->style->sheet == sheet)
+			styles++;
+	}
+
+	if (styles != RULES) {
+		printf("concurrent: %d of %d rules compiled\n", styles,
+				RULES);
+		failures++;
+	}
+
+	css_stylesheet_destroy(sheet);
+
+	return failures;
+}
+
+int main(void)
+{
+	int failures = 0;
+
+	failures += invalid_declaration();
+	failures += concurrent_compile();
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,275 @@
+/*
+ * Test that a stylesheet parsed on several threads is the same as one
+ * parsed sequentially.
+ *
+ * Usage: test_parallel
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcss/libcss.h>
+
+#include "../libcss/include/dump.h"
+
+/* Enough blocks of rules for a parallel parse to use several threads */
+#define BLOCKS (2000)
+#define THREADS (4)
+
+/* Rules that may only start a sheet, so are in the first segment */
+static const char *prologue =
+	"@charset \"UTF-8\";\n"
+	"@import url(\"first{.css\") screen;\n"
+	"@import 'second}.css';\n";
+
+/* Rules repeated throughout the sheet; braces in strings, comments and
+ * URLs must not be taken for the ends of rules */
+static const char *block =
+	"/* comment { with } braces %d */\n"
+	".a%d > p:first-child, #b%d .c[title=\"x{%d}\"] {"
+		"color:#%06x; content:\"}%d{\"; "
+		"background:url(img{%d}.png) no-repeat}\n"
+	"@media screen, print {.m%d{width:%dpx}/* } */a:hover{margin:0 1px}}\n"
+	"@font-face{font-family:\"F{%d}\";src:url(\"f}%d.woff\")}\n"
+	"@page :first{margin:%dpx}\n"
+	"a%d::after{content:'\\7B  \\}'}\n";
+
+/* Threads the URL resolver has been called from */
+static pthread_t threads[THREADS];
+static int n_threads;
+static pthread_mutex_t threads_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static css_error resolve_url(void *pw, const char *base, lwc_string *rel,
+		lwc_string **abs)
+{
+	pthread_t self = pthread_self();
+	int i;
+
+	(void) pw;
+	(void) base;
+
+	pthread_mutex_lock(&threads_lock);
+	for (i = 0; i < n_threads; i++) {
+		if (pthread_equal(threads[i], self))
+			break;
+	}
+	if (i == n_threads && n_threads < THREADS)
+		threads[n_threads++] = self;
+	pthread_mutex_unlock(&threads_lock);
+
+	*abs = lwc_string_ref(rel);
+
+	return CSS_OK;
+}
+
+/**
+ * Parse a stylesheet
+ *
+ * \param data      Data of the sheet
+ * \param len       Length, in bytes, of data
+ * \param parallel  Whether to parse on several threads
+ * \param sheet     Pointer to location to receive the sheet
+ * \return Number of failures
+ */
+static int parse(const char *data, size_t len, bool parallel,
+		css_stylesheet **sheet)
+{
+	const char *name = parallel ? "parallel" : "sequential";
+	css_stylesheet_params params;
+	css_error error;
+
+	memset(&params, 0, sizeof(params));
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_1;
+	params.level = CSS_LEVEL_DEFAULT;
+	params.charset = "UTF-8";
+	params.url = "foo";
+	params.title = "foo";
+	params.resolve = resolve_url;
+
+	error = css_stylesheet_create(&params, sheet);
+	if (error != CSS_OK) {
+		printf("%s: css_stylesheet_create: %s\n", name,
+				css_error_to_string(error));
+		return 1;
+	}
+
+	if (parallel)
+		error = css_stylesheet_append_data_parallel(*sheet,
+				(const uint8_t *) data, len, THREADS);
+	else
+		error = css_stylesheet_append_data(*sheet,
+				(const uint8_t *) data, len);
+	if (error == CSS_OK || error == CSS_NEEDDATA)
+		error = css_stylesheet_data_done(*sheet);
+
+	/* The imports are never fetched */
+	if (error != CSS_OK && error != CSS_IMPORTS_PENDING) {
+		printf("%s: parse: %s\n", name, css_error_to_string(error));
+		css_stylesheet_destroy(*sheet);
+		*sheet = NULL;
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Compare the specificity of two lists of selectors
+ *
+ * \param a      First list
+ * \param b      Second list
+ * \param items  Number of selectors in each
+ * \return True if they match, false otherwise
+ */
+static bool same_specificity(css_selector **a, css_selector **b,
+		uint32_t items)
+{
+	uint32_t i;
+
+	for (i = 0; i < items; i++) {
+		if (a[i]->specificity != b[i]->specificity)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Compare two lists of rules
+ *
+ * \param a  First rule of first list
+ * \param b  First rule of second list
+ * \return Number of failures
+ */
+static int compare_rules(css_rule *a, css_rule *b)
+{
+	for (; a != NULL && b != NULL; a = a->next, b = b->next) {
+		if (a->type != b->type || a->index != b->index ||
+				a->items != b->items) {
+			printf("rule %u: type %u, %u items; "
+					"rule %u: type %u, %u items\n",
+					a->index, a->type, a->items,
+					b->index, b->type, b->items);
+			return 1;
+		}
+
+		if (a->type == CSS_RULE_SELECTOR && same_specificity(
+				((css_rule_selector *) a)->selectors,
+				((css_rule_selector *) b)->selectors,
+				a->items) == false) {
+			printf("rule %u: specificity differs\n", a->index);
+			return 1;
+		}
+
+		if (a->type == CSS_RULE_PAGE &&
+				((css_rule_page *) a)->selector != NULL &&
+				((css_rule_page *) a)->selector->specificity !=
+				((css_rule_page *) b)->selector->specificity) {
+			printf("rule %u: specificity differs\n", a->index);
+			return 1;
+		}
+
+		if (a->type == CSS_RULE_MEDIA && compare_rules(
+				((css_rule_media *) a)->first_child,
+				((css_rule_media *) b)->first_child) != 0)
+			return 1;
+	}
+
+	if (a != NULL || b != NULL) {
+		printf("rule lists differ in length\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * Compare two parsed stylesheets
+ *
+ * \param a    First sheet
+ * \param b    Second sheet
+ * \param len  Length, in bytes, of the sheets' data
+ * \return Number of failures
+ *
+ * Segments parsed concurrently add their strings to the sheet in any
+ * order, so the rules' bytecode is compared with its strings resolved.
+ */
+static int compare_sheets(css_stylesheet *a, css_stylesheet *b, size_t len)
+{
+	size_t a_len = len * 8, b_len = len * 8;
+	char *a_dump, *b_dump;
+	int failures = 0;
+
+	if (a->rule_count != b->rule_count) {
+		printf("%u rules, %u rules\n", a->rule_count, b->rule_count);
+		return 1;
+	}
+
+	failures += compare_rules(a->rule_list, b->rule_list);
+
+	a_dump = calloc(1, a_len + 1);
+	b_dump = calloc(1, b_len + 1);
+	if (a_dump == NULL || b_dump == NULL) {
+		free(a_dump);
+		free(b_dump);
+		return failures + 1;
+	}
+
+	dump_sheet(a, a_dump, &a_len);
+	dump_sheet(b, b_dump, &b_len);
+
+	if (a_len != b_len || strcmp(a_dump, b_dump) != 0) {
+		printf("bytecode or strings differ\n");
+		failures++;
+	}
+
+	free(a_dump);
+	free(b_dump);
+
+	return failures;
+}
+
+int main(void)
+{
+	css_stylesheet *sequential = NULL, *parallel = NULL;
+	char *data;
+	size_t len;
+	int i, failures = 0;
+
+	data = malloc(strlen(prologue) + BLOCKS * (strlen(block) + 128));
+	if (data == NULL)
+		return EXIT_FAILURE;
+
+	len = sprintf(data, "%s", prologue);
+	for (i = 0; i < BLOCKS; i++) {
+		len += sprintf(data + len, block, i, i, i, i, i * 97, i, i,
+				i, i, i, i, i, i);
+	}
+
+	failures += parse(data, len, false, &sequential);
+
+	n_threads = 0;
+	failures += parse(data, len, true, &parallel);
+
+	/* Every segment resolves URLs, so more than one thread did */
+	if (n_threads < 2) {
+		printf("parallel: parsed on %d thread\n", n_threads);
+		failures++;
+	}
+
+	if (sequential != NULL && parallel != NULL)
+		failures += compare_sheets(sequential, parallel, len);
+
+	if (sequential != NULL)
+		css_stylesheet_destroy(sequential);
+	if (parallel != NULL)
+		css_stylesheet_destroy(parallel);
+
+	free(data);
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,324 @@
+/*
+ * Test that the pre-scanner finds the same top-level rules as the lexer's
+ * tokens describe.
+ *
+ * Usage: test_prescan
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcss/libcss.h>
+
+#include "../libcss/src/charset/detect.h"
+#include "../libcss/src/lex/lex.h"
+#include "../libcss/src/lex/prescan.h"
+
+/* Deepest nesting of brackets tracked, as by the pre-scanner */
+#define MAX_DEPTH (256)
+
+/* Most rules in any test case */
+#define MAX_RULES (1024)
+
+static const char *cases[] = {
+	"a{color:red}b{}",
+	/* Braces in strings */
+	"a{content:\"}\"}b{content:'{'}c[title=\"{\"]{}",
+	/* Braces in comments */
+	"/* { */a{/*}*/color:red}/* } */b{}",
+	/* url() with and without quotes, and "url(" as a function */
+	"a{background:url({.png)}b{background:url( \"}\" )}"
+		"c{background:url('{')}d{background:url(x y)}",
+	"a{b:xurl(})}c{}",
+	"a{b:#url(})}c{}",
+	/* Escapes */
+	"a\\{{color:red}b{content:\"\\\"}\"}c\\\"{}d\\7B {}",
+	"a{b:\\\n}c{}",
+	/* Unterminated strings and comments */
+	"a{content:\"abc}\n}b{}",
+	"a{content:'abc}",
+	"a{}/* b{}",
+	"a{b:url(\"}\n)}c{}",
+	/* Unbalanced brackets */
+	"a{)}b{}",
+	"a{]}",
+	"}a{}",
+	"a{(}",
+	"a{[}]b{}",
+	"a{}b{c{}",
+	/* At-rules, with and without blocks */
+	"@import \"x{\";@media print{a{}b{}}@font-face{src:url(})}"
+		"@page{margin:0}@charset 'y}';",
+	"a;b{}@x;c{}",
+	/* Comment delimiters of HTML */
+	"<!-- a{} --> b{}",
+};
+
+/**
+ * Find the top-level rules in some data from the lexer's tokens
+ *
+ * \param data     Data to scan
+ * \param len      Length, in bytes, of data
+ * \param rules    Array to receive the rules
+ * \param n_rules  Pointer to location to receive number of rules
+ * \return CSS_OK on success,
+ *         CSS_INVALID if the data's brackets are unbalanced,
+ *         appropriate error otherwise
+ *
+ * The offset of each token is the length of the input the lexer has
+ * captured before reaching it.
+ */
+static css_error lex_rules(const uint8_t *data, size_t len,
+		css_prescan_rule *rules, size_t *n_rules)
+{
+	parserutils_inputstream *stream;
+	parserutils_buffer *capture;
+	css_lexer *lexer;
+	css_lexer_optparams params;
+	css_token *token;
+	char closers[MAX_DEPTH];
+	size_t depth = 0, start = 0, block = 0;
+	bool started = false, at_rule = false;
+	css_error error;
+
+	*n_rules = 0;
+
+	if (parserutils_inputstream_create("UTF-8", CSS_CHARSET_DICTATED,
+			css__charset_extract, &stream) != PARSERUTILS_OK)
+		return CSS_NOMEM;
+
+	if (parserutils_buffer_create(&capture) != PARSERUTILS_OK) {
+		parserutils_inputstream_destroy(stream);
+		return CSS_NOMEM;
+	}
+
+	error = css__lexer_create(stream, &lexer);
+	if (error != CSS_OK) {
+		parserutils_buffer_destroy(capture);
+		parserutils_inputstream_destroy(stream);
+		return error;
+	}
+
+	/* Comments are reported, so that they aren't part of the next
+	 * token's input */
+	params.emit_comments = true;
+	css__lexer_setopt(lexer, CSS_LEXER_EMIT_COMMENTS, &params);
+	css__lexer_capture(lexer, capture);
+
+	parserutils_inputstream_append(stream, data, len);
+	parserutils_inputstream_append(stream, NULL, 0);
+
+	while ((error = css__lexer_get_token(lexer, &token)) == CSS_OK &&
+			token->type != CSS_TOKEN_EOF) {
+		size_t offset = capture->length;
+		char c = (token->type == CSS_TOKEN_CHAR) ?
+				token->data.data[0] : '\0';
+
+		/* Space, comments and CDO and CDC between rules belong to
+		 * none of them */
+		if (started == false) {
+			if (token->type == CSS_TOKEN_S ||
+					token->type == CSS_TOKEN_COMMENT ||
+					token->type == CSS_TOKEN_CDO ||
+					token->type == CSS_TOKEN_CDC)
+				continue;
+
+			started = true;
+			start = offset;
+			block = 0;
+			at_rule = (token->type == CSS_TOKEN_ATKEYWORD);
+		}
+
+		if (token->type == CSS_TOKEN_FUNCTION || c == '(' ||
+				c == '[' || c == '{') {
+			if (depth == MAX_DEPTH) {
+				error = CSS_INVALID;
+				break;
+			}
+
+			if (depth == 0 && c == '{')
+				block = offset;
+
+			closers[depth++] = (c == '[') ? ']' :
+					(c == '{') ? '}' : ')';
+		} else if (c == ')' || c == ']' || c == '}') {
+			if (depth == 0 || closers[depth - 1] != c) {
+				error = CSS_INVALID;
+				break;
+			}
+
+			if (--depth == 0 && c == '}') {
+				rules[*n_rules].start = start;
+				rules[*n_rules].block = block;
+				rules[*n_rules].end = offset + 1;
+				(*n_rules)++;
+				started = false;
+			}
+		} else if (c == ';' && depth == 0 && at_rule) {
+			rules[*n_rules].start = start;
+			rules[*n_rules].block = offset + 1;
+			rules[*n_rules].end = offset + 1;
+			(*n_rules)++;
+			started = false;
+		}
+
+		if (*n_rules == MAX_RULES) {
+			error = CSS_NOMEM;
+			break;
+		}
+	}
+
+	css__lexer_destroy(lexer);
+	parserutils_buffer_destroy(capture);
+	parserutils_inputstream_destroy(stream);
+
+	return error;
+}
+
+/**
+ * Compare the pre-scanner's rules with the lexer's for some data
+ *
+ * \param name  Name of the test, for messages
+ * \param data  Data to scan
+ * \param len   Length, in bytes, of data
+ * \return Number of failures
+ */
+static int check(const char *name, const uint8_t *data, size_t len)
+{
+	static css_prescan_rule expected[MAX_RULES];
+	css_prescan_rule *rules;
+	size_t n_expected, n_rules, i;
+	css_error lex_error, error;
+	int failures = 0;
+
+	lex_error = lex_rules(data, len, expected, &n_expected);
+	if (lex_error != CSS_OK && lex_error != CSS_INVALID) {
+		printf("%s (%zu bytes): lexer: %s\n", name, len,
+				css_error_to_string(lex_error));
+		return 1;
+	}
+
+	error = css__prescan(data, len, &rules, &n_rules);
+	if (error != lex_error) {
+		printf("%s (%zu bytes): expected %s, got %s\n", name, len,
+				css_error_to_string(lex_error),
+				css_error_to_string(error));
+		failures++;
+	}
+
+	if (n_rules != n_expected) {
+		printf("%s (%zu bytes): expected %zu rules, got %zu\n",
+				name, len, n_expected, n_rules);
+		failures++;
+	}
+
+	for (i = 0; i < n_rules && i < n_expected; i++) {
+		if (rules[i].start != expected[i].start ||
+				rules[i].block != expected[i].block ||
+				rules[i].end != expected[i].end) {
+			printf("%s (%zu bytes): rule %zu: expected "
+					"%zu-%zu-%zu, got %zu-%zu-%zu\n",
+					name, len, i, expected[i].start,
+					expected[i].block, expected[i].end,
+					rules[i].start, rules[i].block,
+					rules[i].end);
+			failures++;
+			break;
+		}
+	}
+
+	free(rules);
+
+	return failures;
+}
+
+/**
+ * Determine whether some data is balanced and ends with a rule
+ *
+ * \param data  Data to consider
+ * \return True if it is, false otherwise
+ */
+static bool complete(const char *data)
+{
+	css_prescan_rule *rules;
+	size_t n_rules, len = strlen(data);
+	bool result;
+
+	if (css__prescan((const uint8_t *) data, len, &rules,
+			&n_rules) != CSS_OK)
+		return false;
+
+	result = (n_rules > 0 && rules[n_rules - 1].end == len);
+
+	free(rules);
+
+	return result;
+}
+
+/**
+ * Check every prefix of some data, after some whitespace
+ *
+ * \param name   Name of the test, for messages
+ * \param data   Data to scan
+ * \param shift  Number of spaces to precede the data with
+ * \return Number of failures
+ *
+ * The prefixes end at every offset within the pre-scanner's blocks, and
+ * the spaces move the data's structural bytes to every offset in them.
+ */
+static int check_prefixes(const char *name, const char *data, size_t shift)
+{
+	size_t len = shift + strlen(data), i;
+	uint8_t *buf;
+	int failures = 0;
+
+	buf = malloc(len);
+	if (buf == NULL)
+		return 1;
+
+	memset(buf, ' ', shift);
+	memcpy(buf + shift, data, len - shift);
+
+	for (i = 0; i <= len && failures == 0; i++)
+		failures += check(name, buf, i);
+
+	free(buf);
+
+	return failures;
+}
+
+int main(void)
+{
+	size_t n_cases = sizeof(cases) / sizeof(cases[0]), i, shift;
+	char *all;
+	size_t len = 0;
+	int failures = 0;
+
+	for (i = 0; i < n_cases; i++) {
+		for (shift = 0; shift <= 64; shift++)
+			failures += check_prefixes(cases[i], cases[i], shift);
+	}
+
+	/* The balanced cases together span several blocks of data */
+	for (i = 0; i < n_cases; i++)
+		len += strlen(cases[i]);
+
+	all = malloc(len + 1);
+	if (all == NULL)
+		return EXIT_FAILURE;
+
+	all[0] = '\0';
+	for (i = 0; i < n_cases; i++) {
+		if (complete(cases[i]))
+			strcat(all, cases[i]);
+	}
+
+	failures += check_prefixes("all", all, 0);
+
+	free(all);
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,821 @@
+/*
+ * Test that selecting against a stylesheet whose rulesets are compiled on
+ * first use computes the same styles as against one compiled eagerly, on
+ * one thread and on several at once.
+ *
+ * Usage: test_select
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcss/libcss.h>
+
+/* Rules in the sheet, and distinct classes of element selected for */
+#define RULES (2000)
+
+/* Elements of the document with a class; each has two children */
+#define DIVS (500)
+
+/* Elements of the document: html, body, and the divs with children */
+#define NODES (2 + DIVS * 3)
+
+/* Threads selecting concurrently */
+#define THREADS (4)
+
+/* Longest font-family list kept for comparison */
+#define FAMILY_LEN (64)
+
+/** A document element */
+typedef struct node {
+	lwc_string *name;
+	lwc_string *klass;		/**< Class, or NULL */
+	lwc_string *id;			/**< Id, or NULL */
+	struct node *parent;
+	struct node *prev;		/**< Previous sibling, or NULL */
+	struct node *next;		/**< Next sibling, or NULL */
+	struct node *first_child;
+	void *data;			/**< libcss node data */
+} node;
+
+/** The properties of a computed style the rules set */
+typedef struct props {
+	uint8_t color_type;
+	css_color color;
+	uint8_t width_type;
+	css_fixed width;
+	css_unit width_unit;
+	uint8_t margin_type;
+	css_fixed margin;
+	css_unit margin_unit;
+	uint8_t z_index_type;
+	int32_t z_index;
+	uint8_t display;
+	uint8_t font_weight;
+	uint8_t family_type;
+	char family[FAMILY_LEN];
+} props;
+
+/* The eager sheet's styles, by node index */
+static props expected[NODES];
+
+/* A thread's work */
+typedef struct job {
+	css_select_ctx *ctx;
+	int failures;
+} job;
+
+static css_error resolve_url(void *pw, const char *base, lwc_string *rel,
+		lwc_string **abs)
+{
+	(void) pw;
+	(void) base;
+
+	*abs = lwc_string_ref(rel);
+
+	return CSS_OK;
+}
+
+/**
+ * Find whether a node has a name
+ *
+ * \param n     Node to consider
+ * \param name  Name to find
+ * \return True if it does, false otherwise
+ */
+static bool has_name(const node *n, lwc_string *name)
+{
+	bool match;
+
+	return lwc_string_caseless_isequal(n->name, name, &match) ==
+			lwc_error_ok && match;
+}
+
+static css_error node_name(void *pw, void *n, css_qname *qname)
+{
+	(void) pw;
+
+	qname->ns = NULL;
+	qname->name = lwc_string_ref(((node *) n)->name);
+
+	return CSS_OK;
+}
+
+static css_error node_classes(void *pw, void *n,
+		lwc_string ***classes, uint32_t *n_classes)
+{
+	node *e = n;
+
+	(void) pw;
+
+	if (e->klass == NULL) {
+		*classes = NULL;
+		*n_classes = 0;
+		return CSS_OK;
+	}
+
+	/* The caller takes the string, but not the array */
+	lwc_string_ref(e->klass);
+	*classes = &e->klass;
+	*n_classes = 1;
+
+	return CSS_OK;
+}
+
+static css_error node_id(void *pw, void *n, lwc_string **id)
+{
+	node *e = n;
+
+	(void) pw;
+
+	*id = (e->id != NULL) ? lwc_string_ref(e->id) : NULL;
+
+	return CSS_OK;
+}
+
+static css_error named_ancestor_node(void *pw, void *n,
+		const css_qname *qname, void **ancestor)
+{
+	node *e;
+
+	(void) pw;
+
+	for (e = ((node *) n)->parent; e != NULL; e = e->parent) {
+		if (has_name(e, qname->name))
+			break;
+	}
+
+	*ancestor = e;
+
+	return CSS_OK;
+}
+
+static css_error named_parent_node(void *pw, void *n,
+		const css_qname *qname, void **parent)
+{
+	node *e = ((node *) n)->parent;
+
+	(void) pw;
+
+	*parent = (e != NULL && has_name(e, qname->name)) ? e : NULL;
+
+	return CSS_OK;
+}
+
+static css_error named_sibling_node(void *pw, void *n,
+		const css_qname *qname, void **sibling)
+{
+	node *e = ((node *) n)->prev;
+
+	(void) pw;
+
+	*sibling = (e != NULL && has_name(e, qname->name)) ? e : NULL;
+
+	return CSS_OK;
+}
+
+static css_error named_generic_sibling_node(void *pw, void *n,
+		const css_qname *qname, void **sibling)
+{
+	node *e;
+
+	(void) pw;
+
+	for (e = ((node *) n)->prev; e != NULL; e = e->prev) {
+		if (has_name(e, qname->name))
+			break;
+	}
+
+	*sibling = e;
+
+	return CSS_OK;
+}
+
+static css_error parent_node(void *pw, void *n, void **parent)
+{
+	(void) pw;
+
+	*parent = ((node *) n)->parent;
+
+	return CSS_OK;
+}
+
+static css_error sibling_node(void *pw, void *n, void **sibling)
+{
+	(void) pw;
+
+	*sibling = ((node *) n)->prev;
+
+	return CSS_OK;
+}
+
+static css_error node_has_name(void *pw, void *n,
+		const css_qname *qname, bool *match)
+{
+	(void) pw;
+
+	*match = has_name(n, qname->name);
+
+	return CSS_OK;
+}
+
+static css_error node_has_class(void *pw, void *n,
+		lwc_string *name, bool *match)
+{
+	node *e = n;
+
+	(void) pw;
+
+	*match = false;
+	if (e->klass != NULL &&
+			lwc_string_isequal(e->klass, name, match) !=
+			lwc_error_ok)
+		return CSS_NOMEM;
+
+	return CSS_OK;
+}
+
+static css_error node_has_id(void *pw, void *n,
+		lwc_string *name, bool *match)
+{
+	node *e = n;
+
+	(void) pw;
+
+	*match = false;
+	if (e->id != NULL &&
+			lwc_string_isequal(e->id, name, match) !=
+			lwc_error_ok)
+		return CSS_NOMEM;
+
+	return CSS_OK;
+}
+
+static css_error node_has_attribute(void *pw, void *n,
+		const css_qname *qname, bool *match)
+{
+	(void) pw;
+	(void) n;
+	(void) qname;
+
+	*match = false;
+
+	return CSS_OK;
+}
+
+static css_error node_has_attribute_value(void *pw, void *n,
+		const css_qname *qname, lwc_string *value, bool *match)
+{
+	(void) pw;
+	(void) n;
+	(void) qname;
+	(void) value;
+
+	*match = false;
+
+	return CSS_OK;
+}
+
+static css_error node_is_root(void *pw, void *n, bool *match)
+{
+	(void) pw;
+
+	*match = (((node *) n)->parent == NULL);
+
+	return CSS_OK;
+}
+
+static css_error node_count_siblings(void *pw, void *n,
+		bool same_name, bool after, int32_t *count)
+{
+	node *e = n, *s;
+
+	(void) pw;
+
+	*count = 0;
+	for (s = after ? e->next : e->prev; s != NULL;
+			s = after ? s->next : s->prev) {
+		if (same_name == false || has_name(s, e->name))
+			(*count)++;
+	}
+
+	return CSS_OK;
+}
+
+static css_error node_is_empty(void *pw, void *n, bool *match)
+{
+	(void) pw;
+
+	*match = (((node *) n)->first_child == NULL);
+
+	return CSS_OK;
+}
+
+static css_error node_is(void *pw, void *n, bool *match)
+{
+	(void) pw;
+	(void) n;
+
+	*match = false;
+
+	return CSS_OK;
+}
+
+static css_error node_is_lang(void *pw, void *n,
+		lwc_string *lang, bool *match)
+{
+	(void) pw;
+	(void) n;
+	(void) lang;
+
+	*match = false;
+
+	return CSS_OK;
+}
+
+static css_error node_presentational_hint(void *pw, void *n,
+		uint32_t *nhints, css_hint **hints)
+{
+	(void) pw;
+	(void) n;
+
+	*nhints = 0;
+	*hints = NULL;
+
+	return CSS_OK;
+}
+
+static css_error ua_default_for_property(void *pw, uint32_t property,
+		css_hint *hint)
+{
+	(void) pw;
+
+	if (property == CSS_PROP_COLOR) {
+		hint->data.color = 0xff000000;
+		hint->status = CSS_COLOR_COLOR;
+	} else if (property == CSS_PROP_FONT_FAMILY) {
+		hint->data.strings = NULL;
+		hint->status = CSS_FONT_FAMILY_SANS_SERIF;
+	} else if (property == CSS_PROP_QUOTES) {
+		hint->data.strings = NULL;
+		hint->status = CSS_QUOTES_NONE;
+	} else if (property == CSS_PROP_VOICE_FAMILY) {
+		hint->data.strings = NULL;
+		hint->status = 0;
+	} else {
+		return CSS_INVALID;
+	}
+
+	return CSS_OK;
+}
+
+static css_error compute_font_size(void *pw, const css_hint *parent,
+		css_hint *size)
+{
+	(void) pw;
+	(void) parent;
+
+	/* Every size is medium; the sheet sets none */
+	size->data.length.value = INTTOFIX(12);
+	size->data.length.unit = CSS_UNIT_PT;
+	size->status = CSS_FONT_SIZE_DIMENSION;
+
+	return CSS_OK;
+}
+
+static css_error set_libcss_node_data(void *pw, void *n, void *data)
+{
+	node *e = n;
+
+	(void) pw;
+
+	free(e->data);
+	e->data = data;
+
+	return CSS_OK;
+}
+
+static css_error get_libcss_node_data(void *pw, void *n, void **data)
+{
+	(void) pw;
+
+	*data = ((node *) n)->data;
+
+	return CSS_OK;
+}
+
+static css_select_handler handler = {
+	CSS_SELECT_HANDLER_VERSION_1,
+
+	node_name,
+	node_classes,
+	node_id,
+	named_ancestor_node,
+	named_parent_node,
+	named_sibling_node,
+	named_generic_sibling_node,
+	parent_node,
+	sibling_node,
+	node_has_name,
+	node_has_class,
+	node_has_id,
+	node_has_attribute,
+	node_has_attribute_value,
+	node_has_attribute_value,
+	node_has_attribute_value,
+	node_has_attribute_value,
+	node_has_attribute_value,
+	node_has_attribute_value,
+	node_is_root,
+	node_count_siblings,
+	node_is_empty,
+	node_is,
+	node_is,
+	node_is,
+	node_is,
+	node_is,
+	node_is,
+	node_is,
+	node_is,
+	node_is,
+	node_is_lang,
+	node_presentational_hint,
+	ua_default_for_property,
+	compute_font_size,
+	set_libcss_node_data,
+	get_libcss_node_data
+};
+
+/**
+ * Add a node to a document
+ *
+ * \param doc     The document's nodes
+ * \param i       Index of the node
+ * \param name    Name of the node
+ * \param parent  Parent of the node, or NULL for the root
+ * \return True on success, false on memory exhaustion
+ */
+static bool add_node(node *doc, int i, const char *name, node *parent)
+{
+	node *e = &doc[i], *last = NULL;
+
+	memset(e, 0, sizeof(*e));
+
+	if (lwc_intern_string(name, strlen(name), &e->name) != lwc_error_ok)
+		return false;
+
+	e->parent = parent;
+	if (parent == NULL)
+		return true;
+
+	if (parent->first_child == NULL) {
+		parent->first_child = e;
+	} else {
+		for (last = parent->first_child; last->next != NULL;
+				last = last->next)
+			;
+		last->next = e;
+		e->prev = last;
+	}
+
+	return true;
+}
+
+/**
+ * Destroy a document
+ *
+ * \param doc  The document's nodes
+ * \param n    Number of its nodes that were added
+ */
+static void destroy_document(node *doc, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (doc[i].data != NULL)
+			css_libcss_node_data_handler(&handler,
+					CSS_NODE_DELETED, NULL, &doc[i],
+					NULL, doc[i].data);
+		lwc_string_unref(doc[i].name);
+		if (doc[i].klass != NULL)
+			lwc_string_unref(doc[i].klass);
+		if (doc[i].id != NULL)
+			lwc_string_unref(doc[i].id);
+	}
+
+	free(doc);
+}
+
+/**
+ * Create a document, with nodes in document order
+ *
+ * \return The document's NODES nodes, or NULL on memory exhaustion
+ *
+ * The root html has a body, whose divs each have a class and id and two
+ * paragraphs.
+ */
+static node *create_document(void)
+{
+	node *doc;
+	char buf[32];
+	int i, n = 0;
+
+	doc = malloc(NODES * sizeof(node));
+	if (doc == NULL)
+		return NULL;
+
+	if (add_node(doc, n++, "html", NULL) == false ||
+			add_node(doc, n++, "body", &doc[0]) == false)
+		goto fail;
+
+	for (i = 0; i < DIVS; i++) {
+		node *div = &doc[n];
+
+		if (add_node(doc, n++, "div", &doc[1]) == false)
+			goto fail;
+
+		/* Spread the classes over the sheet's rules */
+		sprintf(buf, "c%d", (i * 7) % RULES);
+		if (lwc_intern_string(buf, strlen(buf), &div->klass) !=
+				lwc_error_ok)
+			goto fail;
+
+		sprintf(buf, "d%d", i);
+		if (lwc_intern_string(buf, strlen(buf), &div->id) !=
+				lwc_error_ok)
+			goto fail;
+
+		if (add_node(doc, n++, "p", div) == false ||
+				add_node(doc, n++, "p", div) == false)
+			goto fail;
+	}
+
+	return doc;
+
+fail:
+	destroy_document(doc, n);
+	return NULL;
+}
+
+/**
+ * Extract the properties the sheet sets from a computed style
+ *
+ * \param style  The style
+ * \param root   Whether the style is the root element's
+ * \param p      Pointer to location to receive the properties
+ */
+static void get_props(const css_computed_style *style, bool root, props *p)
+{
+	lwc_string **names = NULL;
+	size_t len = 0;
+
+	memset(p, 0, sizeof(*p));
+
+	p->color_type = css_computed_color(style, &p->color);
+	p->width_type = css_computed_width(style, &p->width, &p->width_unit);
+	p->margin_type = css_computed_margin_left(style, &p->margin,
+			&p->margin_unit);
+	p->z_index_type = css_computed_z_index(style, &p->z_index);
+	p->display = css_computed_display(style, root);
+	p->font_weight = css_computed_font_weight(style);
+
+	p->family_type = css_computed_font_family(style, &names);
+	for (; names != NULL && *names != NULL; names++) {
+		size_t n = lwc_string_length(*names);
+
+		if (len + n + 1 >= FAMILY_LEN)
+			break;
+
+		memcpy(p->family + len, lwc_string_data(*names), n);
+		len += n;
+		p->family[len++] = ',';
+	}
+}
+
+/**
+ * Compare two sets of properties
+ *
+ * \param a  First set
+ * \param b  Second set
+ * \return True if they match, false otherwise
+ */
+static bool same_props(const props *a, const props *b)
+{
+	return a->color_type == b->color_type && a->color == b->color &&
+			a->width_type == b->width_type &&
+			a->width == b->width &&
+			a->width_unit == b->width_unit &&
+			a->margin_type == b->margin_type &&
+			a->margin == b->margin &&
+			a->margin_unit == b->margin_unit &&
+			a->z_index_type == b->z_index_type &&
+			a->z_index == b->z_index &&
+			a->display == b->display &&
+			a->font_weight == b->font_weight &&
+			a->family_type == b->family_type &&
+			strcmp(a->family, b->family) == 0;
+}
+
+/**
+ * Select the style of each of a document's nodes
+ *
+ * \param name  Name of the selection, for messages
+ * \param ctx   Selection context
+ * \param doc   The document's nodes
+ * \param out   Array to receive each node's properties, or NULL to
+ *              compare them with the expected ones instead
+ * \return Number of failures
+ */
+static int select_document(const char *name, css_select_ctx *ctx,
+		node *doc, props *out)
+{
+	css_select_results *results;
+	css_error error;
+	props p;
+	int i;
+
+	for (i = 0; i < NODES; i++) {
+		error = css_select_style(ctx, &doc[i], CSS_MEDIA_ALL, NULL,
+				&handler, NULL, &results);
+		if (error != CSS_OK) {
+			printf("%s: node %d: %s\n", name, i,
+					css_error_to_string(error));
+			return 1;
+		}
+
+		if (results->styles[CSS_PSEUDO_ELEMENT_NONE] == NULL) {
+			printf("%s: node %d: no style\n", name, i);
+			css_select_results_destroy(results);
+			return 1;
+		}
+
+		get_props(results->styles[CSS_PSEUDO_ELEMENT_NONE],
+				doc[i].parent == NULL, out != NULL ? &out[i] : &p);
+
+		css_select_results_destroy(results);
+
+		if (out == NULL && same_props(&p, &expected[i]) == false) {
+			printf("%s: node %d: style differs\n", name, i);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Create a stylesheet and a selection context holding it
+ *
+ * \param data  Stylesheet to parse
+ * \param lazy  Whether to compile rulesets on first use
+ * \param sheet Pointer to location to receive the sheet
+ * \param ctx   Pointer to location to receive the context
+ * \return Number of failures
+ */
+static int create_ctx(const char *data, bool lazy, css_stylesheet **sheet,
+		css_select_ctx **ctx)
+{
+	const char *name = lazy ? "lazy" : "eager";
+	css_stylesheet_params params;
+	css_error error;
+
+	memset(&params, 0, sizeof(params));
+	params.params_version = CSS_STYLESHEET_PARAMS_VERSION_2;
+	params.level = CSS_LEVEL_DEFAULT;
+	params.charset = "UTF-8";
+	params.url = "foo";
+	params.title = "foo";
+	params.resolve = resolve_url;
+	params.lazy_styles = lazy;
+
+	error = css_stylesheet_create(&params, sheet);
+	if (error != CSS_OK) {
+		printf("%s: css_stylesheet_create: %s\n", name,
+				css_error_to_string(error));
+		return 1;
+	}
+
+	error = css_stylesheet_append_data(*sheet,
+			(const uint8_t *) data, strlen(data));
+	if (error == CSS_OK || error == CSS_NEEDDATA)
+		error = css_stylesheet_data_done(*sheet);
+	if (error == CSS_OK)
+		error = css_select_ctx_create(ctx);
+	if (error == CSS_OK) {
+		error = css_select_ctx_append_sheet(*ctx, *sheet,
+				CSS_ORIGIN_AUTHOR, CSS_MEDIA_ALL);
+		if (error != CSS_OK)
+			css_select_ctx_destroy(*ctx);
+	}
+	if (error != CSS_OK) {
+		printf("%s: %s\n", name, css_error_to_string(error));
+		css_stylesheet_destroy(*sheet);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void *select_concurrently(void *pw)
+{
+	job *j = pw;
+	node *doc;
+
+	/* Each thread selects for its own document, whose nodes hold the
+	 * thread's node data */
+	doc = create_document();
+	if (doc == NULL) {
+		j->failures = 1;
+		return NULL;
+	}
+
+	j->failures = select_document("concurrent", j->ctx, doc, NULL);
+
+	destroy_document(doc, NODES);
+
+	return NULL;
+}
+
+int main(void)
+{
+	pthread_t threads[THREADS];
+	job jobs[THREADS];
+	css_stylesheet *eager, *lazy;
+	css_select_ctx *eager_ctx, *lazy_ctx;
+	node *doc;
+	char *data;
+	size_t len;
+	int i, failures = 0;
+
+	data = malloc(256 + RULES * 64);
+	if (data == NULL)
+		return EXIT_FAILURE;
+
+	len = sprintf(data,
+			"html{color:#000;font-family:serif}"
+			"body{display:block;margin-left:8px}"
+			"div p{font-weight:bold}"
+			"p+p{margin-left:2em;color:blue}"
+			"div.c14>p{font-family:\"F\",monospace}");
+	for (i = 0; i < RULES; i++) {
+		len += sprintf(data + len,
+				".c%d{color:#%06x;width:%dpx}#d%d{z-index:%d}",
+				i, i * 97, i, i, i);
+	}
+
+	doc = create_document();
+	if (doc == NULL) {
+		free(data);
+		return EXIT_FAILURE;
+	}
+
+	if (create_ctx(data, false, &eager, &eager_ctx) != 0) {
+		destroy_document(doc, NODES);
+		free(data);
+		return EXIT_FAILURE;
+	}
+
+	failures += select_document("eager", eager_ctx, doc, expected);
+
+	/* A lazy sheet compiles its rules as selection matches them */
+	if (create_ctx(data, true, &lazy, &lazy_ctx) == 0) {
+		failures += select_document("lazy", lazy_ctx, doc, NULL);
+
+		css_select_ctx_destroy(lazy_ctx);
+		css_stylesheet_destroy(lazy);
+	} else {
+		failures++;
+	}
+
+	/* And on several threads at once, from a fresh sheet */
+	if (create_ctx(data, true, &lazy, &lazy_ctx) == 0) {
+		for (i = 0; i < THREADS; i++) {
+			jobs[i].ctx = lazy_ctx;
+			jobs[i].failures = 0;
+			pthread_create(&threads[i], NULL,
+					select_concurrently, &jobs[i]);
+		}
+
+		for (i = 0; i < THREADS; i++) {
+			pthread_join(threads[i], NULL);
+			failures += jobs[i].failures;
+		}
+
+		css_select_ctx_destroy(lazy_ctx);
+		css_stylesheet_destroy(lazy);
+	} else {
+		failures++;
+	}
+
+	css_select_ctx_destroy(eager_ctx);
+	css_stylesheet_destroy(eager);
+	destroy_document(doc, NODES);
+	free(data);
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}